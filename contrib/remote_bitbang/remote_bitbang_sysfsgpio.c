@@ -291,6 +291,72 @@ static void cleanup_all_fds(void)
 	cleanup_fd(srst_fd, srst_gpio);
 }
 
+/*
+ * Vector extension: 'X', a flags byte, a 32 bit little endian bit count,
+ * then the TMS and TDI vectors if the flags say so. See
+ * doc/manual/jtag/drivers/remote_bitbang.txt for the details.
+ */
+#define VEC_TMS_VECTOR	0x01
+#define VEC_TMS_HIGH	0x02
+#define VEC_TDI_VECTOR	0x04
+#define VEC_TDI_HIGH	0x08
+#define VEC_READ_TDO	0x10
+#define VEC_TMS_LAST	0x20
+
+/* Longest vector a single command may carry */
+#define VEC_MAX_BYTES	4096
+
+static int read_bytes(unsigned char *buf, unsigned int len)
+{
+	return fread(buf, 1, len, stdin) == len ? 0 : -1;
+}
+
+static int process_vector(void)
+{
+	static unsigned char tms[VEC_MAX_BYTES], tdi[VEC_MAX_BYTES], tdo[VEC_MAX_BYTES];
+	unsigned char header[5];
+
+	if (read_bytes(header, sizeof(header)) < 0)
+		return -1;
+
+	unsigned int flags = header[0];
+	unsigned long num_bits = header[1] | (header[2] << 8) |
+		((unsigned long)header[3] << 16) | ((unsigned long)header[4] << 24);
+	unsigned int num_bytes = (num_bits + 7) / 8;
+
+	if (num_bits > VEC_MAX_BYTES * 8) {
+		LOG_ERROR("Vector with %lu bits too long", num_bits);
+		return -1;
+	}
+
+	if ((flags & VEC_TMS_VECTOR) && read_bytes(tms, num_bytes) < 0)
+		return -1;
+	if ((flags & VEC_TDI_VECTOR) && read_bytes(tdi, num_bytes) < 0)
+		return -1;
+	memset(tdo, 0, num_bytes);
+
+	for (unsigned long i = 0; i < num_bits; i++) {
+		int tms_bit = !!(flags & VEC_TMS_HIGH);
+		int tdi_bit = !!(flags & VEC_TDI_HIGH);
+
+		if (flags & VEC_TMS_VECTOR)
+			tms_bit = (tms[i / 8] >> (i % 8)) & 1;
+		else if ((flags & VEC_TMS_LAST) && i == num_bits - 1)
+			tms_bit = 1;
+		if (flags & VEC_TDI_VECTOR)
+			tdi_bit = (tdi[i / 8] >> (i % 8)) & 1;
+
+		sysfsgpio_write(0, tms_bit, tdi_bit);
+		if ((flags & VEC_READ_TDO) && sysfsgpio_read() == '1')
+			tdo[i / 8] |= 1 << (i % 8);
+		sysfsgpio_write(1, tms_bit, tdi_bit);
+	}
+
+	if ((flags & VEC_READ_TDO) && fwrite(tdo, 1, num_bytes, stdout) != num_bytes)
+		return -1;
+	return 0;
+}
+
 static void process_remote_protocol(void)
 {
 	int c;
@@ -311,7 +377,15 @@ static void process_remote_protocol(void)
 					(d & 1));
 		} else if (c == 'R')
 			putchar(sysfsgpio_read());
-		else
+		else if (c == 'V') { /* Supported extensions */
+			putchar('V');
+			putchar('1');
+		} else if (c == 'X') { /* Vector */
+			if (process_vector() < 0) {
+				LOG_ERROR("Broken vector command");
+				break;
+			}
+		} else
 			LOG_ERROR("Unknown command '%c' received", c);
 	}
 }
@@ -0,0 +1,411 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Stand-in vdebug server, simulating a single JTAG TAP with a memory behind
+ * it. It speaks enough of the vdebug protocol for the OpenOCD vdebug driver,
+ * over TCP or over a buffer shared through a file, so both transports can be
+ * compared without an emulator.
+ *
+ * To compile run:
+ * gcc -Wall -O2 -std=gnu99 -o vdebug_sim vdebug_sim.c
+ *
+ * Usage example, shared memory:
+ * ./vdebug_sim -s /dev/shm/vdebug &
+ * openocd -c "adapter driver vdebug; vdebug shm /dev/shm/vdebug; \
+ *	vdebug bfm_path tb.tap 10ns; transport select jtag; \
+ *	jtag newtap sim cpu -irlen 4 -expected-id 0x1dead0a5"
+ *
+ * or over TCP:
+ * ./vdebug_sim -p 8192 &
+ * openocd -c "adapter driver vdebug; vdebug server localhost:8192; ..."
+ *
+ * The TAP implements these instructions:
+ *   0x1 IDCODE    32 bit, 0x1dead0a5
+ *   0x8 MEM_ADDR  32 bit byte address into the memory
+ *   0x9 MEM_WRITE 32 bit, Update-DR writes the word and increments the address
+ *   0xa MEM_READ  32 bit, Capture-DR reads the word, Update-DR increments
+ *   0xf BYPASS
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/futex.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#define VD_BUFFER_LEN 4024
+#define VD_CHEADER_LEN 24
+#define VD_SHEADER_LEN 16
+
+#define VD_CMD_OPEN       0x01
+#define VD_CMD_CLOSE      0x02
+#define VD_CMD_CONNECT    0x04
+#define VD_CMD_DISCONNECT 0x05
+#define VD_CMD_WAIT       0x09
+#define VD_CMD_SIGSET     0x0a
+#define VD_CMD_SIGGET     0x0b
+#define VD_CMD_JTAGCLOCK  0x0f
+#define VD_CMD_JTAGSHTAP  0x1a
+#define VD_CMD_MEMOPEN    0x21
+#define VD_CMD_MEMCLOSE   0x22
+
+#define VD_ERR_NOT_IMPL   0x0100
+
+#define VD_SHM_REQUEST    1
+#define VD_SHM_DONE       2
+
+/* Same layout as in src/jtag/drivers/vdebug.c */
+struct vd_shm {
+	struct {
+		uint8_t cmd;
+		uint8_t type;
+		uint16_t waddr;
+		uint16_t wbytes;
+		uint16_t rbytes;
+		uint16_t wwords;
+		uint16_t rwords;
+		uint32_t rwdata;
+		uint32_t offset;
+		uint16_t offseth;
+		uint16_t wid;
+	};
+	union {
+		uint8_t wd8[VD_BUFFER_LEN];
+		uint16_t wd16[VD_BUFFER_LEN / 2];
+		uint32_t wd32[VD_BUFFER_LEN / 4];
+	};
+	struct {
+		uint16_t rid;
+		uint16_t awords;
+		int32_t  status;
+		uint64_t duttime;
+	};
+	union {
+		uint8_t rd8[VD_BUFFER_LEN];
+		uint16_t rd16[VD_BUFFER_LEN / 2];
+		uint32_t rd32[VD_BUFFER_LEN / 4];
+	};
+	uint32_t state;
+	uint32_t count;
+	uint8_t dummy[96];
+};
+
+/* Request header of VD_CMD_JTAGSHTAP, as built by the driver */
+struct vd_jtag_hdr {
+	uint64_t tlen:24;
+	uint64_t post:3;
+	uint64_t pre:3;
+	uint64_t cmd:2;
+	uint64_t wlen:16;
+	uint64_t rlen:16;
+};
+
+#define BUF_WIDTH	8	/* bytes per buffer word */
+
+#define IR_LEN		4
+#define IR_IDCODE	0x1
+#define IR_MEM_ADDR	0x8
+#define IR_MEM_WRITE	0x9
+#define IR_MEM_READ	0xa
+#define IR_BYPASS	0xf
+#define IDCODE		0x1dead0a5
+
+#define MEM_SIZE	(1024 * 1024)
+
+enum tap_state {
+	TLR, RTI, SELECT_DR, CAPTURE_DR, SHIFT_DR, EXIT1_DR, PAUSE_DR, EXIT2_DR, UPDATE_DR,
+	SELECT_IR, CAPTURE_IR, SHIFT_IR, EXIT1_IR, PAUSE_IR, EXIT2_IR, UPDATE_IR,
+};
+
+/* Next state for TMS = 0 and TMS = 1 */
+static const enum tap_state tap_next[16][2] = {
+	[TLR]        = { RTI, TLR },
+	[RTI]        = { RTI, SELECT_DR },
+	[SELECT_DR]  = { CAPTURE_DR, SELECT_IR },
+	[CAPTURE_DR] = { SHIFT_DR, EXIT1_DR },
+	[SHIFT_DR]   = { SHIFT_DR, EXIT1_DR },
+	[EXIT1_DR]   = { PAUSE_DR, UPDATE_DR },
+	[PAUSE_DR]   = { PAUSE_DR, EXIT2_DR },
+	[EXIT2_DR]   = { SHIFT_DR, UPDATE_DR },
+	[UPDATE_DR]  = { RTI, SELECT_DR },
+	[SELECT_IR]  = { CAPTURE_IR, TLR },
+	[CAPTURE_IR] = { SHIFT_IR, EXIT1_IR },
+	[SHIFT_IR]   = { SHIFT_IR, EXIT1_IR },
+	[EXIT1_IR]   = { PAUSE_IR, UPDATE_IR },
+	[PAUSE_IR]   = { PAUSE_IR, EXIT2_IR },
+	[EXIT2_IR]   = { SHIFT_IR, UPDATE_IR },
+	[UPDATE_IR]  = { RTI, SELECT_DR },
+};
+
+static struct {
+	enum tap_state state;
+	uint32_t ir, ir_shift;
+	uint32_t dr_shift;
+	unsigned int dr_len;
+	uint32_t mem_addr;
+	uint64_t cycles;
+} tap = { .state = TLR, .ir = IR_IDCODE };
+
+static uint32_t mem[MEM_SIZE / 4];
+static unsigned int mem_opened;
+
+static uint32_t *mem_word(void)
+{
+	return &mem[(tap.mem_addr % MEM_SIZE) / 4];
+}
+
+/* One TCK cycle, returns TDO as sampled on the rising edge */
+static int tap_clock(int tms, int tdi)
+{
+	int tdo = 0;
+
+	switch (tap.state) {
+	case TLR:
+		tap.ir = IR_IDCODE;
+		break;
+	case CAPTURE_DR:
+		switch (tap.ir) {
+		case IR_IDCODE:
+			tap.dr_shift = IDCODE;
+			tap.dr_len = 32;
+			break;
+		case IR_MEM_ADDR:
+			tap.dr_shift = tap.mem_addr;
+			tap.dr_len = 32;
+			break;
+		case IR_MEM_WRITE:
+			tap.dr_shift = 0;
+			tap.dr_len = 32;
+			break;
+		case IR_MEM_READ:
+			tap.dr_shift = *mem_word();
+			tap.dr_len = 32;
+			break;
+		default:
+			tap.dr_shift = 0;
+			tap.dr_len = 1;
+			break;
+		}
+		break;
+	case SHIFT_DR:
+		tdo = tap.dr_shift & 1;
+		tap.dr_shift = (tap.dr_shift >> 1) | ((uint32_t)tdi << (tap.dr_len - 1));
+		break;
+	case UPDATE_DR:
+		switch (tap.ir) {
+		case IR_MEM_ADDR:
+			tap.mem_addr = tap.dr_shift;
+			break;
+		case IR_MEM_WRITE:
+			*mem_word() = tap.dr_shift;
+			tap.mem_addr += 4;
+			break;
+		case IR_MEM_READ:
+			tap.mem_addr += 4;
+			break;
+		}
+		break;
+	case CAPTURE_IR:
+		tap.ir_shift = 0x1;
+		break;
+	case SHIFT_IR:
+		tdo = tap.ir_shift & 1;
+		tap.ir_shift = (tap.ir_shift >> 1) | ((uint32_t)tdi << (IR_LEN - 1));
+		break;
+	case UPDATE_IR:
+		tap.ir = tap.ir_shift;
+		break;
+	default:
+		break;
+	}
+
+	tap.state = tap_next[tap.state][tms];
+	tap.cycles++;
+	return tdo;
+}
+
+/* Run the batch of shift requests of a VD_CMD_JTAGSHTAP */
+static void jtag_shift_tap(struct vd_shm *pm)
+{
+	unsigned int waddr = 0;   /* in 4 byte units */
+	unsigned int rword = 0;   /* in 8 byte units */
+
+	memset(pm->rd8, 0, pm->rwords * BUF_WIDTH);
+	for (unsigned int req = 0; req < pm->waddr; req++) {
+		struct vd_jtag_hdr hdr;
+		memcpy(&hdr, &pm->wd8[waddr * 4], sizeof(hdr));
+		waddr += sizeof(hdr) / 4;
+
+		/* the bits come as 32 bit {TDI, TMS} word pairs */
+		const uint8_t *data = &pm->wd8[waddr * 4];
+		for (unsigned int i = 0; i < hdr.tlen; i++) {
+			unsigned int byte = (i / 32) * 8 + (i % 32) / 8;
+			int tdi = (data[byte] >> (i % 8)) & 1;
+			int tms = (data[byte + 4] >> (i % 8)) & 1;
+			int tdo = tap_clock(tms, tdi);
+			if (hdr.cmd == 3 && tdo)
+				pm->rd8[rword * 8 + i / 8] |= 1 << (i % 8);
+		}
+
+		if (hdr.cmd == 3)
+			rword += hdr.rlen;
+		waddr += hdr.wlen * 2;
+	}
+}
+
+static void process(struct vd_shm *pm)
+{
+	pm->status = 0;
+	pm->rid = pm->wid;
+
+	switch (pm->cmd) {
+	case VD_CMD_OPEN:
+	case VD_CMD_CLOSE:
+	case VD_CMD_DISCONNECT:
+	case VD_CMD_SIGSET:
+	case VD_CMD_JTAGCLOCK:
+	case VD_CMD_MEMCLOSE:
+		break;
+	case VD_CMD_CONNECT:
+		/* grant every signal asked for */
+		pm->rd32[0] = BUF_WIDTH * 8;
+		pm->rd32[1] = 0;
+		pm->rd32[2] = 32;
+		mem_opened = 0;
+		break;
+	case VD_CMD_MEMOPEN:
+		pm->rd16[0] = 32;
+		pm->rd16[1] = mem_opened++;
+		pm->rd32[1] = MEM_SIZE / 4;
+		break;
+	case VD_CMD_WAIT:
+		tap.cycles += pm->rwdata;
+		break;
+	case VD_CMD_SIGGET:
+		pm->rwdata = 0;
+		break;
+	case VD_CMD_JTAGSHTAP:
+		jtag_shift_tap(pm);
+		break;
+	default:
+		fprintf(stderr, "vdebug_sim: unsupported command 0x%02x\n", pm->cmd);
+		pm->status = VD_ERR_NOT_IMPL;
+		break;
+	}
+	pm->duttime = tap.cycles;
+}
+
+static long futex(uint32_t *addr, int op, uint32_t val)
+{
+	return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+static int serve_shm(const char *path)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0 || ftruncate(fd, sizeof(struct vd_shm)) < 0) {
+		perror(path);
+		return 1;
+	}
+
+	struct vd_shm *pm = mmap(NULL, sizeof(struct vd_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (pm == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	fprintf(stderr, "vdebug_sim: serving %s\n", path);
+	while (1) {
+		while (__atomic_load_n(&pm->state, __ATOMIC_ACQUIRE) != VD_SHM_REQUEST)
+			futex(&pm->state, FUTEX_WAIT, pm->state);
+
+		bool close = pm->cmd == VD_CMD_CLOSE;
+		process(pm);
+		pm->count++;
+		__atomic_store_n(&pm->state, VD_SHM_DONE, __ATOMIC_RELEASE);
+		futex(&pm->state, FUTEX_WAKE, 1);
+		if (close)
+			fprintf(stderr, "vdebug_sim: client closed, %u requests\n", pm->count);
+	}
+	return 0;
+}
+
+static int recv_all(int fd, void *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = recv(fd, buf, len, 0);
+		if (n <= 0)
+			return -1;
+		buf = (char *)buf + n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int serve_tcp(int port)
+{
+	static struct vd_shm shm;
+	struct vd_shm *pm = &shm;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_ANY),
+	};
+	int one = 1;
+
+	int lfd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 1) < 0) {
+		perror("bind");
+		return 1;
+	}
+
+	fprintf(stderr, "vdebug_sim: listening on port %d\n", port);
+	while (1) {
+		int fd = accept(lfd, NULL, NULL);
+		if (fd < 0)
+			continue;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		unsigned int count = 0;
+		while (recv_all(fd, pm, VD_CHEADER_LEN) == 0 &&
+				recv_all(fd, pm->wd8, pm->wbytes) == 0) {
+			process(pm);
+			count++;
+			if (send(fd, &pm->rid, VD_SHEADER_LEN + pm->rbytes, 0) < 0)
+				break;
+		}
+		fprintf(stderr, "vdebug_sim: client closed, %u requests\n", count);
+		close(fd);
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:s:")) != -1) {
+		switch (opt) {
+		case 'p':
+			return serve_tcp(atoi(optarg));
+		case 's':
+			return serve_shm(optarg);
+		default:
+			break;
+		}
+	}
+
+	fprintf(stderr, "Usage: %s (-p port | -s shm_file)\n", argv[0]);
+	return 1;
+}
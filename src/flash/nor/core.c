@@ -27,6 +27,7 @@
 #include <flash/nor/core.h>
 #include <flash/nor/imp.h>
 #include <target/image.h>
+#include <jtag/jtag.h>
 
 /**
  * @file
@@ -42,7 +43,9 @@ int flash_driver_erase(struct flash_bank *bank, unsigned int first,
 {
 	int retval;
 
+	const char *prev_tag = jtag_stats_push_tag("flash");
 	retval = bank->driver->erase(bank, first, last);
+	jtag_stats_pop_tag(prev_tag);
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed erasing sectors %u to %u", first, last);
 
@@ -86,7 +89,9 @@ int flash_driver_protect(struct flash_bank *bank, int set, unsigned int first,
 	 *
 	 * Drivers only receive valid protection block range.
 	 */
+	const char *prev_tag = jtag_stats_push_tag("flash");
 	retval = bank->driver->protect(bank, set, first, last);
+	jtag_stats_pop_tag(prev_tag);
 	if (retval != ERROR_OK)
 		LOG_ERROR("failed setting protection for blocks %u to %u", first, last);
 
@@ -98,7 +103,9 @@ int flash_driver_write(struct flash_bank *bank,
 {
 	int retval;
 
+	const char *prev_tag = jtag_stats_push_tag("flash");
 	retval = bank->driver->write(bank, buffer, offset, count);
+	jtag_stats_pop_tag(prev_tag);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
 			"error writing to flash at address " TARGET_ADDR_FMT
@@ -117,7 +124,9 @@ int flash_driver_read(struct flash_bank *bank,
 
 	LOG_DEBUG("call flash_driver_read()");
 
+	const char *prev_tag = jtag_stats_push_tag("flash");
 	retval = bank->driver->read(bank, buffer, offset, count);
+	jtag_stats_pop_tag(prev_tag);
 	if (retval != ERROR_OK) {
 		LOG_ERROR(
 			"error reading to flash at address " TARGET_ADDR_FMT
@@ -140,8 +149,10 @@ int flash_driver_verify(struct flash_bank *bank,
 {
 	int retval;
 
+	const char *prev_tag = jtag_stats_push_tag("flash");
 	retval = bank->driver->verify ? bank->driver->verify(bank, buffer, offset, count) :
 		default_flash_verify(bank, buffer, offset, count);
+	jtag_stats_pop_tag(prev_tag);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("verify failed in bank at " TARGET_ADDR_FMT " starting at 0x%8.8" PRIx32,
 			bank->base, offset);
@@ -734,8 +745,135 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 }
 
 
+static int flash_write_run(struct target *target, struct flash_bank *c,
+	const uint8_t *buffer, target_addr_t run_address, uint32_t run_size,
+	bool erase, bool unlock, bool write, bool verify)
+{
+	int retval = ERROR_OK;
+
+	if (unlock)
+		retval = flash_unlock_address_range(target, run_address, run_size);
+	if (retval == ERROR_OK) {
+		if (erase) {
+			/* calculate and erase sectors */
+			retval = flash_erase_address_range(target,
+					true, run_address, run_size);
+		}
+	}
+
+	if (retval == ERROR_OK) {
+		if (write) {
+			/* write flash sectors */
+			retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+		}
+	}
+
+	if (retval == ERROR_OK) {
+		if (verify) {
+			/* verify flash sectors */
+			retval = flash_driver_verify(c, buffer, run_address - c->base, run_size);
+		}
+	}
+
+	return retval;
+}
+
+/* Same as flash_write_run(), but skips the sectors whose content on the
+ * target already has the CRC of the buffer. Consecutive changed sectors are
+ * still written as one run. When erasing, a sector the run covers only part
+ * of is compared as a whole, with the rest taken as erased, since that is
+ * what erasing and writing it would leave. */
+static int flash_write_run_delta(struct target *target, struct flash_bank *c,
+	const uint8_t *buffer, target_addr_t run_address, uint32_t run_size,
+	bool erase, bool unlock, bool write, bool verify, uint32_t *written)
+{
+	target_addr_t run_end = run_address + run_size;
+	target_addr_t changed_start = run_address;
+	uint32_t changed_size = 0;
+	unsigned int skipped = 0;
+	int retval = ERROR_OK;
+
+	*written = 0;
+
+	if (c->num_sectors == 0) {
+		*written = run_size;
+		return flash_write_run(target, c, buffer, run_address, run_size,
+				erase, unlock, write, verify);
+	}
+
+	for (unsigned int sector = 0; sector < c->num_sectors; sector++) {
+		target_addr_t sector_start = c->base + c->sectors[sector].offset;
+		target_addr_t sector_end = sector_start + c->sectors[sector].size;
+		if (sector_end <= run_address)
+			continue;
+		if (sector_start >= run_end)
+			break;
+
+		target_addr_t start = MAX(sector_start, run_address);
+		uint32_t size = MIN(sector_end, run_end) - start;
+
+		const uint8_t *expected = buffer + (start - run_address);
+		target_addr_t compare_start = start;
+		uint32_t compare_size = size;
+		uint8_t *padded = NULL;
+		if (erase && (start > sector_start || start + size < sector_end)) {
+			compare_start = sector_start;
+			compare_size = c->sectors[sector].size;
+			padded = malloc(compare_size);
+			if (!padded) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+			memset(padded, c->erased_value, compare_size);
+			memcpy(padded + (start - sector_start), expected, size);
+			expected = padded;
+		}
+
+		uint32_t image_crc, target_crc;
+		bool unchanged = image_calculate_checksum(expected, compare_size,
+					&image_crc) == ERROR_OK &&
+				target_checksum_memory(target, compare_start, compare_size,
+					&target_crc) == ERROR_OK &&
+				image_crc == target_crc;
+		free(padded);
+
+		if (!unchanged) {
+			if (changed_size == 0)
+				changed_start = start;
+			changed_size += size;
+			continue;
+		}
+
+		LOG_DEBUG("sector at " TARGET_ADDR_FMT " unchanged, crc 0x%08" PRIx32,
+				start, image_crc);
+		skipped++;
+		if (changed_size) {
+			retval = flash_write_run(target, c, buffer + (changed_start - run_address),
+					changed_start, changed_size, erase, unlock, write, verify);
+			if (retval != ERROR_OK)
+				return retval;
+			*written += changed_size;
+			changed_size = 0;
+		}
+	}
+
+	if (changed_size) {
+		retval = flash_write_run(target, c, buffer + (changed_start - run_address),
+				changed_start, changed_size, erase, unlock, write, verify);
+		if (retval != ERROR_OK)
+			return retval;
+		*written += changed_size;
+	}
+
+	if (skipped)
+		LOG_INFO("Skipped %u unchanged sector%s at " TARGET_ADDR_FMT,
+				skipped, skipped == 1 ? "" : "s", run_address);
+
+	return ERROR_OK;
+}
+
 int flash_write_unlock_verify(struct target *target, struct image *image,
-	uint32_t *written, bool erase, bool unlock, bool write, bool verify)
+	uint32_t *written, bool erase, bool unlock, bool write, bool verify, bool skip_unchanged)
 {
 	int retval = ERROR_OK;
 
@@ -956,31 +1094,13 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 			}
 		}
 
-		retval = ERROR_OK;
-
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
-		}
-
-		if (retval == ERROR_OK) {
-			if (write) {
-				/* write flash sectors */
-				retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
-			}
-		}
-
-		if (retval == ERROR_OK) {
-			if (verify) {
-				/* verify flash sectors */
-				retval = flash_driver_verify(c, buffer, run_address - c->base, run_size);
-			}
-		}
+		uint32_t run_written = run_size;
+		if (skip_unchanged && write)
+			retval = flash_write_run_delta(target, c, buffer, run_address, run_size,
+					erase, unlock, write, verify, &run_written);
+		else
+			retval = flash_write_run(target, c, buffer, run_address, run_size,
+					erase, unlock, write, verify);
 
 		free(buffer);
 
@@ -990,7 +1110,7 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 		}
 
 		if (written)
-			*written += run_size;	/* add run size to total written counter */
+			*written += run_written;	/* add run size to total written counter */
 	}
 
 done:
@@ -1003,7 +1123,13 @@ done:
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, bool erase)
 {
-	return flash_write_unlock_verify(target, image, written, erase, false, true, false);
+	return flash_write_unlock_verify(target, image, written, erase, false, true, false, false);
+}
+
+int flash_write_delta(struct target *target, struct image *image,
+	uint32_t *written, bool erase)
+{
+	return flash_write_unlock_verify(target, image, written, erase, false, true, false, true);
 }
 
 struct flash_sector *alloc_block_array(uint32_t offset, uint32_t size,
@@ -186,6 +186,20 @@ target_addr_t flash_write_align_end(struct flash_bank *bank, target_addr_t addr)
 int flash_write(struct target *target,
 		struct image *image, uint32_t *written, bool erase);
 
+/**
+ * Same as flash_write(), but leaves alone the sectors whose CRC, computed
+ * on the target, matches the image. Unchanged sectors are neither erased
+ * nor programmed.
+ * @param target The target with the flash to be programmed.
+ * @param image The image that will be programmed to flash.
+ * @param written On return, contains the number of bytes written.
+ * @param erase Indicates whether the changed sectors should be erased
+ * before programming.
+ * @returns ERROR_OK if successful; otherwise, an error code.
+ */
+int flash_write_delta(struct target *target,
+		struct image *image, uint32_t *written, bool erase);
+
 /**
  * Forces targets to re-examine their erase/protection state.
  * This routine must be called when the system may modify the status.
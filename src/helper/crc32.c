@@ -0,0 +1,249 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdbool.h>
+
+#include "crc32.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CRC32_HAVE_CLMUL
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#define CRC32_POLY 0x04c11db7
+
+/* crc32_table[k][i] is the CRC of byte i followed by k zero bytes */
+static uint32_t crc32_table[8][256];
+static bool crc32_table_ready;
+
+static void crc32_init_tables(void)
+{
+	if (crc32_table_ready)
+		return;
+
+	for (unsigned int i = 0; i < 256; i++) {
+		/* as per gdb */
+		uint32_t c = i << 24;
+		for (unsigned int j = 8; j > 0; --j)
+			c = c & 0x80000000 ? (c << 1) ^ CRC32_POLY : (c << 1);
+		crc32_table[0][i] = c;
+	}
+
+	for (unsigned int k = 1; k < 8; k++)
+		for (unsigned int i = 0; i < 256; i++) {
+			uint32_t c = crc32_table[k - 1][i];
+			crc32_table[k][i] = (c << 8) ^ crc32_table[0][c >> 24];
+		}
+
+	crc32_table_ready = true;
+}
+
+/* The reference implementation, one byte and one table lookup at a time. */
+static uint32_t crc32_bytewise(uint32_t crc, const uint8_t *buffer, size_t len)
+{
+	while (len--) {
+		/* as per gdb */
+		crc = (crc << 8) ^ crc32_table[0][((crc >> 24) ^ *buffer++) & 255];
+	}
+
+	return crc;
+}
+
+/* Eight bytes per step, with eight independent table lookups. */
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t *buffer, size_t len)
+{
+	while (len >= 8) {
+		crc ^= (uint32_t)buffer[0] << 24 | (uint32_t)buffer[1] << 16 |
+			(uint32_t)buffer[2] << 8 | buffer[3];
+		crc = crc32_table[7][crc >> 24] ^
+			crc32_table[6][(crc >> 16) & 255] ^
+			crc32_table[5][(crc >> 8) & 255] ^
+			crc32_table[4][crc & 255] ^
+			crc32_table[3][buffer[4]] ^
+			crc32_table[2][buffer[5]] ^
+			crc32_table[1][buffer[6]] ^
+			crc32_table[0][buffer[7]];
+		buffer += 8;
+		len -= 8;
+	}
+
+	return crc32_bytewise(crc, buffer, len);
+}
+
+#ifdef CRC32_HAVE_CLMUL
+
+/* x^n mod P */
+static uint32_t crc32_xpow(unsigned int n)
+{
+	uint32_t r = 1;
+
+	while (n--)
+		r = r & 0x80000000 ? (r << 1) ^ CRC32_POLY : (r << 1);
+
+	return r;
+}
+
+/* Folding constants: x^(n + 64) mod P in the high and x^n mod P in the low
+ * half, for a distance of 512 bits (four lanes) and 128 bits (one lane). */
+static __m128i crc32_fold512, crc32_fold128;
+static bool crc32_clmul_supported;
+
+static void crc32_init_clmul(void)
+{
+	__builtin_cpu_init();
+	crc32_clmul_supported = __builtin_cpu_supports("pclmul") &&
+		__builtin_cpu_supports("ssse3");
+
+	crc32_fold512 = _mm_set_epi64x(crc32_xpow(512 + 64), crc32_xpow(512));
+	crc32_fold128 = _mm_set_epi64x(crc32_xpow(128 + 64), crc32_xpow(128));
+}
+
+/* Multiply the 128 bit polynomial x by x^distance and reduce it to 96 bits,
+ * both halves separately with the matching constant. */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crc32_fold(__m128i x, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11),
+			_mm_clmulepi64_si128(x, k, 0x00));
+}
+
+/* Load 16 bytes so that the first byte holds the highest coefficients. */
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crc32_load(const uint8_t *buffer)
+{
+	const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+			8, 9, 10, 11, 12, 13, 14, 15);
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)buffer), reverse);
+}
+
+/* Fold the message 64 bytes at a time in four lanes of 128 bits with carry-
+ * less multiplication, keeping the lanes congruent to the message modulo P.
+ * The lanes are then folded into one, whose CRC is the CRC of the message;
+ * table lookups take care of that and of the tail. */
+__attribute__((target("pclmul,ssse3")))
+static uint32_t crc32_clmul(uint32_t crc, const uint8_t *buffer, size_t len)
+{
+	if (len < 128)
+		return crc32_slice8(crc, buffer, len);
+
+	/* a CRC over data is the CRC from zero over the data with the initial
+	 * value added to its first four bytes */
+	__m128i x0 = _mm_xor_si128(crc32_load(buffer), _mm_set_epi32(crc, 0, 0, 0));
+	__m128i x1 = crc32_load(buffer + 16);
+	__m128i x2 = crc32_load(buffer + 32);
+	__m128i x3 = crc32_load(buffer + 48);
+	buffer += 64;
+	len -= 64;
+
+	while (len >= 64) {
+		x0 = _mm_xor_si128(crc32_fold(x0, crc32_fold512), crc32_load(buffer));
+		x1 = _mm_xor_si128(crc32_fold(x1, crc32_fold512), crc32_load(buffer + 16));
+		x2 = _mm_xor_si128(crc32_fold(x2, crc32_fold512), crc32_load(buffer + 32));
+		x3 = _mm_xor_si128(crc32_fold(x3, crc32_fold512), crc32_load(buffer + 48));
+		buffer += 64;
+		len -= 64;
+	}
+
+	x0 = _mm_xor_si128(crc32_fold(x0, crc32_fold128), x1);
+	x0 = _mm_xor_si128(crc32_fold(x0, crc32_fold128), x2);
+	x0 = _mm_xor_si128(crc32_fold(x0, crc32_fold128), x3);
+
+	while (len >= 16) {
+		x0 = _mm_xor_si128(crc32_fold(x0, crc32_fold128), crc32_load(buffer));
+		buffer += 16;
+		len -= 16;
+	}
+
+	/* back to the byte order of the message */
+	uint8_t folded[16];
+	_mm_storeu_si128((__m128i *)folded, crc32_load((const uint8_t *)&x0));
+
+	crc = crc32_slice8(0, folded, sizeof(folded));
+	return crc32_slice8(crc, buffer, len);
+}
+
+#endif
+
+static void crc32_init(void)
+{
+	crc32_init_tables();
+#ifdef CRC32_HAVE_CLMUL
+	static bool clmul_ready;
+	if (!clmul_ready) {
+		crc32_init_clmul();
+		clmul_ready = true;
+	}
+#endif
+}
+
+enum crc32_engine crc32_best_engine(void)
+{
+	crc32_init();
+#ifdef CRC32_HAVE_CLMUL
+	if (crc32_clmul_supported)
+		return CRC32_ENGINE_CLMUL;
+#endif
+	return CRC32_ENGINE_SLICE8;
+}
+
+bool crc32_update_engine(enum crc32_engine engine, uint32_t *crc,
+		const uint8_t *buffer, size_t len)
+{
+	crc32_init();
+
+	switch (engine) {
+		case CRC32_ENGINE_BYTEWISE:
+			*crc = crc32_bytewise(*crc, buffer, len);
+			return true;
+		case CRC32_ENGINE_SLICE8:
+			*crc = crc32_slice8(*crc, buffer, len);
+			return true;
+		case CRC32_ENGINE_CLMUL:
+#ifdef CRC32_HAVE_CLMUL
+			if (crc32_clmul_supported) {
+				*crc = crc32_clmul(*crc, buffer, len);
+				return true;
+			}
+#endif
+			return false;
+		default:
+			return false;
+	}
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *buffer, size_t len)
+{
+	crc32_update_engine(crc32_best_engine(), &crc, buffer, len);
+	return crc;
+}
+
+const char *crc32_engine_name(enum crc32_engine engine)
+{
+	switch (engine) {
+		case CRC32_ENGINE_BYTEWISE:
+			return "bytewise";
+		case CRC32_ENGINE_SLICE8:
+			return "slice-by-8";
+		case CRC32_ENGINE_CLMUL:
+			return "pclmul";
+		default:
+			return "unknown";
+	}
+}
@@ -0,0 +1,57 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef OPENOCD_HELPER_CRC32_H
+#define OPENOCD_HELPER_CRC32_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file
+ * CRC32 as used by GDB's qCRC packet and by the target side checksum
+ * loaders in contrib/loaders/checksum: polynomial 0x04c11db7, processed most
+ * significant bit first, no final inversion. Callers start with 0xffffffff.
+ */
+
+/** The implementations of crc32_update(), fastest last. */
+enum crc32_engine {
+	CRC32_ENGINE_BYTEWISE,
+	CRC32_ENGINE_SLICE8,
+	CRC32_ENGINE_CLMUL,
+	CRC32_ENGINE_COUNT,
+};
+
+/**
+ * Continue the CRC @a crc over @a len bytes at @a buffer, using the fastest
+ * engine the host supports.
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t *buffer, size_t len);
+
+/**
+ * Same as crc32_update(), with the given engine.
+ * @returns false if the host doesn't support @a engine.
+ */
+bool crc32_update_engine(enum crc32_engine engine, uint32_t *crc,
+		const uint8_t *buffer, size_t len);
+
+/** @returns the name of @a engine. */
+const char *crc32_engine_name(enum crc32_engine engine);
+
+/** @returns the engine crc32_update() uses. */
+enum crc32_engine crc32_best_engine(void);
+
+#endif /* OPENOCD_HELPER_CRC32_H */
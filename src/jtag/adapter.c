@@ -110,6 +110,9 @@ int adapter_init(struct command_context *cmd_ctx)
 
 int adapter_quit(void)
 {
+	if (is_adapter_initialized() && transport_is_jtag())
+		jtag_stats_show(NULL);
+
 	if (is_adapter_initialized() && adapter_driver->quit) {
 		/* close the JTAG interface */
 		int result = adapter_driver->quit();
@@ -31,16 +31,20 @@
 #endif
 
 #include <jtag/jtag.h>
+#include <jtag/interface.h>
 #include <transport/transport.h>
 #include "commands.h"
 
 struct cmd_queue_page {
 	struct cmd_queue_page *next;
 	void *address;
+	size_t size;
 	size_t used;
 };
 
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
+/* pages kept across jtag_command_queue_reset() for the next queue */
+#define CMD_QUEUE_KEEP_PAGES 4
 static struct cmd_queue_page *cmd_queue_pages;
 static struct cmd_queue_page *cmd_queue_pages_tail;
 
@@ -76,8 +80,7 @@ void jtag_queue_command(struct jtag_command *cmd)
 
 void *cmd_queue_alloc(size_t size)
 {
-	struct cmd_queue_page **p_page = &cmd_queue_pages;
-	int offset;
+	size_t offset;
 	uint8_t *t;
 
 	/*
@@ -112,42 +115,56 @@ void *cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
 	/* Done... */
 
-	if (*p_page) {
-		p_page = &cmd_queue_pages_tail;
-		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
-			p_page = &((*p_page)->next);
-	}
-
-	if (!*p_page) {
-		*p_page = malloc(sizeof(struct cmd_queue_page));
-		(*p_page)->used = 0;
-		size_t alloc_size = (size < CMD_QUEUE_PAGE_SIZE) ?
-					CMD_QUEUE_PAGE_SIZE : size;
-		(*p_page)->address = malloc(alloc_size);
-		(*p_page)->next = NULL;
-		cmd_queue_pages_tail = *p_page;
+	struct cmd_queue_page *page = cmd_queue_pages_tail;
+	if (!page || page->size - page->used < size) {
+		struct cmd_queue_page **p_next = page ? &page->next : &cmd_queue_pages;
+		page = *p_next;
+		if (page && page->size >= size) {
+			/* recycle a page left over from a previous queue */
+			page->used = 0;
+		} else {
+			page = malloc(sizeof(struct cmd_queue_page));
+			page->used = 0;
+			page->size = (size < CMD_QUEUE_PAGE_SIZE) ?
+						CMD_QUEUE_PAGE_SIZE : size;
+			page->address = malloc(page->size);
+			page->next = *p_next;
+			*p_next = page;
+		}
+		cmd_queue_pages_tail = page;
 	}
 
-	offset = (*p_page)->used;
-	(*p_page)->used += size;
+	offset = page->used;
+	page->used += size;
 
-	t = (*p_page)->address;
+	t = page->address;
 	return t + offset;
 }
 
+/*
+ * Give back the queue memory. Up to CMD_QUEUE_KEEP_PAGES regular pages are
+ * kept and reused by the following queue, so steady state queuing does not
+ * hit the heap at all; the rest, left by an unusually large queue, is freed.
+ */
 static void cmd_queue_free(void)
 {
-	struct cmd_queue_page *page = cmd_queue_pages;
-
-	while (page) {
-		struct cmd_queue_page *last = page;
+	struct cmd_queue_page **p_page = &cmd_queue_pages;
+	int kept = 0;
+
+	while (*p_page) {
+		struct cmd_queue_page *page = *p_page;
+		if (kept < CMD_QUEUE_KEEP_PAGES && page->size == CMD_QUEUE_PAGE_SIZE) {
+			page->used = 0;
+			p_page = &page->next;
+			kept++;
+			continue;
+		}
+		*p_page = page->next;
 		free(page->address);
-		page = page->next;
-		free(last);
+		free(page);
 	}
 
-	cmd_queue_pages = NULL;
-	cmd_queue_pages_tail = NULL;
+	cmd_queue_pages_tail = cmd_queue_pages;
 }
 
 void jtag_command_queue_reset(void)
@@ -254,7 +271,10 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 		if (cmd->fields[i].in_value) {
 			int num_bits = cmd->fields[i].num_bits;
 			uint8_t *captured = buf_set_buf(buffer, bit_count,
-					malloc(DIV_ROUND_UP(num_bits, 8)), 0, num_bits);
+					cmd->fields[i].in_value, 0, num_bits);
+			/* clear the unused bits, as buf_cpy() would */
+			if (num_bits % 8)
+				captured[num_bits / 8] &= (1 << (num_bits % 8)) - 1;
 
 			if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
 				char *char_buf = buf_to_hex_str(captured,
@@ -266,14 +286,358 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 						i, num_bits, char_buf);
 				free(char_buf);
 			}
-
-			if (cmd->fields[i].in_value)
-				buf_cpy(captured, cmd->fields[i].in_value, num_bits);
-
-			free(captured);
 		}
 		bit_count += cmd->fields[i].num_bits;
 	}
 
 	return retval;
 }
+
+/*
+ * Queue optimizer.
+ *
+ * Before a driver that advertises DEBUG_CAP_QUEUE_OPTIMIZE executes the
+ * queue, walk it once tracking the TAP state and the instruction last
+ * shifted into the IR, and drop or merge the commands that cannot change
+ * what the hardware ends up doing:
+ *  - IR scans that reload the instruction already selected, starting and
+ *    ending in the same stable state;
+ *  - RUNTEST commands that directly follow a RUNTEST ending in IDLE;
+ *  - TLR resets issued while the TAP is known to be in RESET, and zero
+ *    length runtests to the state the TAP is already in;
+ *  - scans left in a shift state, merged with the scan that follows.
+ *
+ * Elided IR scans may have asked for the captured IR bits.  They get the
+ * bits captured by the last full IR scan, either earlier in this queue or
+ * in a previous one, before the jtag callbacks check them.
+ */
+struct elided_ir_scan {
+	/** the scan removed from the queue, whose in_values must be filled */
+	struct scan_command *scan;
+	/** IR scan of this queue to copy the capture from, NULL for the cache */
+	struct scan_command *source;
+	struct elided_ir_scan *next;
+};
+
+static bool queue_optimizer_enabled;
+static struct jtag_queue_optimizer_stats queue_optimizer_stats;
+
+/* TAP state, IR contents and IR capture left by the previously executed queues */
+static tap_state_t optimizer_state = TAP_INVALID;
+static uint8_t *optimizer_ir;
+static int optimizer_ir_bits = -1;
+static uint8_t *optimizer_capture;
+static int optimizer_capture_bits = -1;
+
+/* what executing the queue being optimized will leave behind */
+static tap_state_t queue_state;
+static const uint8_t *queue_ir;
+static int queue_ir_bits;
+static bool queue_ir_changed;
+static struct scan_command *queue_capture;
+static struct elided_ir_scan *elided_ir_scans;
+static struct elided_ir_scan **next_elided_ir_scan;
+
+void jtag_queue_optimizer_enable(bool enable)
+{
+	queue_optimizer_enabled = enable;
+	jtag_command_queue_optimizer_invalidate();
+}
+
+bool jtag_queue_optimizer_is_enabled(void)
+{
+	return queue_optimizer_enabled;
+}
+
+const struct jtag_queue_optimizer_stats *jtag_queue_optimizer_get_stats(void)
+{
+	return &queue_optimizer_stats;
+}
+
+void jtag_queue_optimizer_reset_stats(void)
+{
+	memset(&queue_optimizer_stats, 0, sizeof(queue_optimizer_stats));
+}
+
+void jtag_command_queue_optimizer_invalidate(void)
+{
+	optimizer_state = TAP_INVALID;
+	free(optimizer_ir);
+	optimizer_ir = NULL;
+	optimizer_ir_bits = -1;
+	free(optimizer_capture);
+	optimizer_capture = NULL;
+	optimizer_capture_bits = -1;
+}
+
+static void optimizer_save(uint8_t **dst, int *dst_bits, const uint8_t *src, int bits)
+{
+	free(*dst);
+	*dst = NULL;
+	*dst_bits = -1;
+
+	if (!src || bits <= 0)
+		return;
+
+	*dst = malloc(DIV_ROUND_UP(bits, 8));
+	if (!*dst)
+		return;
+	buf_cpy(src, *dst, bits);
+	*dst_bits = bits;
+}
+
+static bool optimizer_bits_equal(const uint8_t *a, const uint8_t *b, int bits)
+{
+	int bytes = bits / 8;
+	if (memcmp(a, b, bytes) != 0)
+		return false;
+
+	int trailing = bits % 8;
+	if (!trailing)
+		return true;
+
+	uint8_t mask = (1 << trailing) - 1;
+	return ((a[bytes] ^ b[bytes]) & mask) == 0;
+}
+
+/**
+ * Concatenate the out_values (or in_values) of all the fields of a scan
+ * into a buffer allocated with cmd_queue_alloc.
+ * @returns NULL if any of the fields has no such value.
+ */
+static uint8_t *optimizer_gather(const struct scan_command *scan, bool in)
+{
+	int bits = jtag_scan_size(scan);
+	uint8_t *buf = cmd_queue_alloc(DIV_ROUND_UP(bits, 8));
+	int offset = 0;
+
+	for (int i = 0; i < scan->num_fields; i++) {
+		const struct scan_field *field = &scan->fields[i];
+		const uint8_t *value = in ? field->in_value : field->out_value;
+		if (!value)
+			return NULL;
+		buf_set_buf(value, 0, buf, offset, field->num_bits);
+		offset += field->num_bits;
+	}
+
+	return buf;
+}
+
+static void optimizer_scatter(const uint8_t *buf, struct scan_command *scan)
+{
+	int offset = 0;
+
+	for (int i = 0; i < scan->num_fields; i++) {
+		struct scan_field *field = &scan->fields[i];
+		if (field->in_value)
+			buf_set_buf(buf, offset, field->in_value, 0, field->num_bits);
+		offset += field->num_bits;
+	}
+}
+
+static bool optimizer_scan_can_fold(const struct scan_command *a,
+		const struct jtag_command *next)
+{
+	if (!next || next->type != JTAG_SCAN || next->cmd.scan->ir_scan != a->ir_scan)
+		return false;
+
+	return a->end_state == (a->ir_scan ? TAP_IRSHIFT : TAP_DRSHIFT);
+}
+
+static void optimizer_scan_fold(struct jtag_command *cmd)
+{
+	struct jtag_command *next = cmd->next;
+	struct scan_command *a = cmd->cmd.scan;
+	struct scan_command *b = next->cmd.scan;
+	int num_fields = a->num_fields + b->num_fields;
+	struct scan_field *fields = cmd_queue_alloc(num_fields * sizeof(*fields));
+
+	memcpy(fields, a->fields, a->num_fields * sizeof(*fields));
+	memcpy(fields + a->num_fields, b->fields, b->num_fields * sizeof(*fields));
+
+	a->fields = fields;
+	a->num_fields = num_fields;
+	a->end_state = b->end_state;
+	cmd->next = next->next;
+
+	queue_optimizer_stats.scans_folded++;
+}
+
+/**
+ * Decide whether an IR scan can be left out of the queue.
+ * @returns true if it was recorded as elided.
+ */
+static bool optimizer_elide_ir_scan(struct scan_command *scan, tap_state_t state,
+		const uint8_t *out, int bits)
+{
+	if (!out || bits <= 0 || queue_ir_bits != bits)
+		return false;
+
+	/* the scan must leave the TAP where it found it, with the IR latched */
+	if (state != scan->end_state || !tap_is_state_stable(state)
+			|| state == TAP_RESET || state == TAP_IRPAUSE)
+		return false;
+
+	if (!optimizer_bits_equal(queue_ir, out, bits))
+		return false;
+
+	struct scan_command *source = NULL;
+	if (jtag_scan_type(scan) & SCAN_IN) {
+		if (queue_capture && jtag_scan_size(queue_capture) == bits)
+			source = queue_capture;
+		else if (optimizer_capture_bits != bits)
+			return false;
+	}
+
+	struct elided_ir_scan *elided = cmd_queue_alloc(sizeof(*elided));
+	elided->scan = scan;
+	elided->source = source;
+	elided->next = NULL;
+	*next_elided_ir_scan = elided;
+	next_elided_ir_scan = &elided->next;
+
+	queue_optimizer_stats.ir_scans_elided++;
+	return true;
+}
+
+static void optimizer_track_ir_scan(struct scan_command *scan, const uint8_t *out, int bits)
+{
+	queue_ir_changed = true;
+	if (out && scan->end_state != TAP_IRSHIFT && scan->end_state != TAP_IRPAUSE) {
+		queue_ir = out;
+		queue_ir_bits = bits;
+	} else {
+		queue_ir_bits = -1;
+	}
+
+	for (int i = 0; i < scan->num_fields; i++)
+		if (!scan->fields[i].in_value)
+			return;
+	queue_capture = scan;
+}
+
+static void optimizer_forget_ir(void)
+{
+	queue_ir_changed = true;
+	queue_ir_bits = -1;
+}
+
+/**
+ * Optimize the queue in place, just before the driver executes it.
+ * Must be followed by jtag_command_queue_optimize_done() once the
+ * driver has returned, and before the queue is reset.
+ */
+void jtag_command_queue_optimize(void)
+{
+	tap_state_t state = optimizer_state;
+	struct jtag_command **link = &jtag_command_queue;
+
+	queue_ir = optimizer_ir;
+	queue_ir_bits = optimizer_ir_bits;
+	queue_ir_changed = false;
+	queue_capture = NULL;
+	elided_ir_scans = NULL;
+	next_elided_ir_scan = &elided_ir_scans;
+
+	while (*link) {
+		struct jtag_command *cmd = *link;
+		queue_optimizer_stats.commands_in++;
+
+		switch (cmd->type) {
+		case JTAG_SCAN: {
+			struct scan_command *scan = cmd->cmd.scan;
+			while (optimizer_scan_can_fold(scan, cmd->next)) {
+				queue_optimizer_stats.commands_in++;
+				optimizer_scan_fold(cmd);
+			}
+			if (scan->ir_scan) {
+				const uint8_t *out = optimizer_gather(scan, false);
+				int bits = jtag_scan_size(scan);
+				if (optimizer_elide_ir_scan(scan, state, out, bits)) {
+					*link = cmd->next;
+					continue;
+				}
+				optimizer_track_ir_scan(scan, out, bits);
+			}
+			state = scan->end_state;
+			break;
+		}
+		case JTAG_RUNTEST: {
+			struct runtest_command *runtest = cmd->cmd.runtest;
+			while (cmd->next && cmd->next->type == JTAG_RUNTEST
+					&& runtest->end_state == TAP_IDLE
+					&& cmd->next->cmd.runtest->num_cycles <= INT_MAX - runtest->num_cycles) {
+				runtest->num_cycles += cmd->next->cmd.runtest->num_cycles;
+				runtest->end_state = cmd->next->cmd.runtest->end_state;
+				cmd->next = cmd->next->next;
+				queue_optimizer_stats.commands_in++;
+				queue_optimizer_stats.runtests_merged++;
+			}
+			if (runtest->num_cycles == 0 && state == TAP_IDLE
+					&& runtest->end_state == TAP_IDLE) {
+				queue_optimizer_stats.moves_elided++;
+				*link = cmd->next;
+				continue;
+			}
+			state = runtest->end_state;
+			break;
+		}
+		case JTAG_TLR_RESET:
+			/* The tracked state may be wrong, which is when TLR resets
+			 * get queued, so only drop the ones that directly follow. */
+			while (cmd->next && cmd->next->type == JTAG_TLR_RESET) {
+				cmd->next = cmd->next->next;
+				queue_optimizer_stats.commands_in++;
+				queue_optimizer_stats.moves_elided++;
+			}
+			state = TAP_RESET;
+			optimizer_forget_ir();
+			break;
+		case JTAG_PATHMOVE:
+			state = cmd->cmd.pathmove->path[cmd->cmd.pathmove->num_states - 1];
+			optimizer_forget_ir();
+			break;
+		case JTAG_RESET:
+		case JTAG_TMS:
+			state = TAP_INVALID;
+			optimizer_forget_ir();
+			break;
+		default:
+			break;
+		}
+
+		queue_optimizer_stats.commands_out++;
+		link = &cmd->next;
+	}
+
+	next_command_pointer = link;
+	queue_state = state;
+}
+
+/**
+ * Complete the elided IR scans once the driver executed the optimized
+ * queue, and remember the IR state for the next one.
+ */
+void jtag_command_queue_optimize_done(int retval)
+{
+	if (retval != ERROR_OK) {
+		elided_ir_scans = NULL;
+		jtag_command_queue_optimizer_invalidate();
+		return;
+	}
+
+	for (struct elided_ir_scan *e = elided_ir_scans; e; e = e->next) {
+		const uint8_t *capture = e->source ? optimizer_gather(e->source, true)
+				: optimizer_capture;
+		optimizer_scatter(capture, e->scan);
+	}
+	elided_ir_scans = NULL;
+
+	optimizer_state = queue_state;
+	if (queue_capture)
+		optimizer_save(&optimizer_capture, &optimizer_capture_bits,
+				optimizer_gather(queue_capture, true), jtag_scan_size(queue_capture));
+
+	if (queue_ir_changed)
+		optimizer_save(&optimizer_ir, &optimizer_ir_bits, queue_ir, queue_ir_bits);
+}
@@ -174,4 +174,29 @@ int jtag_scan_size(const struct scan_command *cmd);
 int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd);
 int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer);
 
+/** Commands removed or merged by the queue optimizer since the last reset. */
+struct jtag_queue_optimizer_stats {
+	/** commands handed to the optimizer */
+	uint64_t commands_in;
+	/** commands left for the driver to execute */
+	uint64_t commands_out;
+	/** IR scans reloading the instruction already in the IR */
+	uint64_t ir_scans_elided;
+	/** adjacent RUNTEST commands merged into one */
+	uint64_t runtests_merged;
+	/** TLR resets and zero length runtests that did not move the TAP */
+	uint64_t moves_elided;
+	/** scans left in a shift state merged with the following scan */
+	uint64_t scans_folded;
+};
+
+void jtag_queue_optimizer_enable(bool enable);
+bool jtag_queue_optimizer_is_enabled(void);
+const struct jtag_queue_optimizer_stats *jtag_queue_optimizer_get_stats(void);
+void jtag_queue_optimizer_reset_stats(void);
+
+void jtag_command_queue_optimize(void);
+void jtag_command_queue_optimize_done(int retval);
+void jtag_command_queue_optimizer_invalidate(void);
+
 #endif /* OPENOCD_JTAG_COMMANDS_H */
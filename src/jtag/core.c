@@ -55,6 +55,29 @@ static int jtag_flush_queue_count;
 /* Sleep this # of ms after flushing the queue */
 static int jtag_flush_queue_sleep;
 
+/* Flush latency histogram: bucket i counts the flushes that took
+ * [2^i, 2^(i+1)) us, bucket 0 also counts the ones below 1 us. */
+#define JTAG_STATS_HISTOGRAM_BUCKETS	24
+#define JTAG_STATS_MAX_TAGS			16
+
+struct jtag_flush_stats {
+	uint64_t flushes;
+	uint64_t usec;
+};
+
+static struct jtag_flush_stats jtag_flush_stats;
+static uint64_t jtag_empty_flushes;
+static uint64_t jtag_flush_histogram[JTAG_STATS_HISTOGRAM_BUCKETS];
+/* scans as handed to the adapter driver, after the queue optimizer */
+static struct jtag_scan_stats jtag_adapter_scan_stats;
+
+static struct {
+	const char *name;
+	struct jtag_flush_stats stats;
+} jtag_stats_tags[JTAG_STATS_MAX_TAGS];
+static unsigned int jtag_stats_tag_count;
+static const char *jtag_stats_tag;
+
 static void jtag_add_scan_check(struct jtag_tap *active,
 		void (*jtag_add_scan)(struct jtag_tap *active,
 		int in_num_fields,
@@ -352,6 +375,9 @@ void jtag_add_ir_scan_noverify(struct jtag_tap *active, const struct scan_field
 {
 	jtag_prelude(state);
 
+	active->scan_stats.ir_scans++;
+	active->scan_stats.ir_bits += in_fields->num_bits;
+
 	int retval = interface_jtag_add_ir_scan(active, in_fields, state);
 	jtag_set_error(retval);
 }
@@ -451,6 +477,10 @@ void jtag_add_dr_scan(struct jtag_tap *active,
 
 	jtag_prelude(state);
 
+	active->scan_stats.dr_scans++;
+	for (int i = 0; i < in_num_fields; i++)
+		active->scan_stats.dr_bits += in_fields[i].num_bits;
+
 	int retval;
 	retval = interface_jtag_add_dr_scan(active, in_num_fields, in_fields, state);
 	jtag_set_error(retval);
@@ -619,6 +649,7 @@ static int adapter_system_reset(int req_srst)
 
 	/* Maybe change SRST signal state */
 	if (jtag_srst != req_srst) {
+		jtag_command_queue_optimizer_invalidate();
 		retval = adapter_driver->reset(0, req_srst);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("SRST error");
@@ -805,6 +836,7 @@ void jtag_add_reset(int req_tlr_or_trst, int req_srst)
 		/* guarantee jtag queue empty before changing reset status */
 		jtag_execute_queue();
 
+		jtag_command_queue_optimizer_invalidate();
 		retval = adapter_driver->reset(new_trst, new_srst);
 		if (retval != ERROR_OK) {
 			jtag_set_error(retval);
@@ -945,8 +977,33 @@ int default_interface_jtag_execute_queue(void)
 			return ERROR_OK;
 	}
 
+	bool optimize = jtag_queue_optimizer_is_enabled()
+			&& (adapter_driver->jtag_ops->supported & DEBUG_CAP_QUEUE_OPTIMIZE);
+	if (optimize)
+		jtag_command_queue_optimize();
+
+	if (!jtag_command_queue)
+		jtag_empty_flushes++;
+	for (struct jtag_command *cmd = jtag_command_queue; cmd; cmd = cmd->next) {
+		if (cmd->type != JTAG_SCAN)
+			continue;
+		uint64_t bits = 0;
+		for (int i = 0; i < cmd->cmd.scan->num_fields; i++)
+			bits += cmd->cmd.scan->fields[i].num_bits;
+		if (cmd->cmd.scan->ir_scan) {
+			jtag_adapter_scan_stats.ir_scans++;
+			jtag_adapter_scan_stats.ir_bits += bits;
+		} else {
+			jtag_adapter_scan_stats.dr_scans++;
+			jtag_adapter_scan_stats.dr_bits += bits;
+		}
+	}
+
 	int result = adapter_driver->jtag_ops->execute_queue();
 
+	if (optimize)
+		jtag_command_queue_optimize_done(result);
+
 	struct jtag_command *cmd = jtag_command_queue;
 	while (debug_level >= LOG_LVL_DEBUG_IO && cmd) {
 		switch (cmd->type) {
@@ -1009,11 +1066,52 @@ int default_interface_jtag_execute_queue(void)
 	return result;
 }
 
+static int64_t jtag_stats_usec(void)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static void jtag_stats_record_flush(int64_t usec)
+{
+	if (usec < 0)
+		usec = 0;
+
+	jtag_flush_stats.flushes++;
+	jtag_flush_stats.usec += usec;
+
+	unsigned int bucket = 0;
+	for (int64_t v = usec; v >= 2 && bucket < JTAG_STATS_HISTOGRAM_BUCKETS - 1; v >>= 1)
+		bucket++;
+	jtag_flush_histogram[bucket]++;
+
+	/* "other" gathers the untagged flushes and the ones that do not fit */
+	const char *tag = jtag_stats_tag ? jtag_stats_tag : "other";
+	unsigned int i;
+	for (i = 0; i < jtag_stats_tag_count; i++) {
+		if (jtag_stats_tags[i].name == tag || !strcmp(jtag_stats_tags[i].name, tag))
+			break;
+	}
+	if (i == jtag_stats_tag_count) {
+		if (i == JTAG_STATS_MAX_TAGS)
+			return;
+		jtag_stats_tags[i].name = tag;
+		jtag_stats_tag_count++;
+	}
+	jtag_stats_tags[i].stats.flushes++;
+	jtag_stats_tags[i].stats.usec += usec;
+}
+
 void jtag_execute_queue_noclear(void)
 {
+	int64_t start = jtag_stats_usec();
+
 	jtag_flush_queue_count++;
 	jtag_set_error(interface_jtag_execute_queue());
 
+	jtag_stats_record_flush(jtag_stats_usec() - start);
+
 	if (jtag_flush_queue_sleep > 0) {
 		/* For debug purposes it can be useful to test performance
 		 * or behavior when delaying after flushing the queue,
@@ -1028,6 +1126,96 @@ int jtag_get_flush_queue_count(void)
 	return jtag_flush_queue_count;
 }
 
+int jtag_execute_queue_tagged(const char *tag)
+{
+	const char *prev_tag = jtag_stats_push_tag(tag);
+	int retval = jtag_execute_queue();
+	jtag_stats_pop_tag(prev_tag);
+	return retval;
+}
+
+const char *jtag_stats_push_tag(const char *tag)
+{
+	const char *prev_tag = jtag_stats_tag;
+	if (!prev_tag)
+		jtag_stats_tag = tag;
+	return prev_tag;
+}
+
+void jtag_stats_pop_tag(const char *prev_tag)
+{
+	jtag_stats_tag = prev_tag;
+}
+
+static void jtag_stats_print(struct command_invocation *cmd, const char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	char *string = alloc_vprintf(format, ap);
+	va_end(ap);
+
+	if (!string)
+		return;
+	if (cmd)
+		command_print(cmd, "%s", string);
+	else
+		LOG_DEBUG("%s", string);
+	free(string);
+}
+
+void jtag_stats_show(struct command_invocation *cmd)
+{
+	const struct jtag_scan_stats *scans = &jtag_adapter_scan_stats;
+
+	jtag_stats_print(cmd, "adapter %s: %" PRIu64 " flushes (%" PRIu64 " empty), %" PRIu64 " us",
+			adapter_driver ? adapter_driver->name : "none",
+			jtag_flush_stats.flushes, jtag_empty_flushes, jtag_flush_stats.usec);
+	jtag_stats_print(cmd, "  %" PRIu64 " IR scans (%" PRIu64 " bits), %" PRIu64 " DR scans (%" PRIu64 " bits)",
+			scans->ir_scans, scans->ir_bits, scans->dr_scans, scans->dr_bits);
+
+	if (jtag_flush_stats.flushes)
+		jtag_stats_print(cmd, "  flush latency:");
+	for (unsigned int i = 0; i < JTAG_STATS_HISTOGRAM_BUCKETS; i++) {
+		char label[32];
+
+		if (!jtag_flush_histogram[i])
+			continue;
+		if (i == 0)
+			snprintf(label, sizeof(label), "< 2 us");
+		else if (i == JTAG_STATS_HISTOGRAM_BUCKETS - 1)
+			snprintf(label, sizeof(label), ">= %u us", 1u << i);
+		else
+			snprintf(label, sizeof(label), "%u - %u us", 1u << i, 1u << (i + 1));
+		jtag_stats_print(cmd, "    %20s: %" PRIu64, label, jtag_flush_histogram[i]);
+	}
+
+	for (unsigned int i = 0; i < jtag_stats_tag_count; i++) {
+		jtag_stats_print(cmd, "caller %s: %" PRIu64 " flushes, %" PRIu64 " us",
+				jtag_stats_tags[i].name, jtag_stats_tags[i].stats.flushes,
+				jtag_stats_tags[i].stats.usec);
+	}
+
+	for (struct jtag_tap *tap = jtag_all_taps(); tap; tap = tap->next_tap) {
+		scans = &tap->scan_stats;
+		jtag_stats_print(cmd, "tap %s: %" PRIu64 " IR scans (%" PRIu64 " bits), %" PRIu64
+				" DR scans (%" PRIu64 " bits)", tap->dotted_name,
+				scans->ir_scans, scans->ir_bits, scans->dr_scans, scans->dr_bits);
+	}
+}
+
+void jtag_stats_reset(void)
+{
+	memset(&jtag_flush_stats, 0, sizeof(jtag_flush_stats));
+	jtag_empty_flushes = 0;
+	memset(jtag_flush_histogram, 0, sizeof(jtag_flush_histogram));
+	memset(&jtag_adapter_scan_stats, 0, sizeof(jtag_adapter_scan_stats));
+	memset(jtag_stats_tags, 0, sizeof(jtag_stats_tags));
+	jtag_stats_tag_count = 0;
+
+	for (struct jtag_tap *tap = jtag_all_taps(); tap; tap = tap->next_tap)
+		memset(&tap->scan_stats, 0, sizeof(tap->scan_stats));
+}
+
 int jtag_execute_queue(void)
 {
 	jtag_execute_queue_noclear();
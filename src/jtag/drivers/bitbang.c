@@ -77,12 +77,19 @@ static int bitbang_state_move(int skip)
 	uint8_t tms_scan = tap_get_tms_path(tap_get_state(), tap_get_end_state());
 	int tms_count = tap_get_tms_path_len(tap_get_state(), tap_get_end_state());
 
-	for (i = skip; i < tms_count; i++) {
-		tms = (tms_scan >> i) & 1;
-		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
-			return ERROR_FAIL;
-		if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+	if (bitbang_interface->write_vector && tms_count > skip) {
+		uint8_t tms_bits = tms_scan >> skip;
+		if (bitbang_interface->write_vector(&tms_bits, NULL, NULL, tms_count - skip) != ERROR_OK)
 			return ERROR_FAIL;
+		tms = (tms_scan >> (tms_count - 1)) & 1;
+	} else {
+		for (i = skip; i < tms_count; i++) {
+			tms = (tms_scan >> i) & 1;
+			if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
+				return ERROR_FAIL;
+			if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+				return ERROR_FAIL;
+		}
 	}
 	if (bitbang_interface->write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
 		return ERROR_FAIL;
@@ -103,12 +110,18 @@ static int bitbang_execute_tms(struct jtag_command *cmd)
 	LOG_DEBUG_IO("TMS: %d bits", num_bits);
 
 	int tms = 0;
-	for (unsigned i = 0; i < num_bits; i++) {
-		tms = ((bits[i/8] >> (i % 8)) & 1);
-		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
-			return ERROR_FAIL;
-		if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+	if (bitbang_interface->write_vector && num_bits) {
+		if (bitbang_interface->write_vector(bits, NULL, NULL, num_bits) != ERROR_OK)
 			return ERROR_FAIL;
+		tms = (bits[(num_bits - 1) / 8] >> ((num_bits - 1) % 8)) & 1;
+	} else {
+		for (unsigned i = 0; i < num_bits; i++) {
+			tms = ((bits[i/8] >> (i % 8)) & 1);
+			if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
+				return ERROR_FAIL;
+			if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+				return ERROR_FAIL;
+		}
 	}
 	if (bitbang_interface->write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
 		return ERROR_FAIL;
@@ -166,11 +179,16 @@ static int bitbang_runtest(int num_cycles)
 	}
 
 	/* execute num_cycles */
-	for (i = 0; i < num_cycles; i++) {
-		if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
-			return ERROR_FAIL;
-		if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
+	if (bitbang_interface->write_vector && num_cycles > 0) {
+		if (bitbang_interface->write_vector(NULL, NULL, NULL, num_cycles) != ERROR_OK)
 			return ERROR_FAIL;
+	} else {
+		for (i = 0; i < num_cycles; i++) {
+			if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
+				return ERROR_FAIL;
+			if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
+				return ERROR_FAIL;
+		}
 	}
 	if (bitbang_interface->write(CLOCK_IDLE(), 0, 0) != ERROR_OK)
 		return ERROR_FAIL;
@@ -219,8 +237,20 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		bitbang_end_state(saved_end_state);
 	}
 
+	/* all bits but the last one, which leaves the shift state, can go out
+	 * as a single vector when the driver supports it */
+	bit_cnt = 0;
+	if (bitbang_interface->write_vector && scan_size > 1) {
+		if (bitbang_interface->write_vector(NULL,
+				type != SCAN_IN ? buffer : NULL,
+				type != SCAN_OUT ? buffer : NULL,
+				scan_size - 1) != ERROR_OK)
+			return ERROR_FAIL;
+		bit_cnt = scan_size - 1;
+	}
+
 	size_t buffered = 0;
-	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
+	for (; bit_cnt < scan_size; bit_cnt++) {
 		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
 		int tdi;
 		int bytec = bit_cnt/8;
@@ -54,6 +54,17 @@ struct bitbang_interface {
 	/** Set TCK, TMS, and TDI to the given values. */
 	int (*write)(int tck, int tms, int tdi);
 
+	/** Clock num_bits bits in one call (optional).
+	 *
+	 * For each bit, drive TCK low with TMS and TDI taken from the vectors,
+	 * sample TDO into tdo, then drive TCK high. Vectors are LSB first. A NULL
+	 * tms or tdi vector means all zeroes, a NULL tdo means TDO is not needed.
+	 * tdo may point to the same buffer as tdi. TCK is left high; the caller
+	 * brings it back to idle with write(). When this is not implemented the
+	 * bits are clocked one at a time through write() and read()/sample(). */
+	int (*write_vector)(const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo,
+			unsigned int num_bits);
+
 	/** Blink led (optional). */
 	int (*blink)(int on);
 
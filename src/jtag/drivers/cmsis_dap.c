@@ -229,6 +229,8 @@ struct pending_transfer_result {
 struct pending_request_block {
 	struct pending_transfer_result *transfers;
 	int transfer_count;
+	/** CMD_DAP_TFER or CMD_DAP_TFER_BLOCK, as sent to the adapter */
+	uint8_t command;
 };
 
 struct pending_scan_result {
@@ -243,13 +245,19 @@ struct pending_scan_result {
 };
 
 /* Up to MIN(packet_count, MAX_PENDING_REQUESTS) requests may be issued
- * until the first response arrives */
+ * until the first response arrives. The limit only applies to the HID
+ * backend; with USB bulk the whole packet count reported by the adapter
+ * is used. */
 #define MAX_PENDING_REQUESTS 3
 
 /* Pending requests are organized as a FIFO - circular buffer */
-/* Each block in FIFO can contain up to pending_queue_len transfers */
+/* Each block in FIFO can contain up to pending_queue_len transfers, or up to
+ * pending_block_len transfers when they all access the same AP register and
+ * are sent as a single DAP_TransferBlock */
 static int pending_queue_len;
-static struct pending_request_block pending_fifo[MAX_PENDING_REQUESTS];
+static int pending_block_len;
+static struct pending_request_block *pending_fifo;
+static int pending_fifo_size;
 static int pending_fifo_put_idx, pending_fifo_get_idx;
 static int pending_fifo_block_count;
 
@@ -324,10 +332,11 @@ static void cmsis_dap_close(struct cmsis_dap *dap)
 	free(cmsis_dap_handle);
 	cmsis_dap_handle = NULL;
 
-	for (int i = 0; i < MAX_PENDING_REQUESTS; i++) {
+	for (int i = 0; i < pending_fifo_size; i++)
 		free(pending_fifo[i].transfers);
-		pending_fifo[i].transfers = NULL;
-	}
+	free(pending_fifo);
+	pending_fifo = NULL;
+	pending_fifo_size = 0;
 }
 
 static void cmsis_dap_flush_read(struct cmsis_dap *dap)
@@ -769,6 +778,39 @@ static int cmsis_dap_cmd_dap_swo_data(
 	return ERROR_OK;
 }
 
+/* DAP_TransferBlock repeats one request, only AP accesses are sent that way */
+static bool cmsis_dap_swd_is_block(const struct pending_request_block *block)
+{
+	if (block->transfer_count < 2)
+		return false;
+
+	uint8_t cmd = block->transfers[0].cmd;
+	if (!(cmd & SWD_CMD_APNDP))
+		return false;
+
+	for (int i = 1; i < block->transfer_count; i++)
+		if (block->transfers[i].cmd != cmd)
+			return false;
+
+	return true;
+}
+
+/* Check if cmd can't be added to the block without overflowing the packet */
+static bool cmsis_dap_swd_is_full(const struct pending_request_block *block, uint8_t cmd)
+{
+	if (block->transfer_count >= pending_block_len)
+		return true;
+	if (block->transfer_count < pending_queue_len)
+		return false;
+
+	/* Past the DAP_Transfer budget the block must stay a DAP_TransferBlock.
+	 * Beyond pending_queue_len it already is one, so only the first
+	 * transfer needs to be compared. */
+	if (cmd != block->transfers[0].cmd || !(cmd & SWD_CMD_APNDP))
+		return true;
+	return block->transfer_count == pending_queue_len && !cmsis_dap_swd_is_block(block);
+}
+
 static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 {
 	uint8_t *command = cmsis_dap_handle->command;
@@ -784,44 +826,70 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 	if (block->transfer_count == 0)
 		goto skip;
 
-	command[0] = CMD_DAP_TFER;
-	command[1] = 0x00;	/* DAP Index */
-	command[2] = block->transfer_count;
-	size_t idx = 3;
+	size_t idx;
+	if (cmsis_dap_swd_is_block(block)) {
+		/* The same AP register accessed over and over, as done by
+		 * mem_ap_read_buf()/mem_ap_write_buf(). Send it as a single
+		 * DAP_TransferBlock which doesn't repeat the request byte */
+		uint8_t cmd = block->transfers[0].cmd;
 
-	for (int i = 0; i < block->transfer_count; i++) {
-		struct pending_transfer_result *transfer = &(block->transfers[i]);
-		uint8_t cmd = transfer->cmd;
-		uint32_t data = transfer->data;
-
-		LOG_DEBUG_IO("%s %s reg %x %"PRIx32,
-				cmd & SWD_CMD_APNDP ? "AP" : "DP",
-				cmd & SWD_CMD_RNW ? "read" : "write",
-			  (cmd & SWD_CMD_A32) >> 1, data);
-
-		/* When proper WAIT handling is implemented in the
-		 * common SWD framework, this kludge can be
-		 * removed. However, this might lead to minor
-		 * performance degradation as the adapter wouldn't be
-		 * able to automatically retry anything (because ARM
-		 * has forgotten to implement sticky error flags
-		 * clearing). See also comments regarding
-		 * cmsis_dap_cmd_dap_tfer_configure() and
-		 * cmsis_dap_cmd_dap_swd_configure() in
-		 * cmsis_dap_init().
-		 */
-		if (!(cmd & SWD_CMD_RNW) &&
-		    !(cmd & SWD_CMD_APNDP) &&
-		    (cmd & SWD_CMD_A32) >> 1 == DP_CTRL_STAT &&
-		    (data & CORUNDETECT)) {
-			LOG_DEBUG("refusing to enable sticky overrun detection");
-			data &= ~CORUNDETECT;
-		}
+		LOG_DEBUG_IO("AP %s reg %x, block of %d", cmd & SWD_CMD_RNW ? "read" : "write",
+				(cmd & SWD_CMD_A32) >> 1, block->transfer_count);
+
+		block->command = CMD_DAP_TFER_BLOCK;
+		command[0] = CMD_DAP_TFER_BLOCK;
+		command[1] = 0x00;	/* DAP Index */
+		h_u16_to_le(&command[2], block->transfer_count);
+		command[4] = (cmd >> 1) & 0x0f;
+		idx = 5;
 
-		command[idx++] = (cmd >> 1) & 0x0f;
 		if (!(cmd & SWD_CMD_RNW)) {
-			h_u32_to_le(&command[idx], data);
-			idx += 4;
+			for (int i = 0; i < block->transfer_count; i++) {
+				h_u32_to_le(&command[idx], block->transfers[i].data);
+				idx += 4;
+			}
+		}
+	} else {
+		block->command = CMD_DAP_TFER;
+		command[0] = CMD_DAP_TFER;
+		command[1] = 0x00;	/* DAP Index */
+		command[2] = block->transfer_count;
+		idx = 3;
+
+		for (int i = 0; i < block->transfer_count; i++) {
+			struct pending_transfer_result *transfer = &(block->transfers[i]);
+			uint8_t cmd = transfer->cmd;
+			uint32_t data = transfer->data;
+
+			LOG_DEBUG_IO("%s %s reg %x %"PRIx32,
+					cmd & SWD_CMD_APNDP ? "AP" : "DP",
+					cmd & SWD_CMD_RNW ? "read" : "write",
+				  (cmd & SWD_CMD_A32) >> 1, data);
+
+			/* When proper WAIT handling is implemented in the
+			 * common SWD framework, this kludge can be
+			 * removed. However, this might lead to minor
+			 * performance degradation as the adapter wouldn't be
+			 * able to automatically retry anything (because ARM
+			 * has forgotten to implement sticky error flags
+			 * clearing). See also comments regarding
+			 * cmsis_dap_cmd_dap_tfer_configure() and
+			 * cmsis_dap_cmd_dap_swd_configure() in
+			 * cmsis_dap_init().
+			 */
+			if (!(cmd & SWD_CMD_RNW) &&
+			    !(cmd & SWD_CMD_APNDP) &&
+			    (cmd & SWD_CMD_A32) >> 1 == DP_CTRL_STAT &&
+			    (data & CORUNDETECT)) {
+				LOG_DEBUG("refusing to enable sticky overrun detection");
+				data &= ~CORUNDETECT;
+			}
+
+			command[idx++] = (cmd >> 1) & 0x0f;
+			if (!(cmd & SWD_CMD_RNW)) {
+				h_u32_to_le(&command[idx], data);
+				idx += 4;
+			}
 		}
 	}
 
@@ -863,16 +931,28 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
 	}
 
 	uint8_t *resp = dap->response;
-	if (resp[0] != CMD_DAP_TFER) {
+	if (resp[0] != block->command) {
 		LOG_ERROR("CMSIS-DAP command mismatch. Expected 0x%x received 0x%" PRIx8,
-			CMD_DAP_TFER, resp[0]);
+			block->command, resp[0]);
 		queued_retval = ERROR_FAIL;
 		goto skip;
 	}
 
-	uint8_t transfer_count = resp[1];
-	uint8_t ack = resp[2] & 0x07;
-	if (resp[2] & 0x08) {
+	int transfer_count;
+	uint8_t transfer_response;
+	size_t idx;
+	if (block->command == CMD_DAP_TFER_BLOCK) {
+		transfer_count = le_to_h_u16(&resp[1]);
+		transfer_response = resp[3];
+		idx = 4;
+	} else {
+		transfer_count = resp[1];
+		transfer_response = resp[2];
+		idx = 3;
+	}
+
+	uint8_t ack = transfer_response & 0x07;
+	if (transfer_response & 0x08) {
 		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", transfer_count);
 		queued_retval = ERROR_FAIL;
 		goto skip;
@@ -891,7 +971,6 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
 
 	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %d",
 		 transfer_count, pending_fifo_get_idx);
-	size_t idx = 3;
 	for (int i = 0; i < transfer_count; i++) {
 		struct pending_transfer_result *transfer = &(block->transfers[i]);
 		if (transfer->cmd & SWD_CMD_RNW) {
@@ -943,7 +1022,7 @@ static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 {
 	bool targetsel_cmd = swd_cmd(false, false, DP_TARGETSEL) == cmd;
 
-	if (pending_fifo[pending_fifo_put_idx].transfer_count == pending_queue_len
+	if (cmsis_dap_swd_is_full(&pending_fifo[pending_fifo_put_idx], cmd)
 			 || targetsel_cmd) {
 		if (pending_fifo_block_count)
 			cmsis_dap_swd_read_process(cmsis_dap_handle, 0);
@@ -1221,8 +1300,7 @@ static int cmsis_dap_init(void)
 		if (pkt_sz != cmsis_dap_handle->packet_size) {
 
 			/* 4 bytes of command header + 5 bytes per register
-			 * write. For bulk read sequences just 4 bytes are
-			 * needed per transfer, so this is suboptimal. */
+			 * write in DAP_Transfer */
 			pending_queue_len = (pkt_sz - 4) / 5;
 
 			free(cmsis_dap_handle->packet_buffer);
@@ -1234,6 +1312,10 @@ static int cmsis_dap_init(void)
 		}
 	}
 
+	/* DAP_TransferBlock has 5 bytes of command header and 4 bytes per
+	 * write, its reply 4 bytes of header and 4 bytes per read */
+	pending_block_len = MAX((cmsis_dap_handle->packet_size - 5) / 4, pending_queue_len);
+
 	/* INFO_ID_PKT_CNT - byte */
 	retval = cmsis_dap_cmd_dap_info(INFO_ID_PKT_CNT, &data);
 	if (retval != ERROR_OK)
@@ -1241,15 +1323,26 @@ static int cmsis_dap_init(void)
 
 	if (data[0] == 1) { /* byte */
 		int pkt_cnt = data[1];
-		if (pkt_cnt > 1)
-			cmsis_dap_handle->packet_count = MIN(MAX_PENDING_REQUESTS, pkt_cnt);
+		if (pkt_cnt > 1) {
+			if (strcmp(cmsis_dap_handle->backend->name, "hid") == 0)
+				cmsis_dap_handle->packet_count = MIN(MAX_PENDING_REQUESTS, pkt_cnt);
+			else
+				cmsis_dap_handle->packet_count = pkt_cnt;
+		}
 
 		LOG_DEBUG("CMSIS-DAP: Packet Count = %d", pkt_cnt);
 	}
 
 	LOG_DEBUG("Allocating FIFO for %d pending packets", cmsis_dap_handle->packet_count);
+	pending_fifo = calloc(cmsis_dap_handle->packet_count, sizeof(*pending_fifo));
+	if (!pending_fifo) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+		retval = ERROR_FAIL;
+		goto init_err;
+	}
+	pending_fifo_size = cmsis_dap_handle->packet_count;
 	for (int i = 0; i < cmsis_dap_handle->packet_count; i++) {
-		pending_fifo[i].transfers = malloc(pending_queue_len * sizeof(struct pending_transfer_result));
+		pending_fifo[i].transfers = malloc(pending_block_len * sizeof(struct pending_transfer_result));
 		if (!pending_fifo[i].transfers) {
 			LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
 			retval = ERROR_FAIL;
@@ -1698,7 +1698,7 @@ static const struct swd_driver ftdi_swd = {
 static const char * const ftdi_transports[] = { "jtag", "swd", NULL };
 
 static struct jtag_interface ftdi_interface = {
-	.supported = DEBUG_CAP_TMS_SEQ,
+	.supported = DEBUG_CAP_TMS_SEQ | DEBUG_CAP_QUEUE_OPTIMIZE,
 	.execute_queue = ftdi_execute_queue,
 };
 
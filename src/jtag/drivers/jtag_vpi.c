@@ -49,6 +49,27 @@
 #define CMD_SCAN_CHAIN_FLIP_TMS	3
 #define CMD_STOP_SIMU		4
 
+/*
+ * Packed mode: after the server acknowledged CMD_PACKED_MODE (and replied to
+ * the legacy packet following it), commands are sent as variable length
+ * records: the command byte, a flags byte, the number of bits as a 32 bit
+ * little endian value and, unless PACKED_TDI_ONES is set, (nb_bits + 7) / 8
+ * bytes of TMS or TDI data. Records with PACKED_CAPTURE make the server
+ * return the captured TDO bytes, in order, without any framing. A batch is
+ * ended by CMD_PACKED_FLUSH, upon which the server sends out all pending
+ * replies. This way one jtag_execute_queue() needs a single send and at most
+ * a single receive.
+ */
+#define CMD_PACKED_MODE		5
+#define CMD_PACKED_FLUSH	6
+
+#define PACKED_CAPTURE		0x01
+#define PACKED_TDI_ONES		0x02
+
+/* End a batch early once this many TDO bytes are waiting to come back, so
+ * the replies can't fill up the socket buffers while the batch is sent. */
+#define PACKED_MAX_PENDING	(64 * 1024)
+
 /* jtag_vpi server port and address to connect to */
 static int server_port = DEFAULT_SERVER_PORT;
 static char *server_address;
@@ -56,6 +77,13 @@ static char *server_address;
 /* Send CMD_STOP_SIMU to server when OpenOCD exits? */
 static bool stop_sim_on_exit;
 
+/* Try to switch the connection to packed mode? Off by default, as servers
+ * not knowing CMD_PACKED_MODE may treat it as an error and end the
+ * simulation. */
+static bool packed_mode_enabled;
+/* The server accepted packed mode */
+static bool packed_mode;
+
 static int sockfd;
 static struct sockaddr_in serv_addr;
 
@@ -77,6 +105,32 @@ struct vpi_cmd {
 	};
 };
 
+/* The batch of packed records waiting to be sent */
+static uint8_t *packed_batch;
+static size_t packed_batch_used;
+static size_t packed_batch_size;
+
+/* Where the TDO bytes of the batch go */
+struct packed_reply {
+	uint8_t *tdo;
+	unsigned int nb_bytes;
+};
+
+static struct packed_reply *packed_replies;
+static unsigned int packed_replies_count;
+static unsigned int packed_replies_size;
+static unsigned int packed_pending_bytes;
+
+/* Scans whose data can only be checked once the queue is flushed */
+struct packed_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
+static struct packed_scan *packed_scans;
+static unsigned int packed_scans_count;
+static unsigned int packed_scans_size;
+
 static char *jtag_vpi_cmd_to_str(int cmd_num)
 {
 	switch (cmd_num) {
@@ -90,6 +144,10 @@ static char *jtag_vpi_cmd_to_str(int cmd_num)
 		return "CMD_SCAN_CHAIN_FLIP_TMS";
 	case CMD_STOP_SIMU:
 		return "CMD_STOP_SIMU";
+	case CMD_PACKED_MODE:
+		return "CMD_PACKED_MODE";
+	case CMD_PACKED_FLUSH:
+		return "CMD_PACKED_FLUSH";
 	default:
 		return "<unknown>";
 	}
@@ -206,6 +264,204 @@ static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
 	return ERROR_OK;
 }
 
+static int jtag_vpi_write_all(const uint8_t *buf, size_t len)
+{
+	while (len) {
+		int retval = write_socket(sockfd, buf, len);
+		if (retval < 0) {
+#ifdef _WIN32
+			if (WSAGetLastError() == WSAEINTR)
+				continue;
+#else
+			if (errno == EINTR)
+				continue;
+#endif
+			log_socket_error("jtag_vpi xmit");
+			exit(-1);
+		}
+		buf += retval;
+		len -= retval;
+	}
+	return ERROR_OK;
+}
+
+static int jtag_vpi_read_all(uint8_t *buf, size_t len)
+{
+	while (len) {
+		int retval = read_socket(sockfd, buf, len);
+		if (retval < 0) {
+#ifdef _WIN32
+			if (WSAGetLastError() == WSAEINTR)
+				continue;
+#else
+			if (errno == EINTR)
+				continue;
+#endif
+			log_socket_error("jtag_vpi recv");
+			exit(-1);
+		} else if (retval == 0) {
+			LOG_ERROR("Connection prematurely closed by jtag_vpi server.");
+			exit(-1);
+		}
+		buf += retval;
+		len -= retval;
+	}
+	return ERROR_OK;
+}
+
+static int jtag_vpi_packed_reserve(size_t len)
+{
+	if (packed_batch_used + len <= packed_batch_size)
+		return ERROR_OK;
+
+	size_t size = MAX(2 * packed_batch_size, packed_batch_used + len);
+	uint8_t *batch = realloc(packed_batch, size);
+	if (!batch) {
+		LOG_ERROR("jtag_vpi: out of memory");
+		return ERROR_FAIL;
+	}
+	packed_batch = batch;
+	packed_batch_size = size;
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_packed_exchange - send the batch and collect its replies
+ *
+ * Ends the current batch with CMD_PACKED_FLUSH. The TDO bytes are only
+ * waited for if some record of the batch asked for them.
+ */
+static int jtag_vpi_packed_exchange(void)
+{
+	if (packed_batch_used == 0)
+		return ERROR_OK;
+
+	if (jtag_vpi_packed_reserve(6) != ERROR_OK)
+		return ERROR_FAIL;
+	packed_batch[packed_batch_used++] = CMD_PACKED_FLUSH;
+	packed_batch[packed_batch_used++] = 0;
+	h_u32_to_le(packed_batch + packed_batch_used, 0);
+	packed_batch_used += 4;
+
+	int retval = jtag_vpi_write_all(packed_batch, packed_batch_used);
+	packed_batch_used = 0;
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (packed_pending_bytes == 0)
+		return ERROR_OK;
+
+	uint8_t *tdo = malloc(packed_pending_bytes);
+	if (!tdo) {
+		LOG_ERROR("jtag_vpi: out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = jtag_vpi_read_all(tdo, packed_pending_bytes);
+	if (retval == ERROR_OK) {
+		uint8_t *p = tdo;
+		for (unsigned int i = 0; i < packed_replies_count; i++) {
+			memcpy(packed_replies[i].tdo, p, packed_replies[i].nb_bytes);
+			p += packed_replies[i].nb_bytes;
+		}
+	}
+	free(tdo);
+
+	packed_replies_count = 0;
+	packed_pending_bytes = 0;
+	return retval;
+}
+
+/**
+ * jtag_vpi_packed_add - append one record to the batch
+ * @param cmd jtag_vpi command
+ * @param bits TMS or TDI bits, or NULL to shift ones
+ * @param nb_bits number of bits
+ * @param tdo where the captured TDO bits go once the batch is exchanged,
+ *	or NULL if the server need not send them
+ */
+static int jtag_vpi_packed_add(int cmd, const uint8_t *bits, int nb_bits, uint8_t *tdo)
+{
+	int nb_bytes = DIV_ROUND_UP(nb_bits, 8);
+	uint8_t flags = 0;
+
+	LOG_DEBUG_IO("queueing JTAG VPI cmd: cmd=%s, nb_bits=%d%s",
+			jtag_vpi_cmd_to_str(cmd), nb_bits, tdo ? ", capture" : "");
+
+	if (!bits)
+		flags |= PACKED_TDI_ONES;
+	if (tdo)
+		flags |= PACKED_CAPTURE;
+
+	if (jtag_vpi_packed_reserve(6 + (bits ? nb_bytes : 0)) != ERROR_OK)
+		return ERROR_FAIL;
+	packed_batch[packed_batch_used++] = cmd;
+	packed_batch[packed_batch_used++] = flags;
+	h_u32_to_le(packed_batch + packed_batch_used, nb_bits);
+	packed_batch_used += 4;
+	if (bits) {
+		memcpy(packed_batch + packed_batch_used, bits, nb_bytes);
+		packed_batch_used += nb_bytes;
+	}
+
+	if (!tdo)
+		return ERROR_OK;
+
+	if (packed_replies_count == packed_replies_size) {
+		unsigned int size = packed_replies_size ? 2 * packed_replies_size : 16;
+		struct packed_reply *replies = realloc(packed_replies, size * sizeof(*replies));
+		if (!replies) {
+			LOG_ERROR("jtag_vpi: out of memory");
+			return ERROR_FAIL;
+		}
+		packed_replies = replies;
+		packed_replies_size = size;
+	}
+	packed_replies[packed_replies_count].tdo = tdo;
+	packed_replies[packed_replies_count].nb_bytes = nb_bytes;
+	packed_replies_count++;
+	packed_pending_bytes += nb_bytes;
+
+	if (packed_pending_bytes >= PACKED_MAX_PENDING)
+		return jtag_vpi_packed_exchange();
+	return ERROR_OK;
+}
+
+static int jtag_vpi_packed_defer_scan(struct scan_command *cmd, uint8_t *buf)
+{
+	if (packed_scans_count == packed_scans_size) {
+		unsigned int size = packed_scans_size ? 2 * packed_scans_size : 16;
+		struct packed_scan *scans = realloc(packed_scans, size * sizeof(*scans));
+		if (!scans) {
+			LOG_ERROR("jtag_vpi: out of memory");
+			return ERROR_FAIL;
+		}
+		packed_scans = scans;
+		packed_scans_size = size;
+	}
+	packed_scans[packed_scans_count].cmd = cmd;
+	packed_scans[packed_scans_count].buf = buf;
+	packed_scans_count++;
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_packed_flush - run the batch and check the deferred scans
+ */
+static int jtag_vpi_packed_flush(void)
+{
+	int retval = jtag_vpi_packed_exchange();
+
+	for (unsigned int i = 0; i < packed_scans_count; i++) {
+		if (retval == ERROR_OK)
+			retval = jtag_read_buffer(packed_scans[i].buf, packed_scans[i].cmd);
+		free(packed_scans[i].buf);
+	}
+	packed_scans_count = 0;
+
+	return retval;
+}
+
 /**
  * jtag_vpi_reset - ask to reset the JTAG device
  * @param trst 1 if TRST is to be asserted
@@ -216,6 +472,9 @@ static int jtag_vpi_reset(int trst, int srst)
 	struct vpi_cmd vpi;
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 
+	if (packed_mode)
+		return jtag_vpi_packed_add(CMD_RESET, NULL, 0, NULL);
+
 	vpi.cmd = CMD_RESET;
 	vpi.length = 0;
 	return jtag_vpi_send_cmd(&vpi);
@@ -237,6 +496,9 @@ static int jtag_vpi_tms_seq(const uint8_t *bits, int nb_bits)
 	struct vpi_cmd vpi;
 	int nb_bytes;
 
+	if (packed_mode)
+		return jtag_vpi_packed_add(CMD_TMS_SEQ, bits, nb_bits, NULL);
+
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 	nb_bytes = DIV_ROUND_UP(nb_bits, 8);
 
@@ -351,6 +613,11 @@ static int jtag_vpi_queue_tdi(uint8_t *bits, int nb_bits, int tap_shift)
 	int nb_xfer = DIV_ROUND_UP(nb_bits, XFERT_MAX_SIZE * 8);
 	int retval;
 
+	/* no size limit and no waiting for the TDO data in packed mode */
+	if (packed_mode)
+		return jtag_vpi_packed_add(tap_shift ? CMD_SCAN_CHAIN_FLIP_TMS : CMD_SCAN_CHAIN,
+				bits, nb_bits, bits);
+
 	while (nb_xfer) {
 		if (nb_xfer ==  1) {
 			retval = jtag_vpi_queue_tdi_xfer(bits, nb_bits, tap_shift);
@@ -411,7 +678,20 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			return retval;
 	}
 
-	if (cmd->end_state == TAP_DRSHIFT) {
+	if (packed_mode) {
+		/* only wait for the simulator if the scan captures anything */
+		bool capture = jtag_scan_type(cmd) != SCAN_OUT;
+		retval = jtag_vpi_packed_add(cmd->end_state == TAP_DRSHIFT ?
+				CMD_SCAN_CHAIN : CMD_SCAN_CHAIN_FLIP_TMS,
+				buf, scan_bits, capture ? buf : NULL);
+		if (retval == ERROR_OK && capture)
+			retval = jtag_vpi_packed_defer_scan(cmd, buf);
+		else
+			free(buf);
+		buf = NULL;
+		if (retval != ERROR_OK)
+			return retval;
+	} else if (cmd->end_state == TAP_DRSHIFT) {
 		retval = jtag_vpi_queue_tdi(buf, scan_bits, NO_TAP_SHIFT);
 		if (retval != ERROR_OK)
 			return retval;
@@ -436,11 +716,13 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			tap_set_state(TAP_DRPAUSE);
 	}
 
-	retval = jtag_read_buffer(buf, cmd);
-	if (retval != ERROR_OK)
-		return retval;
+	if (buf) {
+		retval = jtag_read_buffer(buf, cmd);
+		if (retval != ERROR_OK)
+			return retval;
 
-	free(buf);
+		free(buf);
+	}
 
 	if (cmd->end_state != TAP_DRSHIFT) {
 		retval = jtag_vpi_state_move(cmd->end_state);
@@ -519,6 +801,8 @@ static int jtag_vpi_execute_queue(void)
 			retval = jtag_vpi_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
+			if (packed_mode)
+				retval = jtag_vpi_packed_exchange();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -532,9 +816,57 @@ static int jtag_vpi_execute_queue(void)
 		}
 	}
 
+	if (packed_mode) {
+		int flush_retval = jtag_vpi_packed_flush();
+		if (retval == ERROR_OK)
+			retval = flush_retval;
+	}
+
 	return retval;
 }
 
+/**
+ * jtag_vpi_negotiate_packed - try to switch the server to packed mode
+ *
+ * CMD_PACKED_MODE is followed by an empty scan, which every server answers.
+ * A server that knows packed mode replies to CMD_PACKED_MODE first, so no
+ * timeout is needed to detect servers that ignore the command. Servers that
+ * abort on unknown commands must not be used with packed mode enabled.
+ */
+static int jtag_vpi_negotiate_packed(void)
+{
+	struct vpi_cmd vpi;
+
+	packed_mode = false;
+	if (!packed_mode_enabled)
+		return ERROR_OK;
+
+	memset(&vpi, 0, sizeof(struct vpi_cmd));
+	vpi.cmd = CMD_PACKED_MODE;
+	if (jtag_vpi_send_cmd(&vpi) != ERROR_OK)
+		return ERROR_FAIL;
+
+	memset(&vpi, 0, sizeof(struct vpi_cmd));
+	vpi.cmd = CMD_SCAN_CHAIN;
+	if (jtag_vpi_send_cmd(&vpi) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (jtag_vpi_receive_cmd(&vpi) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (vpi.cmd == CMD_PACKED_MODE) {
+		LOG_INFO("jtag_vpi: using packed mode, version %" PRIu32, vpi.length);
+		/* then comes the reply to the empty scan */
+		if (jtag_vpi_receive_cmd(&vpi) != ERROR_OK)
+			return ERROR_FAIL;
+		packed_mode = true;
+	} else {
+		LOG_INFO("jtag_vpi: server does not support packed mode");
+	}
+
+	return ERROR_OK;
+}
+
 static int jtag_vpi_init(void)
 {
 	int flag = 1;
@@ -575,7 +907,7 @@ static int jtag_vpi_init(void)
 
 	LOG_INFO("jtag_vpi: Connection to %s : %u successful", server_address, server_port);
 
-	return ERROR_OK;
+	return jtag_vpi_negotiate_packed();
 }
 
 static int jtag_vpi_stop_simulation(void)
@@ -585,6 +917,12 @@ static int jtag_vpi_stop_simulation(void)
 	cmd.length = 0;
 	cmd.nb_bits = 0;
 	cmd.cmd = CMD_STOP_SIMU;
+
+	if (packed_mode) {
+		if (jtag_vpi_packed_add(CMD_STOP_SIMU, NULL, 0, NULL) != ERROR_OK)
+			return ERROR_FAIL;
+		return jtag_vpi_packed_exchange();
+	}
 	return jtag_vpi_send_cmd(&cmd);
 }
 
@@ -599,6 +937,9 @@ static int jtag_vpi_quit(void)
 		log_socket_error("jtag_vpi");
 	}
 	free(server_address);
+	free(packed_batch);
+	free(packed_replies);
+	free(packed_scans);
 	return ERROR_OK;
 }
 
@@ -641,6 +982,17 @@ COMMAND_HANDLER(jtag_vpi_stop_sim_on_exit_handler)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_vpi_packed_mode_handler)
+{
+	if (CMD_ARGC != 1) {
+		LOG_ERROR("Command \"jtag_vpi packed_mode\" expects 1 argument (on|off)");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], packed_mode_enabled);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 	{
 		.name = "set_port",
@@ -664,6 +1016,14 @@ static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 			"before OpenOCD exits (default: off)",
 		.usage = "<on|off>",
 	},
+	{
+		.name = "packed_mode",
+		.handler = &jtag_vpi_packed_mode_handler,
+		.mode = COMMAND_CONFIG,
+		.help = "Configure if the packed transport is negotiated with "
+			"the server (default: off)",
+		.usage = "<on|off>",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -679,7 +1039,7 @@ static const struct command_registration jtag_vpi_command_handlers[] = {
 };
 
 static struct jtag_interface jtag_vpi_interface = {
-	.supported = DEBUG_CAP_TMS_SEQ,
+	.supported = DEBUG_CAP_TMS_SEQ | DEBUG_CAP_QUEUE_OPTIMIZE,
 	.execute_queue = jtag_vpi_execute_queue,
 };
 
@@ -63,6 +63,10 @@ static struct gpiod_line *gpiod_swdio_dir;
 static struct gpiod_line *gpiod_srst;
 static struct gpiod_line *gpiod_led;
 
+/* TCK, TMS and TDI requested together when they live on the same chip */
+static struct gpiod_line_bulk gpiod_jtag_bulk;
+static bool gpiod_jtag_bulk_used;
+
 static int last_swclk;
 static int last_swdio;
 static bool last_stored;
@@ -106,23 +110,34 @@ static int linuxgpiod_write(int tck, int tms, int tdi)
 		first_time = 1;
 	}
 
-	if (tdi != last_tdi) {
-		retval = gpiod_line_set_value(gpiod_tdi, tdi);
-		if (retval < 0)
-			LOG_WARNING("writing tdi failed");
-	}
+	if (gpiod_jtag_bulk_used) {
+		/* one request updates all three lines; the whole bulk is always
+		 * written, so no line is ever set from a stale value */
+		if (tck != last_tck || tms != last_tms || tdi != last_tdi) {
+			const int values[] = { tck, tms, tdi };
+			retval = gpiod_line_set_value_bulk(&gpiod_jtag_bulk, values);
+			if (retval < 0)
+				LOG_WARNING("writing tck, tms and tdi failed");
+		}
+	} else {
+		if (tdi != last_tdi) {
+			retval = gpiod_line_set_value(gpiod_tdi, tdi);
+			if (retval < 0)
+				LOG_WARNING("writing tdi failed");
+		}
 
-	if (tms != last_tms) {
-		retval = gpiod_line_set_value(gpiod_tms, tms);
-		if (retval < 0)
-			LOG_WARNING("writing tms failed");
-	}
+		if (tms != last_tms) {
+			retval = gpiod_line_set_value(gpiod_tms, tms);
+			if (retval < 0)
+				LOG_WARNING("writing tms failed");
+		}
 
-	/* write clk last */
-	if (tck != last_tck) {
-		retval = gpiod_line_set_value(gpiod_tck, tck);
-		if (retval < 0)
-			LOG_WARNING("writing tck failed");
+		/* write clk last */
+		if (tck != last_tck) {
+			retval = gpiod_line_set_value(gpiod_tck, tck);
+			if (retval < 0)
+				LOG_WARNING("writing tck failed");
+		}
 	}
 
 	last_tdi = tdi;
@@ -132,6 +147,39 @@ static int linuxgpiod_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+/*
+ * Bitbang interface clocking of a vector of bits
+ *
+ * With TCK, TMS and TDI on one chip every bit costs two line updates plus
+ * the optional TDO read, instead of up to four updates.
+ */
+static int linuxgpiod_write_vector(const uint8_t *tms, const uint8_t *tdi,
+		uint8_t *tdo, unsigned int num_bits)
+{
+	for (unsigned int i = 0; i < num_bits; i++) {
+		int tms_bit = tms ? (tms[i / 8] >> (i % 8)) & 1 : 0;
+		int tdi_bit = tdi ? (tdi[i / 8] >> (i % 8)) & 1 : 0;
+
+		linuxgpiod_write(0, tms_bit, tdi_bit);
+
+		if (tdo) {
+			int retval = gpiod_line_get_value(gpiod_tdo);
+			if (retval < 0) {
+				LOG_ERROR("reading tdo failed");
+				return ERROR_FAIL;
+			}
+			if (retval)
+				tdo[i / 8] |= 1 << (i % 8);
+			else
+				tdo[i / 8] &= ~(1 << (i % 8));
+		}
+
+		linuxgpiod_write(1, tms_bit, tdi_bit);
+	}
+
+	return ERROR_OK;
+}
+
 static int linuxgpiod_swdio_read(void)
 {
 	int retval;
@@ -222,6 +270,7 @@ static int linuxgpiod_blink(int on)
 static struct bitbang_interface linuxgpiod_bitbang = {
 	.read = linuxgpiod_read,
 	.write = linuxgpiod_write,
+	.write_vector = linuxgpiod_write_vector,
 	.swdio_read = linuxgpiod_swdio_read,
 	.swdio_drive = linuxgpiod_swdio_drive,
 	.swd_write = linuxgpiod_swd_write,
@@ -301,9 +350,14 @@ static int linuxgpiod_quit(void)
 	helper_release(gpiod_swdio);
 	helper_release(gpiod_swclk);
 	helper_release(gpiod_trst);
-	helper_release(gpiod_tms);
-	helper_release(gpiod_tck);
-	helper_release(gpiod_tdi);
+	if (gpiod_jtag_bulk_used) {
+		gpiod_line_release_bulk(&gpiod_jtag_bulk);
+		gpiod_jtag_bulk_used = false;
+	} else {
+		helper_release(gpiod_tms);
+		helper_release(gpiod_tck);
+		helper_release(gpiod_tdi);
+	}
 	helper_release(gpiod_tdo);
 
 	if (gpiod_chip_led != NULL)
@@ -379,6 +433,45 @@ static struct gpiod_line *helper_get_open_drain_output_line(const char *label,
 			GPIOD_LINE_REQUEST_DIRECTION_OUTPUT, GPIOD_LINE_REQUEST_FLAG_OPEN_DRAIN);
 }
 
+/*
+ * Request TCK, TMS and TDI as one bulk, so that linuxgpiod_write() can update
+ * them with a single request. All three lines must be on the same chip.
+ */
+static int helper_get_jtag_bulk(void)
+{
+	const unsigned int offsets[] = { tck_gpio, tms_gpio, tdi_gpio };
+	const int values[] = { 0, 1, 0 };
+	struct gpiod_line *lines[3];
+
+	gpiod_line_bulk_init(&gpiod_jtag_bulk);
+	for (unsigned int i = 0; i < ARRAY_SIZE(offsets); i++) {
+		lines[i] = gpiod_chip_get_line(gpiod_chip_tck, offsets[i]);
+		if (!lines[i]) {
+			LOG_ERROR("Error get line %u", offsets[i]);
+			return ERROR_FAIL;
+		}
+		gpiod_line_bulk_add(&gpiod_jtag_bulk, lines[i]);
+	}
+
+	struct gpiod_line_request_config config = {
+		.consumer = "OpenOCD",
+		.request_type = GPIOD_LINE_REQUEST_DIRECTION_OUTPUT,
+		.flags = 0,
+	};
+
+	if (gpiod_line_request_bulk(&gpiod_jtag_bulk, &config, values) < 0) {
+		LOG_ERROR("Error requesting gpio lines tck, tms and tdi");
+		return ERROR_FAIL;
+	}
+
+	gpiod_tck = lines[0];
+	gpiod_tms = lines[1];
+	gpiod_tdi = lines[2];
+	gpiod_jtag_bulk_used = true;
+
+	return ERROR_OK;
+}
+
 static int linuxgpiod_init(void)
 {
 	LOG_INFO("Linux GPIOD JTAG/SWD bitbang driver");
@@ -422,17 +515,22 @@ static int linuxgpiod_init(void)
 		if (!gpiod_tdo)
 			goto out_error;
 
-		gpiod_tdi = helper_get_output_line("tdi", gpiod_chip_tdi, tdi_gpio, 0);
-		if (!gpiod_tdi)
-			goto out_error;
+		if (tck_gpiochip == tms_gpiochip && tck_gpiochip == tdi_gpiochip) {
+			if (helper_get_jtag_bulk() != ERROR_OK)
+				goto out_error;
+		} else {
+			gpiod_tdi = helper_get_output_line("tdi", gpiod_chip_tdi, tdi_gpio, 0);
+			if (!gpiod_tdi)
+				goto out_error;
 
-		gpiod_tck = helper_get_output_line("tck", gpiod_chip_tck, tck_gpio, 0);
-		if (!gpiod_tck)
-			goto out_error;
+			gpiod_tck = helper_get_output_line("tck", gpiod_chip_tck, tck_gpio, 0);
+			if (!gpiod_tck)
+				goto out_error;
 
-		gpiod_tms = helper_get_output_line("tms", gpiod_chip_tms, tms_gpio, 1);
-		if (!gpiod_tms)
-			goto out_error;
+			gpiod_tms = helper_get_output_line("tms", gpiod_chip_tms, tms_gpio, 1);
+			if (!gpiod_tms)
+				goto out_error;
+		}
 
 		if (is_gpio_valid(trst_gpio)) {
 			gpiod_chip_trst = gpiod_chip_open_by_number(trst_gpiochip);
@@ -0,0 +1,766 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Loopback adapter driver
+ *
+ * Emulates a single JTAG TAP holding a RISC-V Debug Transport Module and a
+ * version 0.13 Debug Module, entirely in software. Everything above the
+ * adapter driver (target, RISC-V and JTAG core code) runs unchanged, so the
+ * driver gives repeatable timings of the debugger stack itself and counts of
+ * the work the stack hands to the adapter, without any hardware.
+ *
+ * The hart is an RV32 one that never executes anything. It supports what the
+ * debugger can observe: abstract register access to the GPRs and CSRs,
+ * halt, resume and single step (which advances dpc by 4), and a RAM behind
+ * System Bus Access. There is no program buffer.
+ *
+ * Scans are modelled as a shift register per selected data register, and
+ * every scan is assumed to go through Update-IR/DR.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <jtag/interface.h>
+#include <jtag/commands.h>
+#include <target/riscv/debug_defines.h>
+#include <target/riscv/encoding.h>
+
+#define get_field(reg, mask) (((reg) & (mask)) / ((mask) & ~((mask) << 1)))
+#define set_field(reg, mask, val) (((reg) & ~(mask)) | (((val) * ((mask) & ~((mask) << 1))) & (mask)))
+
+#define LOOPBACK_IR_LEN		5
+#define LOOPBACK_IR_CAPTURE	0x01
+#define LOOPBACK_IR_BYPASS	0x1f
+#define LOOPBACK_IDCODE		0x1d5a0001
+#define LOOPBACK_ABITS		7
+#define LOOPBACK_DMI_LEN	(LOOPBACK_ABITS + DTM_DMI_DATA_LENGTH + DTM_DMI_OP_LENGTH)
+#define LOOPBACK_DATACOUNT	2
+/* RV32IMACU */
+#define LOOPBACK_MISA		0x40101105
+
+#define LOOPBACK_DEFAULT_RAM_BASE	0x80000000
+#define LOOPBACK_DEFAULT_RAM_SIZE	0x100000
+
+struct loopback_stats {
+	uint64_t flushes;
+	uint64_t commands;
+	uint64_t ir_scans;
+	uint64_t dr_scans;
+	uint64_t scan_bits;
+	uint64_t tck;
+	uint64_t dmi_reads;
+	uint64_t dmi_writes;
+	uint64_t dmi_nops;
+	uint64_t abstract_commands;
+	uint64_t sba_reads;
+	uint64_t sba_writes;
+};
+
+struct loopback_hart {
+	bool halted;
+	bool resumeack;
+	bool havereset;
+	uint32_t dpc;
+	uint32_t dcsr;
+	uint32_t gpr[32];
+	uint32_t csr[4096];
+};
+
+static struct loopback_stats loopback_stats;
+static unsigned int loopback_flush_delay;
+
+static uint32_t loopback_ram_base = LOOPBACK_DEFAULT_RAM_BASE;
+static uint32_t loopback_ram_size = LOOPBACK_DEFAULT_RAM_SIZE;
+static uint8_t *loopback_ram;
+
+/* DTM state: the instruction register and the result of the last DMI
+ * operation, which the next DMI scan captures */
+static uint32_t loopback_ir = DTM_IDCODE;
+static uint32_t loopback_dmi_address;
+static uint32_t loopback_dmi_data;
+
+/* DM state */
+static uint32_t dm_dmcontrol;
+static bool dm_resethaltreq;
+static uint32_t dm_data[LOOPBACK_DATACOUNT];
+static uint32_t dm_cmderr;
+static uint32_t dm_sbcs;
+static uint32_t dm_sbaddress;
+static uint32_t dm_sbdata;
+
+static struct loopback_hart loopback_hart;
+
+static void loopback_hart_reset(void)
+{
+	struct loopback_hart *hart = &loopback_hart;
+
+	memset(hart->gpr, 0, sizeof(hart->gpr));
+	memset(hart->csr, 0, sizeof(hart->csr));
+	hart->dpc = loopback_ram_base;
+	hart->dcsr = set_field(0, CSR_DCSR_DEBUGVER, 4);
+	hart->dcsr = set_field(hart->dcsr, CSR_DCSR_PRV, PRV_M);
+	hart->havereset = true;
+	hart->resumeack = false;
+	hart->halted = dm_resethaltreq;
+	if (hart->halted)
+		hart->dcsr = set_field(hart->dcsr, CSR_DCSR_CAUSE, CSR_DCSR_CAUSE_RESETHALTREQ);
+}
+
+static void loopback_hart_halt(uint32_t cause)
+{
+	struct loopback_hart *hart = &loopback_hart;
+
+	if (hart->halted)
+		return;
+	hart->halted = true;
+	hart->dcsr = set_field(hart->dcsr, CSR_DCSR_CAUSE, cause);
+}
+
+static void loopback_hart_resume(void)
+{
+	struct loopback_hart *hart = &loopback_hart;
+
+	hart->resumeack = true;
+	if (get_field(hart->dcsr, CSR_DCSR_STEP)) {
+		/* "execute" one instruction */
+		hart->dpc += 4;
+		hart->dcsr = set_field(hart->dcsr, CSR_DCSR_CAUSE, CSR_DCSR_CAUSE_STEP);
+	} else {
+		hart->halted = false;
+	}
+}
+
+static void loopback_dm_reset(void)
+{
+	dm_dmcontrol = 0;
+	dm_resethaltreq = false;
+	memset(dm_data, 0, sizeof(dm_data));
+	dm_cmderr = 0;
+	dm_sbcs = 0;
+	dm_sbaddress = 0;
+	dm_sbdata = 0;
+}
+
+static bool loopback_hart_selected(void)
+{
+	return get_field(dm_dmcontrol, DM_DMCONTROL_HARTSELLO) == 0;
+}
+
+static uint32_t loopback_dmstatus(void)
+{
+	struct loopback_hart *hart = &loopback_hart;
+	uint32_t dmstatus = set_field(0, DM_DMSTATUS_VERSION, DM_DMSTATUS_VERSION_0_13);
+
+	dmstatus |= DM_DMSTATUS_AUTHENTICATED | DM_DMSTATUS_HASRESETHALTREQ;
+
+	if (!loopback_hart_selected())
+		return dmstatus | DM_DMSTATUS_ALLNONEXISTENT | DM_DMSTATUS_ANYNONEXISTENT;
+
+	if (hart->halted)
+		dmstatus |= DM_DMSTATUS_ALLHALTED | DM_DMSTATUS_ANYHALTED;
+	else
+		dmstatus |= DM_DMSTATUS_ALLRUNNING | DM_DMSTATUS_ANYRUNNING;
+	if (hart->resumeack)
+		dmstatus |= DM_DMSTATUS_ALLRESUMEACK | DM_DMSTATUS_ANYRESUMEACK;
+	if (hart->havereset)
+		dmstatus |= DM_DMSTATUS_ALLHAVERESET | DM_DMSTATUS_ANYHAVERESET;
+
+	return dmstatus;
+}
+
+static void loopback_write_dmcontrol(uint32_t value)
+{
+	struct loopback_hart *hart = &loopback_hart;
+
+	if (!(value & DM_DMCONTROL_DMACTIVE)) {
+		loopback_dm_reset();
+		return;
+	}
+
+	/* ten hartsel bits are implemented, no hart array mask */
+	dm_dmcontrol = value & (DM_DMCONTROL_DMACTIVE | DM_DMCONTROL_NDMRESET |
+			DM_DMCONTROL_HARTSELLO);
+
+	if (value & DM_DMCONTROL_SETRESETHALTREQ)
+		dm_resethaltreq = true;
+	if (value & DM_DMCONTROL_CLRRESETHALTREQ)
+		dm_resethaltreq = false;
+
+	if (value & DM_DMCONTROL_NDMRESET)
+		loopback_hart_reset();
+
+	if (!loopback_hart_selected())
+		return;
+
+	if (value & DM_DMCONTROL_ACKHAVERESET)
+		hart->havereset = false;
+
+	if (value & DM_DMCONTROL_HALTREQ) {
+		loopback_hart_halt(CSR_DCSR_CAUSE_HALTREQ);
+	} else if (value & DM_DMCONTROL_RESUMEREQ) {
+		hart->resumeack = false;
+		if (hart->halted)
+			loopback_hart_resume();
+		else
+			hart->resumeack = true;
+	}
+}
+
+static uint32_t loopback_read_csr(unsigned int number)
+{
+	struct loopback_hart *hart = &loopback_hart;
+
+	switch (number) {
+	case CSR_MISA:
+		return LOOPBACK_MISA;
+	case CSR_MHARTID:
+		return 0;
+	case CSR_DCSR:
+		return hart->dcsr;
+	case CSR_DPC:
+		return hart->dpc;
+	default:
+		return hart->csr[number];
+	}
+}
+
+static void loopback_write_csr(unsigned int number, uint32_t value)
+{
+	struct loopback_hart *hart = &loopback_hart;
+	const uint32_t dcsr_ro = CSR_DCSR_DEBUGVER | CSR_DCSR_CAUSE | CSR_DCSR_NMIP;
+
+	switch (number) {
+	case CSR_MISA:
+	case CSR_MHARTID:
+		break;
+	case CSR_DCSR:
+		hart->dcsr = (hart->dcsr & dcsr_ro) | (value & ~dcsr_ro);
+		break;
+	case CSR_DPC:
+		hart->dpc = value & ~1;
+		break;
+	default:
+		hart->csr[number] = value;
+		break;
+	}
+}
+
+static void loopback_execute_command(uint32_t command)
+{
+	struct loopback_hart *hart = &loopback_hart;
+
+	loopback_stats.abstract_commands++;
+
+	if (dm_cmderr != DM_ABSTRACTCS_CMDERR_NONE)
+		return;
+
+	if (get_field(command, AC_ACCESS_REGISTER_CMDTYPE) != 0) {
+		dm_cmderr = DM_ABSTRACTCS_CMDERR_NOT_SUPPORTED;
+		return;
+	}
+	if (!loopback_hart_selected() || !hart->halted) {
+		dm_cmderr = DM_ABSTRACTCS_CMDERR_HALT_RESUME;
+		return;
+	}
+	/* no program buffer, and only 32 bit registers */
+	if ((command & AC_ACCESS_REGISTER_POSTEXEC) ||
+			get_field(command, AC_ACCESS_REGISTER_AARSIZE) != 2) {
+		dm_cmderr = DM_ABSTRACTCS_CMDERR_NOT_SUPPORTED;
+		return;
+	}
+	if (!(command & AC_ACCESS_REGISTER_TRANSFER))
+		return;
+
+	unsigned int regno = get_field(command, AC_ACCESS_REGISTER_REGNO);
+	bool write = command & AC_ACCESS_REGISTER_WRITE;
+
+	if (regno < 0x1000) {
+		if (write)
+			loopback_write_csr(regno, dm_data[0]);
+		else
+			dm_data[0] = loopback_read_csr(regno);
+	} else if (regno < 0x1020) {
+		if (!write)
+			dm_data[0] = hart->gpr[regno - 0x1000];
+		else if (regno != 0x1000)
+			hart->gpr[regno - 0x1000] = dm_data[0];
+	} else {
+		/* no FPRs and no custom registers */
+		dm_cmderr = DM_ABSTRACTCS_CMDERR_EXCEPTION;
+	}
+}
+
+static void loopback_sba_access(bool write)
+{
+	unsigned int sbaccess = get_field(dm_sbcs, DM_SBCS_SBACCESS);
+	unsigned int size = 1 << sbaccess;
+
+	if (sbaccess > 2) {
+		dm_sbcs = set_field(dm_sbcs, DM_SBCS_SBERROR, 4);
+		return;
+	}
+	if (dm_sbaddress % size) {
+		dm_sbcs = set_field(dm_sbcs, DM_SBCS_SBERROR, 3);
+		return;
+	}
+	if (dm_sbaddress < loopback_ram_base ||
+			dm_sbaddress - loopback_ram_base > loopback_ram_size - size) {
+		dm_sbcs = set_field(dm_sbcs, DM_SBCS_SBERROR, 2);
+		return;
+	}
+
+	uint8_t *p = loopback_ram + (dm_sbaddress - loopback_ram_base);
+	if (write) {
+		loopback_stats.sba_writes++;
+		for (unsigned int i = 0; i < size; i++)
+			p[i] = dm_sbdata >> (8 * i);
+	} else {
+		loopback_stats.sba_reads++;
+		dm_sbdata = 0;
+		for (unsigned int i = 0; i < size; i++)
+			dm_sbdata |= (uint32_t)p[i] << (8 * i);
+	}
+
+	if (dm_sbcs & DM_SBCS_SBAUTOINCREMENT)
+		dm_sbaddress += size;
+}
+
+static uint32_t loopback_dmi_read(uint32_t address)
+{
+	uint32_t value;
+
+	switch (address) {
+	case DM_DATA0:
+	case DM_DATA1:
+		return dm_data[address - DM_DATA0];
+	case DM_DMCONTROL:
+		return dm_dmcontrol;
+	case DM_DMSTATUS:
+		return loopback_dmstatus();
+	case DM_HALTSUM0:
+		return loopback_hart.halted ? 1 : 0;
+	case DM_ABSTRACTCS:
+		value = set_field(0, DM_ABSTRACTCS_DATACOUNT, LOOPBACK_DATACOUNT);
+		return set_field(value, DM_ABSTRACTCS_CMDERR, dm_cmderr);
+	case DM_SBCS:
+		value = set_field(dm_sbcs, DM_SBCS_SBVERSION, 1);
+		value = set_field(value, DM_SBCS_SBASIZE, 32);
+		return value | DM_SBCS_SBACCESS32 | DM_SBCS_SBACCESS16 | DM_SBCS_SBACCESS8;
+	case DM_SBADDRESS0:
+		return dm_sbaddress;
+	case DM_SBDATA0:
+		value = dm_sbdata;
+		if ((dm_sbcs & DM_SBCS_SBREADONDATA) && !get_field(dm_sbcs, DM_SBCS_SBERROR))
+			loopback_sba_access(false);
+		return value;
+	default:
+		/* DM_HARTINFO and everything else that is not implemented */
+		return 0;
+	}
+}
+
+static void loopback_dmi_write(uint32_t address, uint32_t value)
+{
+	const uint32_t sbcs_rw = DM_SBCS_SBREADONADDR | DM_SBCS_SBACCESS |
+		DM_SBCS_SBAUTOINCREMENT | DM_SBCS_SBREADONDATA;
+
+	switch (address) {
+	case DM_DATA0:
+	case DM_DATA1:
+		dm_data[address - DM_DATA0] = value;
+		break;
+	case DM_DMCONTROL:
+		loopback_write_dmcontrol(value);
+		break;
+	case DM_ABSTRACTCS:
+		dm_cmderr &= ~get_field(value, DM_ABSTRACTCS_CMDERR);
+		break;
+	case DM_COMMAND:
+		loopback_execute_command(value);
+		break;
+	case DM_SBCS:
+		/* sberror and sbbusyerror are write 1 to clear */
+		dm_sbcs &= ~(value & (DM_SBCS_SBERROR | DM_SBCS_SBBUSYERROR));
+		dm_sbcs = (dm_sbcs & ~sbcs_rw) | (value & sbcs_rw);
+		break;
+	case DM_SBADDRESS0:
+		dm_sbaddress = value;
+		if ((dm_sbcs & DM_SBCS_SBREADONADDR) && !get_field(dm_sbcs, DM_SBCS_SBERROR))
+			loopback_sba_access(false);
+		break;
+	case DM_SBDATA0:
+		dm_sbdata = value;
+		if (!get_field(dm_sbcs, DM_SBCS_SBERROR))
+			loopback_sba_access(true);
+		break;
+	default:
+		break;
+	}
+}
+
+static void loopback_tap_reset(void)
+{
+	loopback_ir = DTM_IDCODE;
+}
+
+/* Return the width and the captured value of the selected data register. */
+static unsigned int loopback_dr_capture(uint64_t *value)
+{
+	switch (loopback_ir) {
+	case DTM_IDCODE:
+		*value = LOOPBACK_IDCODE;
+		return 32;
+	case DTM_DTMCS:
+		*value = set_field(0, DTM_DTMCS_VERSION, 1);
+		*value = set_field(*value, DTM_DTMCS_ABITS, LOOPBACK_ABITS);
+		return 32;
+	case DTM_DMI:
+		/* the op field reads back as 0, success */
+		*value = ((uint64_t)loopback_dmi_address << DTM_DMI_ADDRESS_OFFSET) |
+			((uint64_t)loopback_dmi_data << DTM_DMI_DATA_OFFSET);
+		return LOOPBACK_DMI_LEN;
+	default:
+		*value = 0;
+		return 1;
+	}
+}
+
+static void loopback_dr_update(uint64_t value)
+{
+	switch (loopback_ir) {
+	case DTM_DTMCS:
+		if (value & DTM_DTMCS_DMIHARDRESET) {
+			loopback_dmi_address = 0;
+			loopback_dmi_data = 0;
+		}
+		break;
+	case DTM_DMI: {
+		uint32_t op = get_field(value, DTM_DMI_OP);
+		uint32_t data = (value >> DTM_DMI_DATA_OFFSET) & 0xffffffff;
+		uint32_t address = (value >> DTM_DMI_ADDRESS_OFFSET) &
+			((1 << LOOPBACK_ABITS) - 1);
+
+		switch (op) {
+		case DTM_DMI_OP_READ:
+			loopback_stats.dmi_reads++;
+			loopback_dmi_address = address;
+			loopback_dmi_data = loopback_dmi_read(address);
+			break;
+		case DTM_DMI_OP_WRITE:
+			loopback_stats.dmi_writes++;
+			loopback_dmi_write(address, data);
+			loopback_dmi_address = address;
+			loopback_dmi_data = data;
+			break;
+		default:
+			loopback_stats.dmi_nops++;
+			break;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/* Go to a stable state, counting the TCK cycles an adapter would need. */
+static void loopback_state_move(tap_state_t state)
+{
+	tap_state_t cur_state = tap_get_state();
+
+	if (state == TAP_RESET) {
+		loopback_stats.tck += 5;
+		loopback_tap_reset();
+	} else if (cur_state != state && tap_is_state_stable(cur_state)) {
+		loopback_stats.tck += tap_get_tms_path_len(cur_state, state);
+	}
+	tap_set_state(state);
+}
+
+static void loopback_scan(struct scan_command *cmd)
+{
+	tap_state_t shift_state = cmd->ir_scan ? TAP_IRSHIFT : TAP_DRSHIFT;
+	unsigned int width;
+	uint64_t sr;
+
+	if (cmd->ir_scan) {
+		loopback_stats.ir_scans++;
+		width = LOOPBACK_IR_LEN;
+		sr = LOOPBACK_IR_CAPTURE;
+	} else {
+		loopback_stats.dr_scans++;
+		width = loopback_dr_capture(&sr);
+	}
+
+	loopback_state_move(shift_state);
+
+	for (int i = 0; i < cmd->num_fields; i++) {
+		const struct scan_field *field = &cmd->fields[i];
+
+		for (int bit = 0; bit < field->num_bits; bit++) {
+			uint64_t tdi = 0;
+			if (field->out_value)
+				tdi = (field->out_value[bit / 8] >> (bit % 8)) & 1;
+			if (field->in_value) {
+				if (sr & 1)
+					field->in_value[bit / 8] |= 1 << (bit % 8);
+				else
+					field->in_value[bit / 8] &= ~(1 << (bit % 8));
+			}
+			sr = (sr >> 1) | (tdi << (width - 1));
+		}
+		loopback_stats.scan_bits += field->num_bits;
+		loopback_stats.tck += field->num_bits;
+	}
+
+	if (cmd->ir_scan)
+		loopback_ir = sr;
+	else
+		loopback_dr_update(sr);
+
+	/* the last bit already left the shift state */
+	if (cmd->end_state != shift_state)
+		loopback_stats.tck += tap_get_tms_path_len(shift_state, cmd->end_state) - 1;
+	tap_set_state(cmd->end_state);
+}
+
+static void loopback_tms(struct tms_command *cmd)
+{
+	tap_state_t state = tap_get_state();
+
+	for (unsigned int i = 0; i < cmd->num_bits; i++) {
+		state = tap_state_transition(state, (cmd->bits[i / 8] >> (i % 8)) & 1);
+		if (state == TAP_RESET)
+			loopback_tap_reset();
+	}
+	loopback_stats.tck += cmd->num_bits;
+	tap_set_state(state);
+}
+
+static void loopback_path_move(struct pathmove_command *cmd)
+{
+	for (int i = 0; i < cmd->num_states; i++) {
+		if (cmd->path[i] == TAP_RESET)
+			loopback_tap_reset();
+	}
+	loopback_stats.tck += cmd->num_states;
+	tap_set_state(cmd->path[cmd->num_states - 1]);
+}
+
+static int loopback_reset(int trst, int srst)
+{
+	if (trst)
+		loopback_tap_reset();
+	if (srst)
+		loopback_hart_reset();
+	return ERROR_OK;
+}
+
+static int loopback_execute_queue(void)
+{
+	loopback_stats.flushes++;
+
+	for (struct jtag_command *cmd = jtag_command_queue; cmd; cmd = cmd->next) {
+		loopback_stats.commands++;
+
+		switch (cmd->type) {
+		case JTAG_RESET:
+			loopback_reset(cmd->cmd.reset->trst, cmd->cmd.reset->srst);
+			break;
+		case JTAG_RUNTEST:
+			loopback_state_move(TAP_IDLE);
+			loopback_stats.tck += cmd->cmd.runtest->num_cycles;
+			loopback_state_move(cmd->cmd.runtest->end_state);
+			break;
+		case JTAG_STABLECLOCKS:
+			loopback_stats.tck += cmd->cmd.stableclocks->num_cycles;
+			break;
+		case JTAG_TLR_RESET:
+			loopback_state_move(cmd->cmd.statemove->end_state);
+			break;
+		case JTAG_PATHMOVE:
+			loopback_path_move(cmd->cmd.pathmove);
+			break;
+		case JTAG_TMS:
+			loopback_tms(cmd->cmd.tms);
+			break;
+		case JTAG_SLEEP:
+			jtag_sleep(cmd->cmd.sleep->us);
+			break;
+		case JTAG_SCAN:
+			loopback_scan(cmd->cmd.scan);
+			break;
+		default:
+			LOG_ERROR("BUG: unknown JTAG command type 0x%X", cmd->type);
+			return ERROR_FAIL;
+		}
+	}
+
+	/* stand-in for the round trip of a real adapter */
+	if (loopback_flush_delay)
+		jtag_sleep(loopback_flush_delay);
+
+	return ERROR_OK;
+}
+
+static int loopback_speed(int speed)
+{
+	return ERROR_OK;
+}
+
+static int loopback_khz(int khz, int *jtag_speed)
+{
+	*jtag_speed = khz;
+	return ERROR_OK;
+}
+
+static int loopback_speed_div(int speed, int *khz)
+{
+	*khz = speed;
+	return ERROR_OK;
+}
+
+static int loopback_init(void)
+{
+	if (!loopback_ram_size) {
+		LOG_ERROR("loopback: the RAM size must not be zero");
+		return ERROR_FAIL;
+	}
+
+	loopback_ram = calloc(1, loopback_ram_size);
+	if (!loopback_ram) {
+		LOG_ERROR("loopback: out of memory");
+		return ERROR_FAIL;
+	}
+
+	loopback_tap_reset();
+	loopback_dm_reset();
+	loopback_hart_reset();
+	tap_set_state(TAP_RESET);
+
+	LOG_INFO("loopback: RISC-V DTM/DM model with %" PRIu32 " KiB of RAM at 0x%08" PRIx32,
+			loopback_ram_size / 1024, loopback_ram_base);
+	return ERROR_OK;
+}
+
+static int loopback_quit(void)
+{
+	free(loopback_ram);
+	loopback_ram = NULL;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(loopback_handle_memory_command)
+{
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint32_t base, size;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], base);
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size);
+	if (size == 0 || size % 4 || base % 4 || base + (uint64_t)size > 0x100000000ULL) {
+		command_print(CMD, "the RAM must be word aligned and fit in 32 bits of address");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	loopback_ram_base = base;
+	loopback_ram_size = size;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(loopback_handle_flush_delay_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], loopback_flush_delay);
+
+	command_print(CMD, "%u", loopback_flush_delay);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(loopback_handle_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(&loopback_stats, 0, sizeof(loopback_stats));
+		return ERROR_OK;
+	}
+
+	/* a Tcl dictionary, so scripts can pick out single counters */
+	command_print(CMD, "flushes %" PRIu64 " commands %" PRIu64
+			" ir_scans %" PRIu64 " dr_scans %" PRIu64 " scan_bits %" PRIu64
+			" tck %" PRIu64 " dmi_reads %" PRIu64 " dmi_writes %" PRIu64
+			" dmi_nops %" PRIu64 " abstract_commands %" PRIu64
+			" sba_reads %" PRIu64 " sba_writes %" PRIu64,
+			loopback_stats.flushes, loopback_stats.commands,
+			loopback_stats.ir_scans, loopback_stats.dr_scans,
+			loopback_stats.scan_bits, loopback_stats.tck,
+			loopback_stats.dmi_reads, loopback_stats.dmi_writes,
+			loopback_stats.dmi_nops, loopback_stats.abstract_commands,
+			loopback_stats.sba_reads, loopback_stats.sba_writes);
+	return ERROR_OK;
+}
+
+static const struct command_registration loopback_subcommand_handlers[] = {
+	{
+		.name = "memory",
+		.handler = loopback_handle_memory_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the base address and size of the emulated RAM",
+		.usage = "base size",
+	},
+	{
+		.name = "flush_delay",
+		.handler = loopback_handle_flush_delay_command,
+		.mode = COMMAND_ANY,
+		.help = "set or show the delay in microseconds added to every queue flush",
+		.usage = "[us]",
+	},
+	{
+		.name = "stats",
+		.handler = loopback_handle_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "show or reset the counters of the work done by the adapter",
+		.usage = "['reset']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration loopback_command_handlers[] = {
+	{
+		.name = "loopback",
+		.mode = COMMAND_ANY,
+		.help = "loopback adapter driver commands",
+		.chain = loopback_subcommand_handlers,
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static struct jtag_interface loopback_interface = {
+	.supported = DEBUG_CAP_TMS_SEQ | DEBUG_CAP_QUEUE_OPTIMIZE,
+	.execute_queue = loopback_execute_queue,
+};
+
+struct adapter_driver loopback_adapter_driver = {
+	.name = "loopback",
+	.transports = jtag_only,
+	.commands = loopback_command_handlers,
+
+	.init = loopback_init,
+	.quit = loopback_quit,
+	.reset = loopback_reset,
+	.speed = loopback_speed,
+	.khz = loopback_khz,
+	.speed_div = loopback_speed_div,
+
+	.jtag_ops = &loopback_interface,
+};
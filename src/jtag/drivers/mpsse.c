@@ -85,6 +85,24 @@ char *ftd2xx_channel_names[] = {
 #define SIO_RESET_PURGE_RX 1
 #define SIO_RESET_PURGE_TX 2
 
+/* Number of command buffers the libusb backend rotates through, so that the
+ * next buffer can be filled while the previous ones are on the bus */
+#define MPSSE_BATCHES 2
+
+/* A command buffer handed over to libusb, and the read data it expects */
+struct mpsse_batch {
+	struct mpsse_ctx *ctx;
+	uint8_t *write_buffer;
+	unsigned write_count;
+	unsigned written;
+	bool write_done;
+	uint8_t *read_buffer;
+	unsigned read_count;
+	unsigned read_done;
+	struct bit_copy_queue read_queue;
+	struct libusb_transfer *write_transfer;
+};
+
 struct mpsse_ctx {
 	enum mpsse_backend_type backend;
 
@@ -114,6 +132,13 @@ struct mpsse_ctx {
 	unsigned read_chunk_size;
 	struct bit_copy_queue read_queue;
 	int retval;
+	// libusb backend, batches in flight
+	struct mpsse_batch batches[MPSSE_BATCHES];
+	unsigned batch_head; // oldest batch in flight
+	unsigned batch_count; // number of batches in flight
+	struct libusb_transfer *read_transfer;
+	bool read_active;
+	bool read_failed;
 };
 
 /* Returns true if the string descriptor indexed by str_index in device matches string */
@@ -495,6 +520,8 @@ error:
 	return false;
 }
 
+static void mpsse_cancel_batches(struct mpsse_ctx *ctx);
+
 struct mpsse_ctx *mpsse_open(const uint16_t *vid, const uint16_t *pid, const char *description,
 	const char *serial, const char *location, int channel)
 {
@@ -523,6 +550,20 @@ struct mpsse_ctx *mpsse_open(const uint16_t *vid, const uint16_t *pid, const cha
 	if (!ctx->read_chunk || !ctx->read_buffer || !ctx->write_buffer)
 		goto error;
 
+	for (unsigned i = 0; i < MPSSE_BATCHES; i++) {
+		struct mpsse_batch *batch = &ctx->batches[i];
+		batch->ctx = ctx;
+		bit_copy_queue_init(&batch->read_queue);
+		batch->read_buffer = malloc(ctx->read_size);
+		batch->write_buffer = calloc(1, ctx->write_size);
+		batch->write_transfer = libusb_alloc_transfer(0);
+		if (!batch->read_buffer || !batch->write_buffer || !batch->write_transfer)
+			goto error;
+	}
+	ctx->read_transfer = libusb_alloc_transfer(0);
+	if (!ctx->read_transfer)
+		goto error;
+
 	ctx->interface = channel;
 	ctx->index = channel + 1;
 	ctx->usb_read_timeout = 5000;
@@ -606,10 +647,26 @@ error:
 	return 0;
 }
 
+/* A transfer that was ever submitted keeps a pointer to the device handle,
+ * which libusb follows when freeing it, so this must run before
+ * libusb_close(). */
+static void mpsse_free_transfers(struct mpsse_ctx *ctx)
+{
+	for (unsigned i = 0; i < MPSSE_BATCHES; i++) {
+		libusb_free_transfer(ctx->batches[i].write_transfer);
+		ctx->batches[i].write_transfer = NULL;
+	}
+	libusb_free_transfer(ctx->read_transfer);
+	ctx->read_transfer = NULL;
+}
+
 void mpsse_close(struct mpsse_ctx *ctx)
 {
 	BACKEND_DIVERGENCE_START
 	BACKEND_DIVERGENCE_LIBUSB
+	if (ctx->usb_dev)
+		mpsse_cancel_batches(ctx);
+	mpsse_free_transfers(ctx);
 	if (ctx->usb_dev)
 		libusb_close(ctx->usb_dev);
 	if (ctx->usb_ctx)
@@ -621,8 +678,18 @@ void mpsse_close(struct mpsse_ctx *ctx)
 #endif // BUILD_BACKEND_FTD2XX
 	BACKEND_DIVERGENCE_END
 
+	/* other backends never submitted the transfers */
+	mpsse_free_transfers(ctx);
 	bit_copy_discard(&ctx->read_queue);
 
+	for (unsigned i = 0; i < MPSSE_BATCHES; i++) {
+		struct mpsse_batch *batch = &ctx->batches[i];
+		if (batch->ctx)
+			bit_copy_discard(&batch->read_queue);
+		free(batch->write_buffer);
+		free(batch->read_buffer);
+	}
+
 	free(ctx->write_buffer);
 	free(ctx->read_buffer);
 	free(ctx->read_chunk);
@@ -646,6 +713,8 @@ void mpsse_purge(struct mpsse_ctx *ctx)
 	// purge RX & TX buffer
 	BACKEND_DIVERGENCE_START
 	BACKEND_DIVERGENCE_LIBUSB
+	mpsse_cancel_batches(ctx);
+
 	err = libusb_control_transfer(ctx->usb_dev, FTDI_DEVICE_OUT_REQTYPE, SIO_RESET_REQUEST,
 			SIO_RESET_PURGE_RX, ctx->index, NULL, 0, ctx->usb_write_timeout);
 	if (err < 0) {
@@ -670,6 +739,8 @@ void mpsse_purge(struct mpsse_ctx *ctx)
 	BACKEND_DIVERGENCE_END
 }
 
+static int buffer_flush(struct mpsse_ctx *ctx);
+
 static unsigned buffer_write_space(struct mpsse_ctx *ctx)
 {
 	/* Reserve one byte for SEND_IMMEDIATE */
@@ -742,7 +813,7 @@ void mpsse_clock_data(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_of
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) + (length < 8) < (out || (!out && !in) ? 4 : 3)
 				|| (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = buffer_flush(ctx);
 
 		if (length < 8) {
 			/* Transfer remaining bits in bit mode */
@@ -816,7 +887,7 @@ void mpsse_clock_tms_cs(struct mpsse_ctx *ctx, const uint8_t *out, unsigned out_
 	while (length > 0) {
 		/* Guarantee buffer space enough for a minimum size transfer */
 		if (buffer_write_space(ctx) < 3 || (in && buffer_read_space(ctx) < 1))
-			ctx->retval = mpsse_flush(ctx);
+			ctx->retval = buffer_flush(ctx);
 
 		/* Byte transfer */
 		unsigned this_bits = length;
@@ -859,7 +930,7 @@ void mpsse_set_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t d
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x80);
 	buffer_write_byte(ctx, data);
@@ -876,7 +947,7 @@ void mpsse_set_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t data, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x82);
 	buffer_write_byte(ctx, data);
@@ -893,7 +964,7 @@ void mpsse_read_data_bits_low_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x81);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -909,7 +980,7 @@ void mpsse_read_data_bits_high_byte(struct mpsse_ctx *ctx, uint8_t *data)
 	}
 
 	if (buffer_write_space(ctx) < 1 || buffer_read_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x83);
 	buffer_add_read(ctx, data, 0, 8, 0);
@@ -924,7 +995,7 @@ static void single_byte_boolean_helper(struct mpsse_ctx *ctx, bool var, uint8_t
 	}
 
 	if (buffer_write_space(ctx) < 1)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, var ? val_if_true : val_if_false);
 }
@@ -945,7 +1016,7 @@ void mpsse_set_divisor(struct mpsse_ctx *ctx, uint16_t divisor)
 	}
 
 	if (buffer_write_space(ctx) < 3)
-		ctx->retval = mpsse_flush(ctx);
+		ctx->retval = buffer_flush(ctx);
 
 	buffer_write_byte(ctx, 0x86);
 	buffer_write_byte(ctx, divisor & 0xff);
@@ -1005,72 +1076,287 @@ int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency)
 	return frequency;
 }
 
-/* Context needed by the callbacks */
-struct transfer_result {
-	struct mpsse_ctx *ctx;
-	bool done;
-	unsigned transferred;
-};
+/* The read side is a single byte stream shared by all batches in flight: a
+ * single read transfer is kept submitted while any of them still expects
+ * data, and the data is handed out to the batches in submission order. */
+static struct mpsse_batch *reading_batch(struct mpsse_ctx *ctx)
+{
+	for (unsigned i = 0; i < ctx->batch_count; i++) {
+		struct mpsse_batch *batch = &ctx->batches[(ctx->batch_head + i) % MPSSE_BATCHES];
+		if (batch->read_done < batch->read_count)
+			return batch;
+	}
+	return NULL;
+}
+
+static bool batch_done(struct mpsse_batch *batch)
+{
+	return batch->write_done
+		&& (batch->read_done == batch->read_count || batch->ctx->read_failed);
+}
+
+static bool batches_idle(struct mpsse_ctx *ctx)
+{
+	for (unsigned i = 0; i < ctx->batch_count; i++)
+		if (!ctx->batches[(ctx->batch_head + i) % MPSSE_BATCHES].write_done)
+			return false;
+	return !ctx->read_active;
+}
 
 static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 {
-	struct transfer_result *res = transfer->user_data;
-	struct mpsse_ctx *ctx = res->ctx;
+	struct mpsse_ctx *ctx = transfer->user_data;
 
 	unsigned packet_size = ctx->max_packet_size;
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED
+			&& transfer->status != LIBUSB_TRANSFER_TIMED_OUT) {
+		ctx->read_active = false;
+		ctx->read_failed = true;
+		return;
+	}
+
 	/* Strip the two status bytes sent at the beginning of each USB packet
-	 * while copying the chunk buffer to the read buffer */
+	 * while copying the chunk buffer to the read buffers */
 	unsigned num_packets = DIV_ROUND_UP(transfer->actual_length, packet_size);
 	unsigned chunk_remains = transfer->actual_length;
 	for (unsigned i = 0; i < num_packets && chunk_remains > 2; i++) {
+		const uint8_t *data = ctx->read_chunk + packet_size * i + 2;
 		unsigned this_size = packet_size - 2;
 		if (this_size > chunk_remains - 2)
 			this_size = chunk_remains - 2;
-		if (this_size > ctx->read_count - res->transferred)
-			this_size = ctx->read_count - res->transferred;
-		memcpy(ctx->read_buffer + res->transferred,
-			ctx->read_chunk + packet_size * i + 2,
-			this_size);
-		res->transferred += this_size;
 		chunk_remains -= this_size + 2;
-		if (res->transferred == ctx->read_count) {
-			res->done = true;
-			break;
+
+		while (this_size > 0) {
+			struct mpsse_batch *batch = reading_batch(ctx);
+			if (!batch)
+				break;
+			unsigned n = batch->read_count - batch->read_done;
+			if (n > this_size)
+				n = this_size;
+			memcpy(batch->read_buffer + batch->read_done, data, n);
+			batch->read_done += n;
+			data += n;
+			this_size -= n;
 		}
 	}
 
-	LOG_DEBUG_IO("raw chunk %d, transferred %d of %d", transfer->actual_length, res->transferred,
-		ctx->read_count);
+	LOG_DEBUG_IO("raw chunk %d", transfer->actual_length);
 
-	if (!res->done)
-		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
+	if (!reading_batch(ctx))
+		ctx->read_active = false;
+	else if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS) {
+		ctx->read_active = false;
+		ctx->read_failed = true;
+	}
 }
 
 static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
 {
-	struct transfer_result *res = transfer->user_data;
-	struct mpsse_ctx *ctx = res->ctx;
+	struct mpsse_batch *batch = transfer->user_data;
+	struct mpsse_ctx *ctx = batch->ctx;
 
-	res->transferred += transfer->actual_length;
+	batch->written += transfer->actual_length;
 
-	LOG_DEBUG_IO("transferred %d of %d", res->transferred, ctx->write_count);
+	LOG_DEBUG_IO("transferred %d of %d", batch->written, batch->write_count);
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
-	if (res->transferred == ctx->write_count)
-		res->done = true;
+	/* A short write can only be resumed if no later batch is queued behind it */
+	if (batch->written == batch->write_count
+			|| transfer->status != LIBUSB_TRANSFER_COMPLETED || ctx->batch_count > 1)
+		batch->write_done = true;
 	else {
-		transfer->length = ctx->write_count - res->transferred;
-		transfer->buffer = ctx->write_buffer + res->transferred;
+		transfer->length = batch->write_count - batch->written;
+		transfer->buffer = batch->write_buffer + batch->written;
 		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
+			batch->write_done = true;
 	}
 }
 
+/* Handle libusb events until done() holds for arg, cancelling all transfers on error */
+static int batch_handle_events(struct mpsse_ctx *ctx, bool (*done)(void *arg), void *arg)
+{
+	/* Polling loop, more or less taken from libftdi */
+	int64_t start = timeval_ms();
+	int64_t warn_after = 2000;
+	int retval = LIBUSB_SUCCESS;
+	while (!done(arg)) {
+		struct timeval timeout_usb;
+
+		timeout_usb.tv_sec = 1;
+		timeout_usb.tv_usec = 0;
+
+		retval = libusb_handle_events_timeout_completed(ctx->usb_ctx, &timeout_usb, NULL);
+		keep_alive();
+		if (retval == LIBUSB_ERROR_NO_DEVICE || retval == LIBUSB_ERROR_INTERRUPTED)
+			break;
+
+		if (retval != LIBUSB_SUCCESS) {
+			mpsse_cancel_batches(ctx);
+			break;
+		}
+
+		int64_t now = timeval_ms();
+		if (now - start > warn_after) {
+			LOG_WARNING("Haven't made progress in mpsse_flush() for %" PRId64
+					"ms.", now - start);
+			warn_after *= 2;
+		}
+	}
+	return retval;
+}
+
+static bool batch_done_cb(void *arg)
+{
+	return batch_done(arg);
+}
+
+static bool batches_idle_cb(void *arg)
+{
+	return batches_idle(arg);
+}
+
+/* Cancel whatever is still on the bus and drop all batches in flight */
+static void mpsse_cancel_batches(struct mpsse_ctx *ctx)
+{
+	if (!ctx->usb_ctx)
+		return;
+
+	for (unsigned i = 0; i < ctx->batch_count; i++) {
+		struct mpsse_batch *batch = &ctx->batches[(ctx->batch_head + i) % MPSSE_BATCHES];
+		if (!batch->write_done)
+			libusb_cancel_transfer(batch->write_transfer);
+	}
+	if (ctx->read_active)
+		libusb_cancel_transfer(ctx->read_transfer);
+
+	while (!batches_idle(ctx)) {
+		struct timeval timeout_usb = { .tv_sec = 1 };
+		if (libusb_handle_events_timeout_completed(ctx->usb_ctx, &timeout_usb, NULL)
+				!= LIBUSB_SUCCESS)
+			break;
+	}
+
+	for (unsigned i = 0; i < ctx->batch_count; i++)
+		bit_copy_discard(&ctx->batches[(ctx->batch_head + i) % MPSSE_BATCHES].read_queue);
+	ctx->batch_head = 0;
+	ctx->batch_count = 0;
+	ctx->read_active = false;
+	ctx->read_failed = false;
+}
+
+/* Wait for the oldest batch in flight and deliver its read data */
+static int batch_wait(struct mpsse_ctx *ctx)
+{
+	struct mpsse_batch *batch = &ctx->batches[ctx->batch_head];
+
+	int retval = batch_handle_events(ctx, batch_done_cb, batch);
+	if (retval != LIBUSB_SUCCESS) {
+		LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(retval));
+		retval = ERROR_FAIL;
+	} else if (batch->written < batch->write_count) {
+		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
+			batch->written,
+			batch->write_count);
+		retval = ERROR_FAIL;
+	} else if (batch->read_done < batch->read_count) {
+		LOG_ERROR("ftdi device did not return all data: %d, expected %d",
+			batch->read_done,
+			batch->read_count);
+		retval = ERROR_FAIL;
+	} else {
+		bit_copy_execute(&batch->read_queue);
+		retval = ERROR_OK;
+	}
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	ctx->batch_head = (ctx->batch_head + 1) % MPSSE_BATCHES;
+	ctx->batch_count--;
+	return ERROR_OK;
+}
+
+/* Hand the buffer being filled over to libusb without waiting for it */
+static int batch_submit(struct mpsse_ctx *ctx)
+{
+	int retval;
+
+	if (ctx->batch_count == MPSSE_BATCHES) {
+		retval = batch_wait(ctx);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (ctx->read_count)
+		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
+
+	/* Swap the buffers, the batch takes over the filled ones */
+	struct mpsse_batch *batch = &ctx->batches[(ctx->batch_head + ctx->batch_count) % MPSSE_BATCHES];
+	uint8_t *buffer = batch->write_buffer;
+	batch->write_buffer = ctx->write_buffer;
+	ctx->write_buffer = buffer;
+	buffer = batch->read_buffer;
+	batch->read_buffer = ctx->read_buffer;
+	ctx->read_buffer = buffer;
+	list_splice_tail_init(&ctx->read_queue.list, &batch->read_queue.list);
+
+	batch->write_count = ctx->write_count;
+	batch->written = 0;
+	batch->write_done = false;
+	batch->read_count = ctx->read_count;
+	batch->read_done = 0;
+	ctx->write_count = 0;
+	ctx->read_count = 0;
+	ctx->batch_count++;
+
+	libusb_fill_bulk_transfer(batch->write_transfer, ctx->usb_dev, ctx->out_ep,
+		batch->write_buffer, batch->write_count, write_cb, batch, ctx->usb_write_timeout);
+	retval = libusb_submit_transfer(batch->write_transfer);
+	if (retval != LIBUSB_SUCCESS) {
+		batch->write_done = true;
+		LOG_ERROR("libusb_submit_transfer() failed with %s", libusb_error_name(retval));
+		return ERROR_FAIL;
+	}
+
+	/* The read is queued after the write to ensure the FTDI chip can
+	 * support us with data immediately after processing the MPSSE commands */
+	if (batch->read_count && !ctx->read_active) {
+		libusb_fill_bulk_transfer(ctx->read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
+			ctx->read_chunk_size, read_cb, ctx, ctx->usb_read_timeout);
+		retval = libusb_submit_transfer(ctx->read_transfer);
+		if (retval != LIBUSB_SUCCESS) {
+			ctx->read_failed = true;
+			LOG_ERROR("libusb_submit_transfer() failed with %s", libusb_error_name(retval));
+			return ERROR_FAIL;
+		}
+		ctx->read_active = true;
+	}
+
+	return ERROR_OK;
+}
+
+/* Flush a full buffer. With libusb the buffer is only submitted, and its read
+ * data delivered by a later mpsse_flush(), so queuing can go on in parallel. */
+static int buffer_flush(struct mpsse_ctx *ctx)
+{
+	BACKEND_DIVERGENCE_START
+	BACKEND_DIVERGENCE_LIBUSB
+	if (ctx->write_count == 0)
+		return ERROR_OK;
+
+	int retval = batch_submit(ctx);
+	if (retval != ERROR_OK)
+		mpsse_purge(ctx);
+	return retval;
+	BACKEND_DIVERGENCE_END
+
+	return mpsse_flush(ctx);
+}
+
 int mpsse_flush(struct mpsse_ctx *ctx)
 {
 	int retval = ctx->retval;
@@ -1086,7 +1372,7 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 			ctx->read_count);
 	assert(ctx->write_count > 0 || ctx->read_count == 0); /* No read data without write data */
 
-	if (ctx->write_count == 0)
+	if (ctx->write_count == 0 && ctx->batch_count == 0)
 		return retval;
 
 	BACKEND_DIVERGENCE_START
@@ -1163,99 +1449,10 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 	}
 #endif // BUILD_BACKEND_FTD2XX
 	BACKEND_DIVERGENCE_LIBUSB
-	// the original libusb data transfer
-	struct libusb_transfer *read_transfer = 0;
-	struct transfer_result read_result = { .ctx = ctx, .done = true };
-	if (ctx->read_count) {
-		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
-		read_result.done = false;
-		/* delay read transaction to ensure the FTDI chip can support us with data
-		   immediately after processing the MPSSE commands in the write transaction */
-	}
-
-	struct transfer_result write_result = { .ctx = ctx, .done = false };
-	struct libusb_transfer *write_transfer = libusb_alloc_transfer(0);
-	libusb_fill_bulk_transfer(write_transfer, ctx->usb_dev, ctx->out_ep, ctx->write_buffer,
-		ctx->write_count, write_cb, &write_result, ctx->usb_write_timeout);
-	retval = libusb_submit_transfer(write_transfer);
-	if (retval != LIBUSB_SUCCESS)
-		goto error_check;
-
-	if (ctx->read_count) {
-		read_transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
-			ctx->read_chunk_size, read_cb, &read_result,
-			ctx->usb_read_timeout);
-		retval = libusb_submit_transfer(read_transfer);
-		if (retval != LIBUSB_SUCCESS)
-			goto error_check;
-	}
-
-	/* Polling loop, more or less taken from libftdi */
-	int64_t start = timeval_ms();
-	int64_t warn_after = 2000;
-	while (!write_result.done || !read_result.done) {
-		struct timeval timeout_usb;
-
-		timeout_usb.tv_sec = 1;
-		timeout_usb.tv_usec = 0;
-
-		retval = libusb_handle_events_timeout_completed(ctx->usb_ctx, &timeout_usb, NULL);
-		keep_alive();
-		if (retval == LIBUSB_ERROR_NO_DEVICE || retval == LIBUSB_ERROR_INTERRUPTED)
-			break;
-
-		if (retval != LIBUSB_SUCCESS) {
-			libusb_cancel_transfer(write_transfer);
-			if (read_transfer)
-				libusb_cancel_transfer(read_transfer);
-			while (!write_result.done || !read_result.done) {
-				retval = libusb_handle_events_timeout_completed(ctx->usb_ctx,
-								&timeout_usb, NULL);
-				if (retval != LIBUSB_SUCCESS)
-					break;
-			}
-		}
-
-		int64_t now = timeval_ms();
-		if (now - start > warn_after) {
-			LOG_WARNING("Haven't made progress in mpsse_flush() for %" PRId64
-					"ms.", now - start);
-			warn_after *= 2;
-		}
-	}
-
-error_check:
-	if (retval != LIBUSB_SUCCESS) {
-		LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(retval));
-		retval = ERROR_FAIL;
-	} else if (write_result.transferred < ctx->write_count) {
-		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
-			write_result.transferred,
-			ctx->write_count);
-		retval = ERROR_FAIL;
-	} else if (read_result.transferred < ctx->read_count) {
-		LOG_ERROR("ftdi device did not return all data: %d, expected %d",
-			read_result.transferred,
-			ctx->read_count);
-		retval = ERROR_FAIL;
-	} else if (ctx->read_count) {
-		ctx->write_count = 0;
-		ctx->read_count = 0;
-		bit_copy_execute(&ctx->read_queue);
-		retval = ERROR_OK;
-	} else {
-		ctx->write_count = 0;
-		bit_copy_discard(&ctx->read_queue);
-		retval = ERROR_OK;
-	}
-
-	if (retval != ERROR_OK)
-		mpsse_purge(ctx);
-
-	libusb_free_transfer(write_transfer);
-	if (read_transfer)
-		libusb_free_transfer(read_transfer);
+	if (ctx->write_count)
+		retval = batch_submit(ctx);
+	while (retval == ERROR_OK && ctx->batch_count)
+		retval = batch_wait(ctx);
 
 	if (retval != ERROR_OK)
 		mpsse_purge(ctx);
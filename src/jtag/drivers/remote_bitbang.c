@@ -28,16 +28,55 @@
 #include "helper/system.h"
 #include "helper/replacements.h"
 #include <jtag/interface.h>
+#include <jtag/commands.h>
 #include "bitbang.h"
 
 /* arbitrary limit on host name length: */
 #define REMOTE_BITBANG_HOST_MAX 255
 
+/* Flags of the 'X' vector command, see the protocol description in
+ * doc/manual/jtag/drivers/remote_bitbang.txt */
+#define REMOTE_BITBANG_VEC_TMS_VECTOR	0x01
+#define REMOTE_BITBANG_VEC_TMS_HIGH		0x02
+#define REMOTE_BITBANG_VEC_TDI_VECTOR	0x04
+#define REMOTE_BITBANG_VEC_TDI_HIGH		0x08
+#define REMOTE_BITBANG_VEC_READ_TDO		0x10
+#define REMOTE_BITBANG_VEC_TMS_LAST		0x20
+
+/* Longer vectors are split, so a single reply never gets large. */
+#define REMOTE_BITBANG_VEC_MAX_BITS		(8 * 4096)
+/* Collect the replies before more than this many TDO bytes are in flight,
+ * so neither side can stall on a full socket while the other one is still
+ * writing to it. */
+#define REMOTE_BITBANG_VEC_MAX_PENDING	(16 * 1024)
+
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
 
+/* Try to negotiate the vector extension on init */
+static bool remote_bitbang_use_vectors = true;
+/* The server accepted the vector extension */
+static bool remote_bitbang_vectors;
+
+/* A scan whose TDO bytes are still (partly) on the way back */
+struct remote_bitbang_pending_scan {
+	struct scan_command *scan;
+	uint8_t *buffer;
+	/* TDO bytes requested from and received by the server so far */
+	unsigned int requested;
+	unsigned int received;
+};
+
+static struct remote_bitbang_pending_scan *remote_bitbang_pending;
+static unsigned int remote_bitbang_pending_count;
+static unsigned int remote_bitbang_pending_alloc;
+/* Index of the first scan with outstanding TDO bytes */
+static unsigned int remote_bitbang_pending_first;
+/* Number of TDO bytes requested but not received yet */
+static unsigned int remote_bitbang_pending_bytes;
+
 static int remote_bitbang_fd;
-static uint8_t remote_bitbang_send_buf[512];
+static uint8_t remote_bitbang_send_buf[4096];
 static unsigned int remote_bitbang_send_buf_used;
 
 /* Circular buffer. When start == end, the buffer is empty. */
@@ -71,6 +110,15 @@ static unsigned int remote_bitbang_recv_buf_contiguous_available_space(void)
 	}
 }
 
+static bool remote_bitbang_would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN;
+#endif
+}
+
 static int remote_bitbang_flush(void)
 {
 	if (remote_bitbang_send_buf_used <= 0)
@@ -80,6 +128,13 @@ static int remote_bitbang_flush(void)
 	while (offset < remote_bitbang_send_buf_used) {
 		ssize_t written = write_socket(remote_bitbang_fd, remote_bitbang_send_buf + offset,
 									   remote_bitbang_send_buf_used - offset);
+		if (written < 0 && remote_bitbang_would_block()) {
+			/* the remote side is busy, wait until it drains the socket */
+			socket_block(remote_bitbang_fd);
+			written = write_socket(remote_bitbang_fd, remote_bitbang_send_buf + offset,
+					remote_bitbang_send_buf_used - offset);
+			socket_nonblock(remote_bitbang_fd);
+		}
 		if (written < 0) {
 			log_socket_error("remote_bitbang_putc");
 			remote_bitbang_send_buf_used = 0;
@@ -129,11 +184,7 @@ static int remote_bitbang_fill_buf(enum block_bool block)
 		} else if (count == 0) {
 			return ERROR_OK;
 		} else if (count < 0) {
-#ifdef _WIN32
-			if (WSAGetLastError() == WSAEWOULDBLOCK) {
-#else
-			if (errno == EAGAIN) {
-#endif
+			if (remote_bitbang_would_block()) {
 				return ERROR_OK;
 			} else {
 				log_socket_error("remote_bitbang_fill_buf");
@@ -159,6 +210,21 @@ static int remote_bitbang_queue(int c, flush_bool_t flush)
 	return ERROR_OK;
 }
 
+static int remote_bitbang_queue_buf(const uint8_t *buf, size_t len)
+{
+	while (len) {
+		size_t n = MIN(len, ARRAY_SIZE(remote_bitbang_send_buf) - remote_bitbang_send_buf_used);
+		memcpy(remote_bitbang_send_buf + remote_bitbang_send_buf_used, buf, n);
+		remote_bitbang_send_buf_used += n;
+		buf += n;
+		len -= n;
+		if (remote_bitbang_send_buf_used >= ARRAY_SIZE(remote_bitbang_send_buf) &&
+				remote_bitbang_flush() != ERROR_OK)
+			return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
 static int remote_bitbang_quit(void)
 {
 	if (remote_bitbang_queue('Q', FLUSH_SEND_BUF) == ERROR_FAIL)
@@ -171,6 +237,9 @@ static int remote_bitbang_quit(void)
 
 	free(remote_bitbang_host);
 	free(remote_bitbang_port);
+	free(remote_bitbang_pending);
+	remote_bitbang_pending = NULL;
+	remote_bitbang_pending_alloc = 0;
 
 	LOG_INFO("remote_bitbang interface quit");
 	return ERROR_OK;
@@ -217,6 +286,49 @@ static int remote_bitbang_write(int tck, int tms, int tdi)
 	return remote_bitbang_queue(c, NO_FLUSH);
 }
 
+/* Clock a vector of bits through the single bit protocol. This queues the
+ * same characters as the per bit path, but keeps the loop (and the batching
+ * of TDO reads) inside the driver. */
+static int remote_bitbang_write_vector(const uint8_t *tms, const uint8_t *tdi,
+		uint8_t *tdo, unsigned int num_bits)
+{
+	unsigned int buffered = 0;
+
+	for (unsigned int i = 0; i < num_bits; i++) {
+		int tms_bit = tms ? (tms[i / 8] >> (i % 8)) & 1 : 0;
+		int tdi_bit = tdi ? (tdi[i / 8] >> (i % 8)) & 1 : 0;
+
+		if (remote_bitbang_write(0, tms_bit, tdi_bit) != ERROR_OK)
+			return ERROR_FAIL;
+		if (tdo) {
+			if (remote_bitbang_sample() != ERROR_OK)
+				return ERROR_FAIL;
+			buffered++;
+		}
+		if (remote_bitbang_write(1, tms_bit, tdi_bit) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (!tdo || (buffered < sizeof(remote_bitbang_recv_buf) - 1 && i != num_bits - 1))
+			continue;
+
+		for (unsigned int j = i + 1 - buffered; j <= i; j++) {
+			switch (remote_bitbang_read_sample()) {
+				case BB_LOW:
+					tdo[j / 8] &= ~(1 << (j % 8));
+					break;
+				case BB_HIGH:
+					tdo[j / 8] |= 1 << (j % 8);
+					break;
+				default:
+					return ERROR_FAIL;
+			}
+		}
+		buffered = 0;
+	}
+
+	return ERROR_OK;
+}
+
 static int remote_bitbang_reset(int trst, int srst)
 {
 	char c = 'r' + ((trst ? 0x2 : 0x0) | (srst ? 0x1 : 0x0));
@@ -231,11 +343,397 @@ static int remote_bitbang_blink(int on)
 	return remote_bitbang_queue(c, FLUSH_SEND_BUF);
 }
 
+/* Read exactly len bytes of a binary reply. */
+static int remote_bitbang_read_buf(uint8_t *buf, size_t len)
+{
+	while (len) {
+		if (!remote_bitbang_recv_buf_empty()) {
+			*buf++ = remote_bitbang_recv_buf[remote_bitbang_recv_buf_start];
+			remote_bitbang_recv_buf_start =
+				(remote_bitbang_recv_buf_start + 1) % sizeof(remote_bitbang_recv_buf);
+			len--;
+			continue;
+		}
+
+		if (remote_bitbang_flush() != ERROR_OK)
+			return ERROR_FAIL;
+
+		/* large replies go straight to their destination */
+		socket_block(remote_bitbang_fd);
+		ssize_t count = read_socket(remote_bitbang_fd, buf, len);
+		socket_nonblock(remote_bitbang_fd);
+		if (count == 0) {
+			LOG_ERROR("remote_bitbang: connection closed by the remote side");
+			return ERROR_FAIL;
+		} else if (count < 0) {
+			log_socket_error("remote_bitbang_read_buf");
+			return ERROR_FAIL;
+		}
+		buf += count;
+		len -= count;
+	}
+	return ERROR_OK;
+}
+
+/* Receive the TDO bytes of all the vectors sent so far. */
+static int remote_bitbang_vec_receive(void)
+{
+	for (; remote_bitbang_pending_first < remote_bitbang_pending_count;
+			remote_bitbang_pending_first++) {
+		struct remote_bitbang_pending_scan *p =
+			&remote_bitbang_pending[remote_bitbang_pending_first];
+		if (remote_bitbang_read_buf(p->buffer + p->received,
+				p->requested - p->received) != ERROR_OK)
+			return ERROR_FAIL;
+		p->received = p->requested;
+	}
+
+	/* the last scan may still be in the middle of being sent */
+	if (remote_bitbang_pending_first > 0)
+		remote_bitbang_pending_first--;
+	remote_bitbang_pending_bytes = 0;
+	return ERROR_OK;
+}
+
+/* Wait for all the replies, then hand the captured data to the scans. */
+static int remote_bitbang_vec_complete(void)
+{
+	int retval = remote_bitbang_vec_receive();
+
+	for (unsigned int i = 0; i < remote_bitbang_pending_count; i++) {
+		struct remote_bitbang_pending_scan *p = &remote_bitbang_pending[i];
+		if (retval == ERROR_OK && jtag_read_buffer(p->buffer, p->scan) != ERROR_OK)
+			retval = ERROR_JTAG_QUEUE_FAILED;
+		free(p->buffer);
+	}
+	remote_bitbang_pending_count = 0;
+	remote_bitbang_pending_first = 0;
+	remote_bitbang_pending_bytes = 0;
+	return retval;
+}
+
+static int remote_bitbang_vec_add_pending(struct scan_command *scan, uint8_t *buffer)
+{
+	if (remote_bitbang_pending_count == remote_bitbang_pending_alloc) {
+		unsigned int alloc = remote_bitbang_pending_alloc ? 2 * remote_bitbang_pending_alloc : 16;
+		struct remote_bitbang_pending_scan *pending =
+			realloc(remote_bitbang_pending, alloc * sizeof(*pending));
+		if (!pending) {
+			LOG_ERROR("remote_bitbang: out of memory");
+			return ERROR_FAIL;
+		}
+		remote_bitbang_pending = pending;
+		remote_bitbang_pending_alloc = alloc;
+	}
+
+	struct remote_bitbang_pending_scan *p = &remote_bitbang_pending[remote_bitbang_pending_count++];
+	p->scan = scan;
+	p->buffer = buffer;
+	p->requested = 0;
+	p->received = 0;
+	return ERROR_OK;
+}
+
+/**
+ * Clock num_bits TCK cycles with a single 'X' command per vector chunk.
+ * TMS and TDI are taken LSB first from the tms and tdi vectors, or are
+ * held at tms_value and low when the vector is NULL. With tms_last, TMS is
+ * raised on the final cycle, as needed to leave a shift state. If read_tdo
+ * is set, the TDO bits are queued for the scan added last by
+ * remote_bitbang_vec_add_pending(); they are not waited for here.
+ */
+static int remote_bitbang_vec_clock(const uint8_t *tms, bool tms_value, bool tms_last,
+		const uint8_t *tdi, bool read_tdo, unsigned int num_bits)
+{
+	for (unsigned int offset = 0; offset < num_bits; ) {
+		unsigned int bits = MIN(num_bits - offset, REMOTE_BITBANG_VEC_MAX_BITS);
+		unsigned int bytes = DIV_ROUND_UP(bits, 8);
+		uint8_t header[6];
+
+		header[0] = 'X';
+		header[1] = 0;
+		if (tms)
+			header[1] |= REMOTE_BITBANG_VEC_TMS_VECTOR;
+		else if (tms_value)
+			header[1] |= REMOTE_BITBANG_VEC_TMS_HIGH;
+		if (tms_last && offset + bits == num_bits)
+			header[1] |= REMOTE_BITBANG_VEC_TMS_LAST;
+		if (tdi)
+			header[1] |= REMOTE_BITBANG_VEC_TDI_VECTOR;
+		if (read_tdo) {
+			if (remote_bitbang_pending_bytes + bytes > REMOTE_BITBANG_VEC_MAX_PENDING &&
+					remote_bitbang_vec_receive() != ERROR_OK)
+				return ERROR_FAIL;
+			header[1] |= REMOTE_BITBANG_VEC_READ_TDO;
+		}
+		h_u32_to_le(header + 2, bits);
+
+		if (remote_bitbang_queue_buf(header, sizeof(header)) != ERROR_OK)
+			return ERROR_FAIL;
+		if (tms && remote_bitbang_queue_buf(tms + offset / 8, bytes) != ERROR_OK)
+			return ERROR_FAIL;
+		if (tdi && remote_bitbang_queue_buf(tdi + offset / 8, bytes) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (read_tdo) {
+			remote_bitbang_pending[remote_bitbang_pending_count - 1].requested += bytes;
+			remote_bitbang_pending_bytes += bytes;
+		}
+		offset += bits;
+	}
+	return ERROR_OK;
+}
+
+static int remote_bitbang_vec_state_move(int skip)
+{
+	uint8_t tms_scan = tap_get_tms_path(tap_get_state(), tap_get_end_state());
+	int tms_count = tap_get_tms_path_len(tap_get_state(), tap_get_end_state());
+	int tms = 0;
+
+	if (tms_count > skip) {
+		tms_scan >>= skip;
+		if (remote_bitbang_vec_clock(&tms_scan, false, false, NULL, false,
+				tms_count - skip) != ERROR_OK)
+			return ERROR_FAIL;
+		tms = (tms_scan >> (tms_count - skip - 1)) & 1;
+	}
+	if (remote_bitbang_write(0, tms, 0) != ERROR_OK)
+		return ERROR_FAIL;
+
+	tap_set_state(tap_get_end_state());
+	return ERROR_OK;
+}
+
+static int remote_bitbang_vec_execute_tms(struct tms_command *cmd)
+{
+	LOG_DEBUG_IO("TMS: %d bits", cmd->num_bits);
+
+	if (!cmd->num_bits)
+		return ERROR_OK;
+
+	if (remote_bitbang_vec_clock(cmd->bits, false, false, NULL, false,
+			cmd->num_bits) != ERROR_OK)
+		return ERROR_FAIL;
+
+	unsigned int last = cmd->num_bits - 1;
+	return remote_bitbang_write(0, (cmd->bits[last / 8] >> (last % 8)) & 1, 0);
+}
+
+static int remote_bitbang_vec_path_move(struct pathmove_command *cmd)
+{
+	uint8_t *tms_bits = calloc(DIV_ROUND_UP(cmd->num_states, 8), 1);
+	int tms = 0;
+
+	if (!tms_bits) {
+		LOG_ERROR("remote_bitbang: out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (int i = 0; i < cmd->num_states; i++) {
+		if (tap_state_transition(tap_get_state(), false) == cmd->path[i]) {
+			tms = 0;
+		} else if (tap_state_transition(tap_get_state(), true) == cmd->path[i]) {
+			tms = 1;
+		} else {
+			LOG_ERROR("BUG: %s -> %s isn't a valid TAP transition",
+				tap_state_name(tap_get_state()),
+				tap_state_name(cmd->path[i]));
+			exit(-1);
+		}
+		tms_bits[i / 8] |= tms << (i % 8);
+		tap_set_state(cmd->path[i]);
+	}
+
+	int retval = remote_bitbang_vec_clock(tms_bits, false, false, NULL, false, cmd->num_states);
+	free(tms_bits);
+	if (retval != ERROR_OK)
+		return retval;
+	if (remote_bitbang_write(0, tms, 0) != ERROR_OK)
+		return ERROR_FAIL;
+
+	tap_set_end_state(tap_get_state());
+	return ERROR_OK;
+}
+
+static int remote_bitbang_vec_runtest(struct runtest_command *cmd)
+{
+	LOG_DEBUG_IO("runtest %i cycles, end in %s", cmd->num_cycles,
+			tap_state_name(cmd->end_state));
+
+	/* only do a state_move when we're not already in IDLE */
+	if (tap_get_state() != TAP_IDLE) {
+		tap_set_end_state(TAP_IDLE);
+		if (remote_bitbang_vec_state_move(0) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
+	if (cmd->num_cycles > 0 &&
+			remote_bitbang_vec_clock(NULL, false, false, NULL, false, cmd->num_cycles) != ERROR_OK)
+		return ERROR_FAIL;
+	if (remote_bitbang_write(0, 0, 0) != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* finish in end_state */
+	tap_set_end_state(cmd->end_state);
+	if (tap_get_state() != tap_get_end_state())
+		return remote_bitbang_vec_state_move(0);
+	return ERROR_OK;
+}
+
+static int remote_bitbang_vec_stableclocks(int num_cycles)
+{
+	bool tms = tap_get_state() == TAP_RESET;
+
+	if (num_cycles <= 0)
+		return ERROR_OK;
+	if (remote_bitbang_vec_clock(NULL, tms, false, NULL, false, num_cycles) != ERROR_OK)
+		return ERROR_FAIL;
+	return remote_bitbang_write(0, tms, 0);
+}
+
+static int remote_bitbang_vec_scan(struct scan_command *cmd)
+{
+	uint8_t *buffer;
+	int scan_size = jtag_build_buffer(cmd, &buffer);
+	enum scan_type type = jtag_scan_type(cmd);
+
+	LOG_DEBUG_IO("%s scan %d bits; end in %s", cmd->ir_scan ? "IR" : "DR",
+			scan_size, tap_state_name(cmd->end_state));
+
+	tap_state_t shift_state = cmd->ir_scan ? TAP_IRSHIFT : TAP_DRSHIFT;
+	if (tap_get_state() != shift_state) {
+		tap_set_end_state(shift_state);
+		if (remote_bitbang_vec_state_move(0) != ERROR_OK) {
+			free(buffer);
+			return ERROR_FAIL;
+		}
+	}
+	tap_set_end_state(cmd->end_state);
+
+	/* the buffer is owned by the pending list from here on */
+	if (type != SCAN_OUT && remote_bitbang_vec_add_pending(cmd, buffer) != ERROR_OK) {
+		free(buffer);
+		return ERROR_FAIL;
+	}
+
+	int retval = remote_bitbang_vec_clock(NULL, false, true,
+			type != SCAN_IN ? buffer : NULL, type != SCAN_OUT, scan_size);
+	if (type == SCAN_OUT)
+		free(buffer);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (tap_get_state() != tap_get_end_state()) {
+		/* the last bit already left the shift state, skip that transition */
+		return remote_bitbang_vec_state_move(1);
+	}
+	return ERROR_OK;
+}
+
+/* Execute the queue with the vector extension. The TDO data is collected
+ * once at the end, so a whole queue normally needs a single round trip. */
+static int remote_bitbang_vec_execute_queue(void)
+{
+	int retval = ERROR_OK;
+
+	if (remote_bitbang_blink(1) != ERROR_OK)
+		return ERROR_FAIL;
+
+	for (struct jtag_command *cmd = jtag_command_queue; cmd && retval == ERROR_OK;
+			cmd = cmd->next) {
+		switch (cmd->type) {
+			case JTAG_RUNTEST:
+				retval = remote_bitbang_vec_runtest(cmd->cmd.runtest);
+				break;
+			case JTAG_STABLECLOCKS:
+				retval = remote_bitbang_vec_stableclocks(cmd->cmd.stableclocks->num_cycles);
+				break;
+			case JTAG_TLR_RESET:
+				LOG_DEBUG_IO("statemove end in %s",
+						tap_state_name(cmd->cmd.statemove->end_state));
+				tap_set_end_state(cmd->cmd.statemove->end_state);
+				retval = remote_bitbang_vec_state_move(0);
+				break;
+			case JTAG_PATHMOVE:
+				LOG_DEBUG_IO("pathmove: %i states, end in %s",
+						cmd->cmd.pathmove->num_states,
+						tap_state_name(cmd->cmd.pathmove->path[cmd->cmd.pathmove->num_states - 1]));
+				retval = remote_bitbang_vec_path_move(cmd->cmd.pathmove);
+				break;
+			case JTAG_SCAN:
+				retval = remote_bitbang_vec_scan(cmd->cmd.scan);
+				break;
+			case JTAG_SLEEP:
+				LOG_DEBUG_IO("sleep %" PRIu32, cmd->cmd.sleep->us);
+				/* everything queued so far has to happen before the delay */
+				retval = remote_bitbang_vec_receive();
+				if (retval == ERROR_OK)
+					retval = remote_bitbang_flush();
+				jtag_sleep(cmd->cmd.sleep->us);
+				break;
+			case JTAG_TMS:
+				retval = remote_bitbang_vec_execute_tms(cmd->cmd.tms);
+				break;
+			default:
+				LOG_ERROR("BUG: unknown JTAG command type encountered");
+				exit(-1);
+		}
+	}
+
+	int complete = remote_bitbang_vec_complete();
+	if (retval == ERROR_OK)
+		retval = complete;
+
+	if (remote_bitbang_blink(0) != ERROR_OK)
+		return ERROR_FAIL;
+	return retval;
+}
+
+/* Ask the server for the vector extension. A server without it ignores the
+ * 'V' and only answers the read request behind it, so no timeout is needed
+ * to tell both kinds apart. */
+static int remote_bitbang_negotiate(void)
+{
+	uint8_t reply;
+
+	remote_bitbang_vectors = false;
+	if (!remote_bitbang_use_vectors)
+		return ERROR_OK;
+
+	if (remote_bitbang_queue('V', NO_FLUSH) != ERROR_OK ||
+			remote_bitbang_queue('R', FLUSH_SEND_BUF) != ERROR_OK)
+		return ERROR_FAIL;
+	if (remote_bitbang_read_buf(&reply, 1) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (reply == 'V') {
+		uint8_t version[2];
+
+		/* version digit, then the answer to 'R' */
+		if (remote_bitbang_read_buf(version, sizeof(version)) != ERROR_OK)
+			return ERROR_FAIL;
+		reply = version[1];
+		remote_bitbang_vectors = version[0] >= '1';
+	}
+
+	if (reply != '0' && reply != '1') {
+		LOG_ERROR("remote_bitbang: invalid read response: %c(%i)", reply, reply);
+		return ERROR_FAIL;
+	}
+
+	if (remote_bitbang_vectors)
+		LOG_INFO("remote_bitbang: using the vector extension");
+	else
+		LOG_INFO("remote_bitbang: server has no vector extension, using single bit requests");
+	return ERROR_OK;
+}
+
 static struct bitbang_interface remote_bitbang_bitbang = {
 	.buf_size = sizeof(remote_bitbang_recv_buf) - 1,
 	.sample = &remote_bitbang_sample,
 	.read_sample = &remote_bitbang_read_sample,
 	.write = &remote_bitbang_write,
+	.write_vector = &remote_bitbang_write_vector,
 	.blink = &remote_bitbang_blink,
 };
 
@@ -334,6 +832,9 @@ static int remote_bitbang_init(void)
 
 	socket_nonblock(remote_bitbang_fd);
 
+	if (remote_bitbang_negotiate() != ERROR_OK)
+		return ERROR_FAIL;
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -360,6 +861,18 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_vectors_command)
+{
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], remote_bitbang_use_vectors);
+	else if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "remote_bitbang vector extension %s",
+			remote_bitbang_use_vectors ? "enabled" : "disabled");
+	return ERROR_OK;
+}
+
 static const struct command_registration remote_bitbang_subcommand_handlers[] = {
 	{
 		.name = "port",
@@ -377,6 +890,14 @@ static const struct command_registration remote_bitbang_subcommand_handlers[] =
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "vectors",
+		.handler = remote_bitbang_handle_remote_bitbang_vectors_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Negotiate the vector extension of the protocol, which sends\n"
+			"  whole scans in one request instead of one per TCK edge.",
+		.usage = "['enable'|'disable']",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
@@ -398,7 +919,11 @@ static int remote_bitbang_execute_queue(void)
 	assert(remote_bitbang_send_buf_used == 0);
 
 	/* process the JTAG command queue */
-	int ret = bitbang_execute_queue();
+	int ret;
+	if (remote_bitbang_vectors)
+		ret = remote_bitbang_vec_execute_queue();
+	else
+		ret = bitbang_execute_queue();
 	if (ret != ERROR_OK)
 		return ret;
 
@@ -407,6 +932,7 @@ static int remote_bitbang_execute_queue(void)
 }
 
 static struct jtag_interface remote_bitbang_interface = {
+	.supported = DEBUG_CAP_QUEUE_OPTIMIZE,
 	.execute_queue = &remote_bitbang_execute_queue,
 };
 
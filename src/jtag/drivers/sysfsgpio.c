@@ -576,9 +576,44 @@ struct adapter_driver sysfsgpio_adapter_driver = {
 	.swd_ops = &bitbang_swd,
 };
 
+/*
+ * Bitbang interface clocking of a vector of bits
+ *
+ * TDO is sampled with pread() at offset 0, which both rewinds the value file
+ * and reads it in one system call instead of lseek() followed by read().
+ */
+static int sysfsgpio_write_vector(const uint8_t *tms, const uint8_t *tdi,
+		uint8_t *tdo, unsigned int num_bits)
+{
+	char buf[1];
+
+	for (unsigned int i = 0; i < num_bits; i++) {
+		int tms_bit = tms ? (tms[i / 8] >> (i % 8)) & 1 : 0;
+		int tdi_bit = tdi ? (tdi[i / 8] >> (i % 8)) & 1 : 0;
+
+		sysfsgpio_write(0, tms_bit, tdi_bit);
+
+		if (tdo) {
+			if (pread(tdo_fd, buf, sizeof(buf), 0) != sizeof(buf)) {
+				LOG_ERROR("reading tdo failed");
+				return ERROR_FAIL;
+			}
+			if (buf[0] == '0')
+				tdo[i / 8] &= ~(1 << (i % 8));
+			else
+				tdo[i / 8] |= 1 << (i % 8);
+		}
+
+		sysfsgpio_write(1, tms_bit, tdi_bit);
+	}
+
+	return ERROR_OK;
+}
+
 static struct bitbang_interface sysfsgpio_bitbang = {
 	.read = sysfsgpio_read,
 	.write = sysfsgpio_write,
+	.write_vector = sysfsgpio_write_vector,
 	.swdio_read = sysfsgpio_swdio_read,
 	.swdio_drive = sysfsgpio_swdio_drive,
 	.swd_write = sysfsgpio_swd_write,
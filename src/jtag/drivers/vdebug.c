@@ -54,6 +54,12 @@
 #include <netdb.h>
 #endif
 #endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 #include <stdio.h>
 #ifdef HAVE_STDINT_H
 #include <stdint.h>
@@ -80,6 +86,8 @@
 #define VD_MAX_MEMORIES 4
 #define VD_POLL_INTERVAL 500
 #define VD_SCALE_PSTOMS 1000000000
+#define VD_SHM_SPINS 2000
+#define VD_SHM_TIMEOUT 60000
 
 /**
  * @brief List of transactor types
@@ -155,6 +163,15 @@ enum {
 	VD_CMD_MEMWRITE   = 0x23,
 };
 
+/**
+ * @brief Values of vd_shm.state, when the buffer is shared with the server
+ */
+enum {
+	VD_SHM_IDLE       = 0,  /* nothing pending */
+	VD_SHM_REQUEST    = 1,  /* request written by the client */
+	VD_SHM_DONE       = 2,  /* reply written by the server */
+};
+
 enum {
 	VD_BATCH_NO       = 0,
 	VD_BATCH_WO       = 1,
@@ -219,7 +236,9 @@ struct vd_client {
 	uint32_t poll_max;
 	uint32_t targ_time;
 	int hsocket;
+	int hshm;
 	char server_name[32];
+	char shm_path[128];
 	char bfm_path[128];
 	char mem_path[VD_MAX_MEMORIES][128];
 	uint8_t *tdo;
@@ -329,8 +348,87 @@ static int vdebug_socket_send(int hsock, struct vd_shm *pmem)
 	return rc;
 }
 
+#ifdef __linux__
+static long vdebug_futex(uint32_t *addr, int op, uint32_t val, const struct timespec *timeout)
+{
+	return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+static struct vd_shm *vdebug_shm_open(const char *path)
+{
+	vdc.hshm = open(path, O_RDWR);
+	if (vdc.hshm < 0) {
+		LOG_ERROR("shm_open: cannot open %s, error %d", path, errno);
+		return NULL;
+	}
+
+	void *pmem = mmap(NULL, sizeof(struct vd_shm), PROT_READ | PROT_WRITE, MAP_SHARED, vdc.hshm, 0);
+	if (pmem == MAP_FAILED) {
+		LOG_ERROR("shm_open: cannot map %s, error %d", path, errno);
+		close(vdc.hshm);
+		vdc.hshm = -1;
+		return NULL;
+	}
+
+	return pmem;
+}
+
+static void vdebug_shm_close(struct vd_shm *pmem)
+{
+	munmap(pmem, sizeof(struct vd_shm));
+	close(vdc.hshm);
+	vdc.hshm = -1;
+}
+
+/* The request is already in place, hand it over and wait for the reply.
+ * Spin shortly before sleeping, a co-simulation on another core answers
+ * most requests in a few microseconds. */
+static uint32_t vdebug_shm_wait_server(struct vd_shm *pmem)
+{
+	const struct timespec tick = { .tv_sec = 0, .tv_nsec = 100000000 };
+	int64_t ts = timeval_ms();
+
+	__atomic_store_n(&pmem->state, VD_SHM_REQUEST, __ATOMIC_RELEASE);
+	vdebug_futex(&pmem->state, FUTEX_WAKE, 1, NULL);
+
+	for (unsigned int spins = 0; __atomic_load_n(&pmem->state, __ATOMIC_ACQUIRE) != VD_SHM_DONE; ) {
+		if (spins < VD_SHM_SPINS) {
+			spins++;
+			continue;
+		}
+		vdebug_futex(&pmem->state, FUTEX_WAIT, VD_SHM_REQUEST, &tick);
+		if (timeval_ms() - ts > VD_SHM_TIMEOUT) {
+			LOG_ERROR("shm_wait_server: no reply to cmd %02" PRIx8, pmem->cmd);
+			return VD_ERR_TIME_OUT;
+		}
+	}
+
+	int rc = pmem->status;
+	LOG_DEBUG_IO("shm_wait_server: cmd %02" PRIx8 " done, status %d", pmem->cmd, rc);
+
+	return rc;
+}
+#else
+static struct vd_shm *vdebug_shm_open(const char *path)
+{
+	LOG_ERROR("shm_open: shared memory transport not supported on this platform");
+	return NULL;
+}
+
+static void vdebug_shm_close(struct vd_shm *pmem)
+{
+}
+
+static uint32_t vdebug_shm_wait_server(struct vd_shm *pmem)
+{
+	return VD_ERR_NOT_IMPL;
+}
+#endif
+
 static uint32_t vdebug_wait_server(int hsock, struct vd_shm *pmem)
 {
+	if (vdc.hshm >= 0)
+		return vdebug_shm_wait_server(pmem);
 	if (!hsock)
 		return VD_ERR_SOC_OPEN;
 	int st = vdebug_socket_send(hsock, pmem);
@@ -673,32 +771,21 @@ static void vdebug_mem_close(int hsock, struct vd_shm *pm, uint8_t ndx)
 	LOG_DEBUG("%" PRIx8 ": %s", ndx, vdc.mem_path[ndx]);
 }
 
-static int vdebug_init(void)
+static int vdebug_init_bfm(void)
 {
-	vdc.hsocket = vdebug_socket_open(vdc.server_name, vdc.server_port);
-	pbuf = calloc(1, sizeof(struct vd_shm));
-	if (!pbuf) {
-		close_socket(vdc.hsocket);
-		vdc.hsocket = 0;
-		LOG_ERROR("cannot allocate %lu bytes", sizeof(struct vd_shm));
-		return ERROR_FAIL;
-	}
-	if (vdc.hsocket <= 0) {
-		free(pbuf);
-		pbuf = NULL;
-		LOG_ERROR("cannot connect to vdebug server %s:%" PRIu16,
-			vdc.server_name, vdc.server_port);
-		return ERROR_FAIL;
-	}
 	vdc.trans_first = 1;
 	vdc.poll_cycles = vdc.poll_max;
 	uint32_t sig_mask = VD_SIG_RESET | VD_SIG_TRST | VD_SIG_TCKDIV;
 	int rc = vdebug_open(vdc.hsocket, pbuf, vdc.bfm_path, vdc.bfm_type, vdc.bfm_period, sig_mask);
 	if (rc != 0) {
 		LOG_ERROR("cannot connect to %s, rc 0x%x", vdc.bfm_path, rc);
-		close_socket(vdc.hsocket);
-		vdc.hsocket = 0;
-		free(pbuf);
+		if (vdc.hshm >= 0) {
+			vdebug_shm_close(pbuf);
+		} else {
+			close_socket(vdc.hsocket);
+			vdc.hsocket = 0;
+			free(pbuf);
+		}
 		pbuf = NULL;
 	} else {
 		for (uint8_t i = 0; i < vdc.mem_ndx; i++) {
@@ -707,13 +794,48 @@ static int vdebug_init(void)
 				LOG_ERROR("cannot connect to %s, rc 0x%x", vdc.mem_path[i], rc);
 		}
 
-		LOG_INFO("vdebug %d connected to %s through %s:%" PRIu16,
-				 VD_VERSION, vdc.bfm_path, vdc.server_name, vdc.server_port);
+		if (vdc.hshm >= 0)
+			LOG_INFO("vdebug %d connected to %s through shared memory %s",
+					 VD_VERSION, vdc.bfm_path, vdc.shm_path);
+		else
+			LOG_INFO("vdebug %d connected to %s through %s:%" PRIu16,
+					 VD_VERSION, vdc.bfm_path, vdc.server_name, vdc.server_port);
 	}
 
 	return rc;
 }
 
+static int vdebug_init(void)
+{
+	vdc.hshm = -1;
+	if (vdc.shm_path[0]) {
+		/* the buffer is shared with the server, no socket needed */
+		pbuf = vdebug_shm_open(vdc.shm_path);
+		if (!pbuf)
+			return ERROR_FAIL;
+		vdc.hsocket = 0;
+		return vdebug_init_bfm();
+	}
+
+	vdc.hsocket = vdebug_socket_open(vdc.server_name, vdc.server_port);
+	pbuf = calloc(1, sizeof(struct vd_shm));
+	if (!pbuf) {
+		close_socket(vdc.hsocket);
+		vdc.hsocket = 0;
+		LOG_ERROR("cannot allocate %lu bytes", sizeof(struct vd_shm));
+		return ERROR_FAIL;
+	}
+	if (vdc.hsocket <= 0) {
+		free(pbuf);
+		pbuf = NULL;
+		LOG_ERROR("cannot connect to vdebug server %s:%" PRIu16,
+			vdc.server_name, vdc.server_port);
+		return ERROR_FAIL;
+	}
+
+	return vdebug_init_bfm();
+}
+
 static int vdebug_quit(void)
 {
 	for (uint8_t i = 0; i < vdc.mem_ndx; i++)
@@ -722,9 +844,13 @@ static int vdebug_quit(void)
 	int rc = vdebug_close(vdc.hsocket, pbuf, vdc.bfm_type);
 	LOG_INFO("vdebug %d disconnected from %s through %s:%" PRIu16 " rc:%d", VD_VERSION,
 		vdc.bfm_path, vdc.server_name, vdc.server_port, rc);
-	if (vdc.hsocket)
-		close_socket(vdc.hsocket);
-	free(pbuf);
+	if (vdc.hshm >= 0) {
+		vdebug_shm_close(pbuf);
+	} else {
+		if (vdc.hsocket)
+			close_socket(vdc.hsocket);
+		free(pbuf);
+	}
 	pbuf = NULL;
 
 	return ERROR_OK;
@@ -932,6 +1058,17 @@ COMMAND_HANDLER(vdebug_set_server)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(vdebug_set_shm)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	strncpy(vdc.shm_path, CMD_ARGV[0], sizeof(vdc.shm_path) - 1);
+	LOG_DEBUG("shm: %s", vdc.shm_path);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(vdebug_set_bfm)
 {
 	char prefix;
@@ -1015,6 +1152,13 @@ static const struct command_registration vdebug_command_handlers[] = {
 		.help = "set the vdebug server name or address",
 		.usage = "<host:port>",
 	},
+	{
+		.name = "shm",
+		.handler = &vdebug_set_shm,
+		.mode = COMMAND_CONFIG,
+		.help = "use a buffer shared with a local vdebug server instead of the socket",
+		.usage = "<path>",
+	},
 	{
 		.name = "bfm_path",
 		.handler = &vdebug_set_bfm,
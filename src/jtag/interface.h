@@ -198,6 +198,8 @@ struct jtag_interface {
 	 */
 	unsigned supported;
 #define DEBUG_CAP_TMS_SEQ	(1 << 0)
+/* execute_queue() accepts a queue rewritten by jtag_command_queue_optimize() */
+#define DEBUG_CAP_QUEUE_OPTIMIZE	(1 << 1)
 
 	/**
 	 * Execute queued commands.
@@ -108,6 +108,14 @@ struct scan_field {
 	uint8_t *check_mask;
 };
 
+/** Scans queued for a TAP, or executed by the adapter. */
+struct jtag_scan_stats {
+	uint64_t ir_scans;
+	uint64_t ir_bits;
+	uint64_t dr_scans;
+	uint64_t dr_bits;
+};
+
 struct jtag_tap {
 	char *chip;
 	char *tapname;
@@ -145,6 +153,9 @@ struct jtag_tap {
 
 	struct jtag_tap_event_action *event_action;
 
+	/** Scans queued for this TAP, see "jtag stats" */
+	struct jtag_scan_stats scan_stats;
+
 	struct jtag_tap *next_tap;
 	/* private pointer to support none-jtag specific functions */
 	void *priv;
@@ -532,6 +543,27 @@ void jtag_execute_queue_noclear(void);
 /** @returns the number of times the scan queue has been flushed */
 int jtag_get_flush_queue_count(void);
 
+/**
+ * Same as jtag_execute_queue(), but accounts the flush to @a tag in the
+ * statistics shown by "jtag stats", unless a caller up the stack already
+ * set a tag with jtag_stats_push_tag().
+ */
+int jtag_execute_queue_tagged(const char *tag);
+
+/**
+ * Account the queue flushes that follow to the subsystem @a tag, which must
+ * be a string constant. When a tag is already set it stays in effect, so the
+ * outermost caller (e.g. a flash driver running on top of a debug port) is
+ * the one that gets charged.
+ * @returns the previous tag, to be handed to jtag_stats_pop_tag().
+ */
+const char *jtag_stats_push_tag(const char *tag);
+void jtag_stats_pop_tag(const char *prev_tag);
+
+/** Print the flush and scan statistics, or log them when @a cmd is NULL. */
+void jtag_stats_show(struct command_invocation *cmd);
+void jtag_stats_reset(void);
+
 /** Report Tcl event to all TAPs */
 void jtag_notify_event(enum jtag_event);
 
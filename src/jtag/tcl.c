@@ -36,6 +36,7 @@
 #include "minidriver.h"
 #include "interface.h"
 #include "interfaces.h"
+#include "commands.h"
 #include "tcl.h"
 
 #ifdef HAVE_STRINGS_H
@@ -859,6 +860,50 @@ COMMAND_HANDLER(handle_jtag_init_command)
 	return jtag_init(CMD_CTX);
 }
 
+COMMAND_HANDLER(handle_jtag_queue_optimizer_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset") == 0) {
+			jtag_queue_optimizer_reset_stats();
+		} else {
+			bool enable;
+			COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+			jtag_queue_optimizer_enable(enable);
+		}
+	}
+
+	const struct jtag_queue_optimizer_stats *stats = jtag_queue_optimizer_get_stats();
+	command_print(CMD, "jtag queue optimizer is %s",
+		jtag_queue_optimizer_is_enabled() ? "enabled" : "disabled");
+	command_print(CMD, "commands queued:    %" PRIu64, stats->commands_in);
+	command_print(CMD, "commands executed:  %" PRIu64, stats->commands_out);
+	command_print(CMD, "IR scans elided:    %" PRIu64, stats->ir_scans_elided);
+	command_print(CMD, "runtests merged:    %" PRIu64, stats->runtests_merged);
+	command_print(CMD, "TAP moves elided:   %" PRIu64, stats->moves_elided);
+	command_print(CMD, "scans folded:       %" PRIu64, stats->scans_folded);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_stats_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		jtag_stats_reset();
+		return ERROR_OK;
+	}
+
+	jtag_stats_show(CMD);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_subcommand_handlers[] = {
 	{
 		.name = "init",
@@ -942,6 +987,22 @@ static const struct command_registration jtag_subcommand_handlers[] = {
 		.jim_handler = jim_jtag_names,
 		.help = "Returns list of all JTAG tap names.",
 	},
+	{
+		.name = "queue_optimizer",
+		.handler = handle_jtag_queue_optimizer_command,
+		.mode = COMMAND_ANY,
+		.help = "Enable or disable the JTAG queue optimizer, or reset "
+			"its counters, then print them.",
+		.usage = "['on'|'off'|'reset']",
+	},
+	{
+		.name = "stats",
+		.handler = handle_jtag_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "Show the JTAG queue flush statistics per adapter, "
+			"caller and TAP, or reset them.",
+		.usage = "['reset']",
+	},
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
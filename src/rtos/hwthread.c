@@ -46,6 +46,9 @@ static int hwthread_write_buffer(struct rtos *rtos, target_addr_t address,
 		uint32_t size, const uint8_t *buffer);
 struct target *hwthread_swbp_target(struct rtos *rtos, target_addr_t address,
 				    uint32_t length, enum breakpoint_type type);
+static int hwthread_halt_thread(struct rtos *rtos, threadid_t thread_id);
+static int hwthread_resume_thread(struct rtos *rtos, threadid_t thread_id, bool step);
+static threadid_t hwthread_target_threadid(struct rtos *rtos, struct target *target);
 
 #define HW_THREAD_NAME_STR_SIZE (32)
 
@@ -69,7 +72,10 @@ const struct rtos_type hwthread_rtos = {
 	.needs_fake_step = hwthread_needs_fake_step,
 	.read_buffer = hwthread_read_buffer,
 	.write_buffer = hwthread_write_buffer,
-	.swbp_target = hwthread_swbp_target
+	.swbp_target = hwthread_swbp_target,
+	.halt_thread = hwthread_halt_thread,
+	.resume_thread = hwthread_resume_thread,
+	.target_threadid = hwthread_target_threadid
 };
 
 struct hwthread_params {
@@ -455,3 +461,42 @@ struct target *hwthread_swbp_target(struct rtos *rtos, target_addr_t address,
 {
 	return hwthread_find_thread(rtos->target, rtos->current_thread);
 }
+
+/* In non-stop mode the target halts, resumes and steps only the core it is
+ * called on, see target_set_non_stop(). */
+static int hwthread_halt_thread(struct rtos *rtos, threadid_t thread_id)
+{
+	if (!rtos)
+		return ERROR_FAIL;
+
+	struct target *curr = hwthread_find_thread(rtos->target, thread_id);
+	if (!curr)
+		return ERROR_FAIL;
+
+	return target_halt(curr);
+}
+
+static int hwthread_resume_thread(struct rtos *rtos, threadid_t thread_id, bool step)
+{
+	if (!rtos)
+		return ERROR_FAIL;
+
+	struct target *curr = hwthread_find_thread(rtos->target, thread_id);
+	if (!curr)
+		return ERROR_FAIL;
+
+	if (step)
+		return target_step(curr, 1, 0, 0);
+	return target_resume(curr, 1, 0, 0, 0);
+}
+
+static threadid_t hwthread_target_threadid(struct rtos *rtos, struct target *target)
+{
+	if (!rtos)
+		return 0;
+
+	threadid_t tid = threadid_from_target(target);
+	if (hwthread_find_thread(rtos->target, tid) != target)
+		return 0;
+	return tid;
+}
@@ -242,11 +242,23 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 	int rtos_detected = 0;
 	uint64_t addr = 0;
 	size_t reply_len;
-	char reply[GDB_BUFFER_SIZE + 1], cur_sym[GDB_BUFFER_SIZE / 2 + 1] = ""; /* Extra byte for null-termination */
 	struct symbol_table_elem *next_sym;
 	struct target *target = get_target_from_connection(connection);
 	struct rtos *os = target->rtos;
 
+	/* GDB_BUFFER_SIZE is too large to keep these on the stack.
+	 * Extra byte for null-termination */
+	const size_t reply_size = GDB_BUFFER_SIZE + 1;
+	char *reply = malloc(reply_size);
+	char *cur_sym = calloc(1, GDB_BUFFER_SIZE / 2 + 1);
+	if (!reply || !cur_sym) {
+		LOG_ERROR("Out of memory");
+		free(reply);
+		free(cur_sym);
+		gdb_put_packet(connection, "E01", 3);
+		return 0;
+	}
+
 	reply_len = sprintf(reply, "OK");
 
 	if (!os)
@@ -304,20 +316,22 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 		}
 	}
 
-	if (8 + (strlen(next_sym->symbol_name) * 2) + 1 > sizeof(reply)) {
+	if (8 + (strlen(next_sym->symbol_name) * 2) + 1 > reply_size) {
 		LOG_ERROR("ERROR: RTOS symbol '%s' name is too long for GDB!", next_sym->symbol_name);
 		goto done;
 	}
 
 	LOG_DEBUG("RTOS: Requesting symbol lookup of '%s' from the debugger", next_sym->symbol_name);
 
-	reply_len = snprintf(reply, sizeof(reply), "qSymbol:");
+	reply_len = snprintf(reply, reply_size, "qSymbol:");
 	reply_len += hexify(reply + reply_len,
 		(const uint8_t *)next_sym->symbol_name, strlen(next_sym->symbol_name),
-		sizeof(reply) - reply_len);
+		reply_size - reply_len);
 
 done:
 	gdb_put_packet(connection, reply, reply_len);
+	free(reply);
+	free(cur_sym);
 	return rtos_detected;
 }
 
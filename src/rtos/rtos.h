@@ -110,6 +110,13 @@ struct rtos_type {
 	 * breakpoint_add() use a different target. */
 	struct target * (*swbp_target)(struct rtos *rtos, target_addr_t address,
 				     uint32_t length, enum breakpoint_type type);
+	/* Implement these to support GDB non-stop mode, where a single thread is
+	 * halted, resumed or stepped while the others keep running. Only makes
+	 * sense if every thread runs on its own core. */
+	int (*halt_thread)(struct rtos *rtos, threadid_t thread_id);
+	int (*resume_thread)(struct rtos *rtos, threadid_t thread_id, bool step);
+	/* Return the thread that runs on target, or 0 if there is none. */
+	threadid_t (*target_threadid)(struct rtos *rtos, struct target *target);
 };
 
 struct stack_register_offset {
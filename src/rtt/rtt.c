@@ -53,7 +53,12 @@ static struct {
 	struct rtt_sink_list **sink_list;
 	size_t sink_list_length;
 
+	/** Polling interval while the up-channels are idle. */
 	unsigned int polling_interval;
+	/** Polling interval while data arrives on the up-channels. */
+	unsigned int min_polling_interval;
+	/** Interval until the next poll. */
+	unsigned int current_interval;
 } rtt;
 
 int rtt_init(void)
@@ -69,6 +74,7 @@ int rtt_init(void)
 	rtt.started = false;
 
 	rtt.polling_interval = 100;
+	rtt.min_polling_interval = 1;
 
 	return ERROR_OK;
 }
@@ -80,19 +86,39 @@ int rtt_exit(void)
 	return ERROR_OK;
 }
 
+static int read_channel_callback(void *user_data);
+
+static void schedule_read_channel(unsigned int interval)
+{
+	rtt.current_interval = interval;
+	target_register_timer_callback(&read_channel_callback, interval,
+		TARGET_TIMER_TYPE_ONESHOT, NULL);
+}
+
 static int read_channel_callback(void *user_data)
 {
 	int ret;
+	size_t length = 0;
 
 	ret = rtt.source.read(rtt.target, &rtt.ctrl, rtt.sink_list,
-		rtt.sink_list_length, NULL);
+		rtt.sink_list_length, &length, NULL);
 
 	if (ret != ERROR_OK) {
-		target_unregister_timer_callback(&read_channel_callback, NULL);
 		rtt.source.stop(rtt.target, NULL);
 		return ret;
 	}
 
+	/*
+	 * Poll faster while data arrives, so the target buffers do not overrun,
+	 * and back off while the channels are idle to save probe bandwidth.
+	 */
+	if (length)
+		schedule_read_channel(MAX(rtt.current_interval / 2,
+			rtt.min_polling_interval));
+	else
+		schedule_read_channel(MIN(rtt.current_interval * 2,
+			rtt.polling_interval));
+
 	return ERROR_OK;
 }
 
@@ -166,8 +192,7 @@ int rtt_start(void)
 	if (ret != ERROR_OK)
 		return ret;
 
-	target_register_timer_callback(&read_channel_callback,
-		rtt.polling_interval, 1, NULL);
+	schedule_read_channel(rtt.polling_interval);
 	rtt.started = true;
 
 	return ERROR_OK;
@@ -285,10 +310,9 @@ int rtt_set_polling_interval(unsigned int interval)
 	if (!interval)
 		return ERROR_FAIL;
 
-	if (rtt.polling_interval != interval) {
+	if (rtt.polling_interval != interval && rtt.started) {
 		target_unregister_timer_callback(&read_channel_callback, NULL);
-		target_register_timer_callback(&read_channel_callback, interval, 1,
-			NULL);
+		schedule_read_channel(MAX(interval, rtt.min_polling_interval));
 	}
 
 	rtt.polling_interval = interval;
@@ -296,6 +320,26 @@ int rtt_set_polling_interval(unsigned int interval)
 	return ERROR_OK;
 }
 
+int rtt_get_min_polling_interval(unsigned int *interval)
+{
+	if (!interval)
+		return ERROR_FAIL;
+
+	*interval = rtt.min_polling_interval;
+
+	return ERROR_OK;
+}
+
+int rtt_set_min_polling_interval(unsigned int interval)
+{
+	if (!interval)
+		return ERROR_FAIL;
+
+	rtt.min_polling_interval = interval;
+
+	return ERROR_OK;
+}
+
 int rtt_write_channel(unsigned int channel_index, const uint8_t *buffer,
 		size_t *length)
 {
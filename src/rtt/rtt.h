@@ -121,7 +121,7 @@ typedef int (*rtt_source_start)(struct target *target,
 typedef int (*rtt_source_stop)(struct target *target, void *user_data);
 typedef int (*rtt_source_read)(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data);
+		size_t num_channels, size_t *length, void *user_data);
 typedef int (*rtt_source_write)(struct target *target,
 		struct rtt_control *ctrl, unsigned int channel,
 		const uint8_t *buffer, size_t *length, void *user_data);
@@ -205,6 +205,28 @@ int rtt_get_polling_interval(unsigned int *interval);
  */
 int rtt_set_polling_interval(unsigned int interval);
 
+/**
+ * Get the minimal polling interval.
+ *
+ * @param[out] interval Minimal polling interval in milliseconds.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_get_min_polling_interval(unsigned int *interval);
+
+/**
+ * Set the minimal polling interval.
+ *
+ * While data arrives on the up-channels, the polling interval is reduced
+ * down to this value. It goes back up to the polling interval while the
+ * channels are idle.
+ *
+ * @param[in] interval Minimal polling interval in milliseconds.
+ *
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_set_min_polling_interval(unsigned int interval);
+
 /**
  * Get whether RTT is started.
  *
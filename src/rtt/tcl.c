@@ -108,6 +108,38 @@ COMMAND_HANDLER(handle_rtt_polling_interval_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_rtt_min_polling_interval_command)
+{
+	if (CMD_ARGC == 0) {
+		int ret;
+		unsigned int interval;
+
+		ret = rtt_get_min_polling_interval(&interval);
+
+		if (ret != ERROR_OK) {
+			command_print(CMD, "Failed to get minimal polling interval");
+			return ret;
+		}
+
+		command_print(CMD, "%u ms", interval);
+	} else if (CMD_ARGC == 1) {
+		int ret;
+		unsigned int interval;
+
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], interval);
+		ret = rtt_set_min_polling_interval(interval);
+
+		if (ret != ERROR_OK) {
+			command_print(CMD, "Failed to set minimal polling interval");
+			return ret;
+		}
+	} else {
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_rtt_channels_command)
 {
 	int ret;
@@ -286,6 +318,14 @@ static const struct command_registration rtt_subcommand_handlers[] = {
 		.help = "show or set polling interval in ms",
 		.usage = "[interval]"
 	},
+	{
+		.name = "min_polling_interval",
+		.handler = handle_rtt_min_polling_interval_command,
+		.mode = COMMAND_EXEC,
+		.help = "show or set the polling interval in ms used while data "
+			"is flowing",
+		.usage = "[interval]"
+	},
 	{
 		.name = "channels",
 		.handler = handle_rtt_channels_command,
@@ -51,6 +51,7 @@
 #include <jtag/jtag.h>
 #include "rtos/rtos.h"
 #include "target/smp.h"
+#include "helper/time_support.h"
 
 /**
  * @file
@@ -68,6 +69,11 @@ enum gdb_output_flag {
 	GDB_OUTPUT_ALL,
 };
 
+struct gdb_vflash_range {
+	target_addr_t addr;
+	target_addr_t length;
+};
+
 struct target_desc_format {
 	char *tdesc;
 	uint32_t tdesc_length;
@@ -106,12 +112,48 @@ struct gdb_connection {
 	char *thread_list;
 	/* flag to mask the output from gdb_log_callback() */
 	enum gdb_output_flag output_flag;
+	/* set when GDB switched to non-stop mode with QNonStop:1 */
+	bool non_stop;
+	/* In non-stop mode, the targets whose stop GDB didn't acknowledge with
+	 * vStopped yet. The first one has already been reported if
+	 * stop_notified is set. */
+	struct target **stopped;
+	unsigned int stopped_count;
+	bool stop_notified;
+	/* Consecutive binary memory writes that haven't been sent to the target
+	 * yet. They are written as one block when a write isn't contiguous, when
+	 * any other packet arrives or when GDB has been quiet for a while. */
+	uint8_t *write_buffer;
+	uint64_t write_address;
+	uint32_t write_len;
+	int64_t write_time;
+	/* Streamed vFlash programming, see gdb_vflash_flush(): the erases GDB
+	 * asked for that weren't done yet, the address below which everything
+	 * has been programmed, and the first error, reported at vFlashDone. */
+	struct gdb_vflash_range *vflash_erase;
+	unsigned int vflash_erase_count;
+	target_addr_t vflash_flushed;
+	bool vflash_erase_started;
+	bool vflash_write_started;
+	int vflash_error;
+	uint32_t vflash_written;
 };
 
 #if 0
 #define _DEBUG_GDB_IO_
 #endif
 
+/* Don't start programming flash before this much vFlashWrite data is
+ * complete, to keep the overhead of starting the flash loader low. */
+#define GDB_VFLASH_STREAM_CHUNK (16 * 1024)
+
+/* Largest block of coalesced binary memory writes. */
+#define GDB_WRITE_COALESCE_SIZE (256 * 1024)
+/* Write coalesced data to the target once GDB has been quiet this long. */
+#define GDB_WRITE_COALESCE_MS 10
+/* Shorter replies aren't worth run-length encoding. */
+#define GDB_RLE_MIN_LEN 16
+
 static struct gdb_connection *current_gdb_connection;
 
 static int gdb_breakpoint_override;
@@ -136,6 +178,12 @@ int gdb_actual_connections;
 static int gdb_use_memory_map = 1;
 /* enabled by default*/
 static int gdb_flash_program = 1;
+/* Program flash while GDB is still sending vFlashWrite packets. Enabled by
+ * default. */
+static int gdb_flash_stream = 1;
+/* Only erase and program the sectors whose CRC on the target differs from
+ * what GDB sends. Needs gdb_flash_stream. Disabled by default. */
+static int gdb_flash_delta;
 
 /* if set, data aborts cause an error to be reported in memory read packets
  * see the code in gdb_read_memory_packet() for further explanations.
@@ -146,6 +194,10 @@ static int gdb_report_data_abort;
  * default. */
 static int gdb_report_register_access_error;
 
+/* If set, replies are run-length encoded as described in the GDB remote
+ * protocol. Disabled by default. */
+static int gdb_compress_replies;
+
 /* set if we are sending target descriptions to gdb
  * via qXfer:features:read packet */
 /* enabled by default */
@@ -541,12 +593,55 @@ static int gdb_put_packet_inner(struct connection *connection,
 	return ERROR_OK;
 }
 
+/* Replace runs of at least 4 identical characters with "c*n", where n is the
+ * repeat count plus 29. The result is never longer than the input. */
+static int gdb_rle_encode(char *out, const char *in, int len)
+{
+	int out_len = 0;
+
+	for (int i = 0; i < len; ) {
+		char c = in[i];
+		int run = 1;
+		while (i + run < len && in[i + run] == c && run < 98)
+			run++;
+
+		out[out_len++] = c;
+		int repeat = run - 1;
+		if (c == '*' || repeat < 3) {
+			/* not worth it, or would look like an encoded run */
+			for (int j = 1; j < run; j++)
+				out[out_len++] = c;
+			i += run;
+			continue;
+		}
+		/* '#' and '$' can't be used as repeat count */
+		if (repeat == 6 || repeat == 7)
+			repeat = 5;
+		out[out_len++] = '*';
+		out[out_len++] = repeat + 29;
+		i += repeat + 1;
+	}
+
+	return out_len;
+}
+
 int gdb_put_packet(struct connection *connection, char *buffer, int len)
 {
 	struct gdb_connection *gdb_con = connection->priv;
+	char *rle_buffer = NULL;
+
+	if (gdb_compress_replies && len >= GDB_RLE_MIN_LEN) {
+		rle_buffer = malloc(len);
+		if (rle_buffer) {
+			len = gdb_rle_encode(rle_buffer, buffer, len);
+			buffer = rle_buffer;
+		}
+	}
+
 	gdb_con->busy = true;
 	int retval = gdb_put_packet_inner(connection, buffer, len);
 	gdb_con->busy = false;
+	free(rle_buffer);
 
 	/* we sent some data, reset timer for keep alive messages */
 	kept_alive();
@@ -788,6 +883,35 @@ static int gdb_output(struct command_context *context, const char *line)
 	return ERROR_OK;
 }
 
+static void gdb_stop_reason(struct target *ct, char *stop_reason, size_t size)
+{
+	stop_reason[0] = '\0';
+	if (ct->debug_reason == DBG_REASON_WATCHPOINT) {
+		enum watchpoint_rw hit_wp_type;
+		target_addr_t hit_wp_address;
+
+		if (watchpoint_hit(ct, &hit_wp_type, &hit_wp_address) == ERROR_OK) {
+
+			switch (hit_wp_type) {
+				case WPT_WRITE:
+					snprintf(stop_reason, size,
+							"watch:%08" TARGET_PRIxADDR ";", hit_wp_address);
+					break;
+				case WPT_READ:
+					snprintf(stop_reason, size,
+							"rwatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
+					break;
+				case WPT_ACCESS:
+					snprintf(stop_reason, size,
+							"awatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
 static void gdb_signal_reply(struct target *target, struct connection *connection)
 {
 	struct gdb_connection *gdb_connection = connection->priv;
@@ -818,31 +942,7 @@ static void gdb_signal_reply(struct target *target, struct connection *connectio
 		} else
 			signal_var = gdb_last_signal(ct);
 
-		stop_reason[0] = '\0';
-		if (ct->debug_reason == DBG_REASON_WATCHPOINT) {
-			enum watchpoint_rw hit_wp_type;
-			target_addr_t hit_wp_address;
-
-			if (watchpoint_hit(ct, &hit_wp_type, &hit_wp_address) == ERROR_OK) {
-
-				switch (hit_wp_type) {
-					case WPT_WRITE:
-						snprintf(stop_reason, sizeof(stop_reason),
-								"watch:%08" TARGET_PRIxADDR ";", hit_wp_address);
-						break;
-					case WPT_READ:
-						snprintf(stop_reason, sizeof(stop_reason),
-								"rwatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
-						break;
-					case WPT_ACCESS:
-						snprintf(stop_reason, sizeof(stop_reason),
-								"awatch:%08" TARGET_PRIxADDR ";", hit_wp_address);
-						break;
-					default:
-						break;
-				}
-			}
-		}
+		gdb_stop_reason(ct, stop_reason, sizeof(stop_reason));
 
 		current_thread[0] = '\0';
 		if (rtos)
@@ -947,6 +1047,156 @@ static void gdb_fileio_reply(struct target *target, struct connection *connectio
 	}
 }
 
+/* Send an asynchronous notification. GDB doesn't acknowledge those, not even
+ * when acks are enabled. */
+static int gdb_put_notification(struct connection *connection, char *buffer, int len)
+{
+	char local_buffer[128];
+	unsigned char my_checksum = 0;
+
+	if ((size_t)len + 4 > sizeof(local_buffer))
+		return ERROR_FAIL;
+
+	for (int i = 0; i < len; i++)
+		my_checksum += buffer[i];
+
+	local_buffer[0] = '%';
+	memcpy(local_buffer + 1, buffer, len);
+	snprintf(local_buffer + 1 + len, sizeof(local_buffer) - 1 - len, "#%02x", my_checksum);
+
+	LOG_TARGET_DEBUG(get_target_from_connection(connection),
+			"sending notification: %s", local_buffer);
+	return gdb_write(connection, local_buffer, len + 4);
+}
+
+/* Is target one of the threads this connection debugs? */
+static bool gdb_connection_has_target(struct connection *connection, struct target *target)
+{
+	struct target *gdb_target = get_target_from_connection(connection);
+	struct target_list *head;
+
+	if (target == gdb_target)
+		return true;
+	if (!gdb_target->smp)
+		return false;
+	foreach_smp_target(head, gdb_target->smp_targets)
+		if (head->target == target)
+			return true;
+	return false;
+}
+
+static bool gdb_non_stop_supported(struct target *target)
+{
+	return target->type->set_non_stop && target->rtos &&
+		target->rtos->type->halt_thread && target->rtos->type->resume_thread &&
+		target->rtos->type->target_threadid;
+}
+
+static int gdb_set_non_stop(struct connection *connection, bool non_stop)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	struct target *target = get_target_from_connection(connection);
+	int retval = ERROR_OK;
+
+	if (gdb_con->non_stop == non_stop)
+		return ERROR_OK;
+	if (non_stop && !gdb_non_stop_supported(target))
+		return ERROR_NOT_IMPLEMENTED;
+
+	if (target->smp) {
+		struct target_list *head;
+		foreach_smp_target(head, target->smp_targets)
+			if (target_set_non_stop(head->target, non_stop) != ERROR_OK)
+				retval = ERROR_FAIL;
+	} else {
+		retval = target_set_non_stop(target, non_stop);
+	}
+
+	gdb_con->non_stop = non_stop;
+	gdb_con->stopped_count = 0;
+	gdb_con->stop_notified = false;
+	return retval;
+}
+
+/* Format the stop reply for ct, which in non-stop mode always names the
+ * thread. */
+static int gdb_non_stop_reply(struct connection *connection, struct target *ct,
+		char *buffer, size_t size)
+{
+	struct target *target = get_target_from_connection(connection);
+	char stop_reason[32];
+
+	/* A thread stopped by vCont;t reports signal 0. */
+	int signal_var = ct->debug_reason == DBG_REASON_DBGRQ ? 0 : gdb_last_signal(ct);
+	gdb_stop_reason(ct, stop_reason, sizeof(stop_reason));
+
+	return snprintf(buffer, size, "T%2.2x%sthread:%" PRIx64 ";", signal_var,
+			stop_reason, target->rtos->type->target_threadid(target->rtos, ct));
+}
+
+/* Send the first pending stop as a %Stop notification, unless GDB is still
+ * busy fetching the previous ones with vStopped. */
+static void gdb_non_stop_notify(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	char reply[96];
+
+	if (gdb_con->stop_notified || gdb_con->stopped_count == 0)
+		return;
+
+	int len = snprintf(reply, sizeof(reply), "Stop:");
+	len += gdb_non_stop_reply(connection, gdb_con->stopped[0], reply + len,
+			sizeof(reply) - len);
+	if (gdb_put_notification(connection, reply, len) == ERROR_OK)
+		gdb_con->stop_notified = true;
+}
+
+static void gdb_non_stop_halted(struct target *target, struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (target->state != TARGET_HALTED)
+		return;
+
+	for (unsigned int i = 0; i < gdb_con->stopped_count; i++)
+		if (gdb_con->stopped[i] == target)
+			return;
+
+	struct target **stopped = realloc(gdb_con->stopped,
+			(gdb_con->stopped_count + 1) * sizeof(*stopped));
+	if (!stopped) {
+		LOG_ERROR("Out of memory, can't report %s halting to GDB", target_name(target));
+		return;
+	}
+	gdb_con->stopped = stopped;
+	gdb_con->stopped[gdb_con->stopped_count++] = target;
+
+	gdb_non_stop_notify(connection);
+}
+
+/* GDB acknowledged the stop it was told about last. Tell it about the next
+ * one, if any. */
+static void gdb_non_stop_vstopped(struct connection *connection)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	char reply[96];
+
+	if (gdb_con->stopped_count > 0) {
+		gdb_con->stopped_count--;
+		memmove(gdb_con->stopped, gdb_con->stopped + 1,
+				gdb_con->stopped_count * sizeof(*gdb_con->stopped));
+	}
+
+	if (gdb_con->stopped_count == 0) {
+		gdb_con->stop_notified = false;
+		gdb_put_packet(connection, "OK", 2);
+		return;
+	}
+
+	int len = gdb_non_stop_reply(connection, gdb_con->stopped[0], reply, sizeof(reply));
+	gdb_put_packet(connection, reply, len);
+}
+
 static void gdb_frontend_halted(struct target *target, struct connection *connection)
 {
 	struct gdb_connection *gdb_connection = connection->priv;
@@ -972,11 +1222,114 @@ static void gdb_frontend_halted(struct target *target, struct connection *connec
 	}
 }
 
+static int gdb_write_coalesce_callback(void *priv);
+
+/* Write the coalesced binary memory writes to the target. A failure is
+ * reported to GDB with the next memory write packet. */
+static int gdb_flush_memory_writes(struct connection *connection)
+{
+	struct target *target = get_target_from_connection(connection);
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (gdb_con->write_len == 0)
+		return ERROR_OK;
+
+	/* the timer is armed for as long as data is pending */
+	target_unregister_timer_callback(gdb_write_coalesce_callback, connection);
+
+	/* clear it first, so a nested call doesn't write the data again */
+	uint32_t len = gdb_con->write_len;
+	gdb_con->write_len = 0;
+
+	LOG_DEBUG("addr: 0x%" PRIx64 ", len: 0x%8.8" PRIx32 " (coalesced)",
+			gdb_con->write_address, len);
+
+	int retval = ERROR_NOT_IMPLEMENTED;
+	if (target->rtos)
+		retval = rtos_write_buffer(target, gdb_con->write_address, len,
+				gdb_con->write_buffer);
+	if (retval == ERROR_NOT_IMPLEMENTED)
+		retval = target_write_buffer(target, gdb_con->write_address, len,
+				gdb_con->write_buffer);
+
+	if (retval != ERROR_OK)
+		gdb_con->mem_write_error = true;
+
+	return retval;
+}
+
+/* Append a binary memory write to the pending block, flushing the block
+ * first if the write doesn't continue it. */
+static int gdb_coalesce_memory_write(struct connection *connection,
+		uint64_t addr, uint32_t len, const uint8_t *data)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	int retval;
+
+	if (gdb_con->write_len > 0 &&
+			(addr != gdb_con->write_address + gdb_con->write_len ||
+			 gdb_con->write_len + len > GDB_WRITE_COALESCE_SIZE)) {
+		retval = gdb_flush_memory_writes(connection);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (!gdb_con->write_buffer) {
+		gdb_con->write_buffer = malloc(GDB_WRITE_COALESCE_SIZE);
+		if (!gdb_con->write_buffer) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	if (gdb_con->write_len == 0) {
+		gdb_con->write_address = addr;
+		target_register_timer_callback(gdb_write_coalesce_callback,
+				GDB_WRITE_COALESCE_MS, TARGET_TIMER_TYPE_ONESHOT, connection);
+	}
+	memcpy(gdb_con->write_buffer + gdb_con->write_len, data, len);
+	gdb_con->write_len += len;
+	gdb_con->write_time = timeval_ms();
+
+	if (gdb_con->write_len == GDB_WRITE_COALESCE_SIZE)
+		return gdb_flush_memory_writes(connection);
+
+	return ERROR_OK;
+}
+
+static int gdb_write_coalesce_callback(void *priv)
+{
+	struct connection *connection = priv;
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (gdb_con->write_len == 0)
+		return ERROR_OK;
+
+	int64_t quiet = timeval_ms() - gdb_con->write_time;
+	if (!gdb_con->busy && quiet >= GDB_WRITE_COALESCE_MS)
+		return gdb_flush_memory_writes(connection);
+
+	/* GDB is still sending, check again once it may have gone quiet */
+	unsigned int delay = GDB_WRITE_COALESCE_MS;
+	if (!gdb_con->busy && quiet >= 0)
+		delay -= quiet;
+	return target_register_timer_callback(gdb_write_coalesce_callback, delay,
+			TARGET_TIMER_TYPE_ONESHOT, connection);
+}
+
 static int gdb_target_callback_event_handler(struct target *target,
 		enum target_event event, void *priv)
 {
 	struct connection *connection = priv;
 	struct gdb_service *gdb_service = connection->service->priv;
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (gdb_con->non_stop && event == TARGET_EVENT_GDB_HALT) {
+		/* Every thread reports its own stops. */
+		if (gdb_connection_has_target(connection, target))
+			gdb_non_stop_halted(target, connection);
+		return ERROR_OK;
+	}
 
 	if (gdb_service->target != target)
 		return ERROR_OK;
@@ -1023,6 +1376,19 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->target_desc.tdesc_length = 0;
 	gdb_connection->thread_list = NULL;
 	gdb_connection->output_flag = GDB_OUTPUT_NO;
+	gdb_connection->non_stop = false;
+	gdb_connection->stopped = NULL;
+	gdb_connection->stopped_count = 0;
+	gdb_connection->stop_notified = false;
+	gdb_connection->write_buffer = NULL;
+	gdb_connection->write_len = 0;
+	gdb_connection->vflash_erase = NULL;
+	gdb_connection->vflash_erase_count = 0;
+	gdb_connection->vflash_flushed = 0;
+	gdb_connection->vflash_erase_started = false;
+	gdb_connection->vflash_write_started = false;
+	gdb_connection->vflash_error = ERROR_OK;
+	gdb_connection->vflash_written = 0;
 
 	/* send ACK to GDB for debug request */
 	gdb_write(connection, "+", 1);
@@ -1136,10 +1502,19 @@ static int gdb_connection_closed(struct connection *connection)
 		free(gdb_connection->vflash_image);
 		gdb_connection->vflash_image = NULL;
 	}
+	free(gdb_connection->vflash_erase);
 
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	target_unregister_timer_callback(gdb_write_coalesce_callback, connection);
+	gdb_flush_memory_writes(connection);
+	free(gdb_connection->write_buffer);
+
+	/* leave non-stop mode, so the next session starts out in all-stop */
+	gdb_set_non_stop(connection, false);
+	free(gdb_connection->stopped);
+
 	free(connection->priv);
 	connection->priv = NULL;
 
@@ -1174,6 +1549,31 @@ static int gdb_last_signal_packet(struct connection *connection,
 		return ERROR_OK;
 	}
 
+	if (gdb_con->non_stop) {
+		/* Report every halted thread, the first one here and the others in
+		 * reply to vStopped. */
+		struct target_list *head;
+		gdb_con->stopped_count = 0;
+		gdb_con->stop_notified = true;
+		if (target->smp) {
+			foreach_smp_target(head, target->smp_targets)
+				gdb_non_stop_halted(head->target, connection);
+		} else {
+			gdb_non_stop_halted(target, connection);
+		}
+
+		if (gdb_con->stopped_count == 0) {
+			gdb_con->stop_notified = false;
+			gdb_put_packet(connection, "OK", 2);
+		} else {
+			char reply[96];
+			int len = gdb_non_stop_reply(connection, gdb_con->stopped[0], reply,
+					sizeof(reply));
+			gdb_put_packet(connection, reply, len);
+		}
+		return ERROR_OK;
+	}
+
 	signal_var = gdb_last_signal(target);
 
 	snprintf(sig_reply, 4, "S%2.2x", signal_var);
@@ -1575,6 +1975,88 @@ static int gdb_read_memory_packet(struct connection *connection,
 	return retval;
 }
 
+/* Same as gdb_read_memory_packet(), but replies with escaped binary data
+ * rather than hex, halving the size of the reply. */
+static int gdb_read_memory_binary_packet(struct connection *connection,
+		char const *packet, int packet_size)
+{
+	struct target *target = get_target_from_connection(connection);
+	char *separator;
+	uint64_t addr = 0;
+	uint32_t len = 0;
+
+	uint8_t *buffer;
+	char *bin_buffer;
+
+	int retval;
+
+	/* skip command character */
+	packet++;
+
+	addr = strtoull(packet, &separator, 16);
+
+	if (*separator != ',') {
+		LOG_ERROR("incomplete read memory binary packet received, dropping connection");
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	len = strtoul(separator + 1, NULL, 16);
+
+	if (!len) {
+		gdb_put_packet(connection, "b", 1);
+		return ERROR_OK;
+	}
+
+	buffer = malloc(len);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return gdb_error(connection, ERROR_FAIL);
+	}
+
+	LOG_DEBUG("addr: 0x%16.16" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
+
+	retval = ERROR_NOT_IMPLEMENTED;
+	if (target->rtos)
+		retval = rtos_read_buffer(target, addr, len, buffer);
+	if (retval == ERROR_NOT_IMPLEMENTED)
+		retval = target_read_buffer(target, addr, len, buffer);
+
+	if ((retval != ERROR_OK) && !gdb_report_data_abort) {
+		/* see gdb_read_memory_packet() */
+		memset(buffer, 0, len);
+		retval = ERROR_OK;
+	}
+
+	if (retval == ERROR_OK) {
+		/* worst case every byte needs to be escaped */
+		bin_buffer = malloc(len * 2 + 1);
+		if (bin_buffer) {
+			size_t pkt_len = 0;
+			bin_buffer[pkt_len++] = 'b';
+			for (uint32_t i = 0; i < len; i++) {
+				uint8_t c = buffer[i];
+				if (c == '#' || c == '$' || c == '}' || c == '*') {
+					bin_buffer[pkt_len++] = '}';
+					c ^= 0x20;
+				}
+				bin_buffer[pkt_len++] = c;
+			}
+
+			gdb_put_packet(connection, bin_buffer, pkt_len);
+
+			free(bin_buffer);
+		} else {
+			LOG_ERROR("Out of memory");
+			retval = gdb_error(connection, ERROR_FAIL);
+		}
+	} else
+		retval = gdb_error(connection, retval);
+
+	free(buffer);
+
+	return retval;
+}
+
 static int gdb_write_memory_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -1680,14 +2162,23 @@ static int gdb_write_memory_binary_packet(struct connection *connection,
 			return retval;
 	}
 
-	if (len) {
+	if (len >= fast_limit) {
+		/* Already acknowledged, so collect consecutive writes of a download
+		 * and pass them to the target as one block. */
+		retval = gdb_coalesce_memory_write(connection, addr, len, (uint8_t *)separator);
+		if (retval != ERROR_OK)
+			gdb_connection->mem_write_error = true;
+	} else if (len) {
 		LOG_DEBUG("addr: 0x%" PRIx64 ", len: 0x%8.8" PRIx32 "", addr, len);
 
-		retval = ERROR_NOT_IMPLEMENTED;
-		if (target->rtos)
-			retval = rtos_write_buffer(target, addr, len, (uint8_t *)separator);
-		if (retval == ERROR_NOT_IMPLEMENTED)
-			retval = target_write_buffer(target, addr, len, (uint8_t *)separator);
+		retval = gdb_flush_memory_writes(connection);
+		if (retval == ERROR_OK) {
+			retval = ERROR_NOT_IMPLEMENTED;
+			if (target->rtos)
+				retval = rtos_write_buffer(target, addr, len, (uint8_t *)separator);
+			if (retval == ERROR_NOT_IMPLEMENTED)
+				retval = target_write_buffer(target, addr, len, (uint8_t *)separator);
+		}
 
 		if (retval != ERROR_OK)
 			gdb_connection->mem_write_error = true;
@@ -2890,10 +3381,11 @@ static int gdb_query_packet(struct connection *connection,
 			&buffer,
 			&pos,
 			&size,
-			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+",
+			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;qXfer:threads:read+;QStartNoAckMode+;vContSupported+;binary-upload+%s",
 			GDB_BUFFER_SIZE,
 			((gdb_use_memory_map == 1) && (flash_get_bank_count() > 0)) ? '+' : '-',
-			(gdb_target_desc_supported == 1) ? '+' : '-');
+			(gdb_target_desc_supported == 1) ? '+' : '-',
+			gdb_non_stop_supported(target) ? ";QNonStop+" : "");
 
 		if (retval != ERROR_OK) {
 			gdb_send_error(connection, 01);
@@ -2973,12 +3465,98 @@ static int gdb_query_packet(struct connection *connection,
 		gdb_connection->noack_mode = 1;
 		gdb_put_packet(connection, "OK", 2);
 		return ERROR_OK;
+	} else if (strncmp(packet, "QNonStop:", 9) == 0) {
+		if (gdb_set_non_stop(connection, packet[9] == '1') != ERROR_OK)
+			gdb_send_error(connection, 01);
+		else
+			gdb_put_packet(connection, "OK", 2);
+		return ERROR_OK;
 	}
 
 	gdb_put_packet(connection, "", 0);
 	return ERROR_OK;
 }
 
+/* In non-stop mode every vCont action applies to the threads it names, or to
+ * all threads that no earlier action named. The reply is sent right away, and
+ * the threads report their stops with %Stop notifications. Signals can't be
+ * delivered to a hart, so C and S behave like c and s. */
+static bool gdb_handle_vcont_non_stop(struct connection *connection, const char *packet)
+{
+	struct target *target = get_target_from_connection(connection);
+	struct rtos *rtos = target->rtos;
+	const char *parse = packet;
+
+	rtos_update_threads(target);
+	int thread_count = rtos->thread_count;
+	threadid_t *threads = calloc(thread_count, sizeof(*threads));
+	char *actions = calloc(thread_count, sizeof(*actions));
+	if (!threads || !actions) {
+		free(threads);
+		free(actions);
+		return false;
+	}
+	for (int i = 0; i < thread_count; i++)
+		threads[i] = rtos->thread_details[i].threadid;
+
+	while (parse[0] == ';') {
+		char *endp;
+		char action = parse[1];
+		parse += 2;
+		if (action == 'C' || action == 'S') {
+			strtoul(parse, &endp, 16);
+			parse = endp;
+			action = tolower(action);
+		} else if (action != 'c' && action != 's' && action != 't') {
+			break;
+		}
+
+		int64_t thread_id = -1;
+		if (parse[0] == ':') {
+			thread_id = strtoll(parse + 1, &endp, 16);
+			parse = endp;
+		}
+
+		for (int i = 0; i < thread_count; i++)
+			if (!actions[i] && (thread_id == -1 || thread_id == threads[i]))
+				actions[i] = action;
+	}
+
+	if (parse[0] != '\0') {
+		LOG_ERROR("Unknown vCont packet");
+		free(threads);
+		free(actions);
+		return false;
+	}
+
+	gdb_put_packet(connection, "OK", 2);
+
+	for (int i = 0; i < thread_count; i++) {
+		struct target *ct;
+		if (!actions[i] ||
+				rtos->gdb_target_for_threadid(connection, threads[i], &ct) != ERROR_OK)
+			continue;
+
+		int retval = ERROR_OK;
+		if (actions[i] == 't') {
+			if (ct->state != TARGET_HALTED) {
+				LOG_DEBUG("target %s halt thread %" PRIx64, target_name(ct), threads[i]);
+				retval = rtos->type->halt_thread(rtos, threads[i]);
+			}
+		} else if (ct->state == TARGET_HALTED) {
+			LOG_DEBUG("target %s %s thread %" PRIx64, target_name(ct),
+					actions[i] == 's' ? "step" : "continue", threads[i]);
+			retval = rtos->type->resume_thread(rtos, threads[i], actions[i] == 's');
+		}
+		if (retval != ERROR_OK)
+			LOG_WARNING("vCont;%c failed for thread %" PRIx64, actions[i], threads[i]);
+	}
+
+	free(threads);
+	free(actions);
+	return true;
+}
+
 static bool gdb_handle_vcont_packet(struct connection *connection, const char *packet, int packet_size)
 {
 	struct gdb_connection *gdb_connection = connection->priv;
@@ -2990,12 +3568,18 @@ static bool gdb_handle_vcont_packet(struct connection *connection, const char *p
 	if (parse[0] == '?') {
 		if (target->type->step) {
 			/* gdb doesn't accept c without C and s without S */
-			gdb_put_packet(connection, "vCont;c;C;s;S", 13);
+			if (gdb_non_stop_supported(target))
+				gdb_put_packet(connection, "vCont;c;C;s;S;t", 15);
+			else
+				gdb_put_packet(connection, "vCont;c;C;s;S", 13);
 			return true;
 		}
 		return false;
 	}
 
+	if (gdb_connection->non_stop)
+		return gdb_handle_vcont_non_stop(connection, parse);
+
 	if (parse[0] == ';') {
 		++parse;
 		--packet_size;
@@ -3261,6 +3845,223 @@ static bool gdb_handle_vrun_packet(struct connection *connection, const char *pa
 	return true;
 }
 
+/* Split image at limit, into the sections below and the sections above. */
+static int gdb_vflash_split(struct image *image, target_addr_t limit,
+		struct image *below, struct image *above)
+{
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < image->num_sections && retval == ERROR_OK; i++) {
+		struct imagesection *section = &image->sections[i];
+		uint8_t *data = malloc(section->size);
+		size_t size_read;
+
+		if (!data) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+
+		retval = image_read_section(image, i, 0, section->size, data, &size_read);
+		if (retval == ERROR_OK) {
+			uint32_t split = 0;
+			if (section->base_address < limit)
+				split = MIN(limit - section->base_address, section->size);
+
+			if (split > 0)
+				retval = image_add_section(below, section->base_address, split,
+						section->flags, data);
+			if (retval == ERROR_OK && split < section->size)
+				retval = image_add_section(above, section->base_address + split,
+						section->size - split, section->flags, data + split);
+		}
+
+		free(data);
+	}
+
+	return retval;
+}
+
+static uint32_t gdb_vflash_size_below(struct image *image, target_addr_t limit)
+{
+	uint32_t size = 0;
+
+	for (unsigned int i = 0; i < image->num_sections; i++) {
+		struct imagesection *section = &image->sections[i];
+		if (section->base_address < limit)
+			size += MIN(limit - section->base_address, section->size);
+	}
+
+	return size;
+}
+
+/* Does any section of image overlap [start, end)? */
+static bool gdb_vflash_has_data(struct image *image, target_addr_t start, target_addr_t end)
+{
+	for (unsigned int i = 0; i < image->num_sections; i++) {
+		struct imagesection *section = &image->sections[i];
+		if (section->base_address < end && section->base_address + section->size > start)
+			return true;
+	}
+
+	return false;
+}
+
+/* Erase the sectors of [addr, addr + length) that don't hold any data of
+ * image. flash_write_delta() takes care of the others. */
+static int gdb_vflash_erase_unused(struct target *target, struct image *image,
+		target_addr_t addr, target_addr_t length)
+{
+	while (length > 0) {
+		struct flash_bank *bank;
+		int retval = get_flash_bank_by_addr(target, addr, true, &bank);
+		if (retval != ERROR_OK)
+			return retval;
+
+		unsigned int i;
+		for (i = 0; i < bank->num_sectors; i++)
+			if (addr < bank->base + bank->sectors[i].offset + bank->sectors[i].size)
+				break;
+		if (i == bank->num_sectors)
+			return ERROR_FLASH_DST_OUT_OF_BANK;
+
+		target_addr_t sector_start = bank->base + bank->sectors[i].offset;
+		target_addr_t sector_end = sector_start + bank->sectors[i].size;
+		if (!gdb_vflash_has_data(image, sector_start, sector_end)) {
+			retval = flash_erase_address_range(target, false, sector_start,
+					bank->sectors[i].size);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+
+		target_addr_t step = MIN(sector_end - addr, length);
+		addr += step;
+		length -= step;
+	}
+
+	return ERROR_OK;
+}
+
+/* Erase and program everything GDB asked for below limit, which must be a
+ * sector boundary, and keep the rest for later. GDB sends vFlashWrite packets
+ * in ascending address order and waits for every reply, so replying before
+ * calling this lets the next packet travel while the flash is busy. */
+static int gdb_vflash_flush(struct connection *connection, target_addr_t limit)
+{
+	struct target *target = get_target_from_connection(connection);
+	struct gdb_connection *gdb_con = connection->priv;
+	struct image below;
+	int retval = ERROR_OK;
+
+	if (gdb_con->vflash_error != ERROR_OK)
+		return gdb_con->vflash_error;
+
+	if (!gdb_con->vflash_write_started) {
+		/* Scripts expect erase-end before write-start, even though the
+		 * remaining sectors are only erased as their data is written. */
+		if (gdb_con->vflash_erase_started) {
+			target_call_event_callbacks(target, TARGET_EVENT_GDB_FLASH_ERASE_END);
+			gdb_con->vflash_erase_started = false;
+		}
+		target_call_event_callbacks(target, TARGET_EVENT_GDB_FLASH_WRITE_START);
+		gdb_con->vflash_write_started = true;
+	}
+
+	image_open(&below, "", "build");
+	if (gdb_con->vflash_image) {
+		struct image *above = malloc(sizeof(struct image));
+		if (!above) {
+			LOG_ERROR("Out of memory");
+			image_close(&below);
+			gdb_con->vflash_error = ERROR_FAIL;
+			return ERROR_FAIL;
+		}
+		image_open(above, "", "build");
+		retval = gdb_vflash_split(gdb_con->vflash_image, limit, &below, above);
+
+		image_close(gdb_con->vflash_image);
+		free(gdb_con->vflash_image);
+		gdb_con->vflash_image = above;
+	}
+
+	/* erase what GDB requested below limit, including sectors it doesn't
+	 * write anything to */
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < gdb_con->vflash_erase_count; i++) {
+		struct gdb_vflash_range *range = &gdb_con->vflash_erase[i];
+		if (retval == ERROR_OK && range->addr < limit) {
+			target_addr_t length = MIN(limit - range->addr, range->length);
+			if (gdb_flash_delta)
+				retval = gdb_vflash_erase_unused(target, &below, range->addr, length);
+			else
+				retval = flash_erase_address_range(target, false, range->addr, length);
+			range->addr += length;
+			range->length -= length;
+		}
+		if (range->length > 0)
+			gdb_con->vflash_erase[count++] = *range;
+	}
+	gdb_con->vflash_erase_count = count;
+
+	if (retval == ERROR_OK && below.num_sections > 0) {
+		uint32_t written;
+		if (gdb_flash_delta)
+			retval = flash_write_delta(target, &below, &written, true);
+		else
+			retval = flash_write(target, &below, &written, false);
+		gdb_con->vflash_written += written;
+	}
+	image_close(&below);
+
+	if (retval == ERROR_OK)
+		gdb_con->vflash_flushed = limit;
+	else
+		gdb_con->vflash_error = retval;
+
+	return retval;
+}
+
+/* Program the data received so far once enough of it lies in sectors GDB has
+ * moved past. */
+static void gdb_vflash_stream(struct connection *connection, target_addr_t addr)
+{
+	struct target *target = get_target_from_connection(connection);
+	struct gdb_connection *gdb_con = connection->priv;
+	struct flash_bank *bank;
+
+	if (gdb_con->vflash_error != ERROR_OK ||
+			get_flash_bank_by_addr(target, addr, false, &bank) != ERROR_OK || !bank)
+		return;
+
+	/* everything below the start of the sector GDB is writing now is final */
+	target_addr_t limit = bank->base;
+	for (unsigned int i = 0; i < bank->num_sectors; i++) {
+		if (bank->base + bank->sectors[i].offset > addr)
+			break;
+		limit = bank->base + bank->sectors[i].offset;
+	}
+
+	if (limit > gdb_con->vflash_flushed &&
+			gdb_vflash_size_below(gdb_con->vflash_image, limit) >= GDB_VFLASH_STREAM_CHUNK)
+		gdb_vflash_flush(connection, limit);
+}
+
+static void gdb_vflash_reset(struct gdb_connection *gdb_con)
+{
+	if (gdb_con->vflash_image) {
+		image_close(gdb_con->vflash_image);
+		free(gdb_con->vflash_image);
+		gdb_con->vflash_image = NULL;
+	}
+	free(gdb_con->vflash_erase);
+	gdb_con->vflash_erase = NULL;
+	gdb_con->vflash_erase_count = 0;
+	gdb_con->vflash_flushed = 0;
+	gdb_con->vflash_erase_started = false;
+	gdb_con->vflash_write_started = false;
+	gdb_con->vflash_error = ERROR_OK;
+	gdb_con->vflash_written = 0;
+}
+
 static int gdb_v_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -3287,6 +4088,15 @@ static int gdb_v_packet(struct connection *connection,
 		return ERROR_OK;
 	}
 
+	if (strncmp(packet, "vStopped", 8) == 0) {
+		if (gdb_connection->non_stop)
+			gdb_non_stop_vstopped(connection);
+		else
+			gdb_put_packet(connection, "", 0);
+
+		return ERROR_OK;
+	}
+
 	if (strncmp(packet, "vRun", 4) == 0) {
 		bool handled;
 
@@ -3332,6 +4142,43 @@ static int gdb_v_packet(struct connection *connection,
 		 * when flash_write is called multiple times */
 		flash_set_dirty();
 
+		if (gdb_flash_stream) {
+			/* Only remember the range, it's erased right before the
+			 * data for it is programmed. */
+			struct flash_bank *bank;
+			if (gdb_connection->vflash_write_started) {
+				/* GDB erases everything before writing, so this is a new
+				 * download after an aborted one */
+				LOG_WARNING("Discarding unfinished vFlash download");
+				gdb_vflash_reset(gdb_connection);
+			}
+			if (!gdb_connection->vflash_erase_started) {
+				target_call_event_callbacks(target,
+					TARGET_EVENT_GDB_FLASH_ERASE_START);
+				gdb_connection->vflash_erase_started = true;
+			}
+
+			if (get_flash_bank_by_addr(target, addr, true, &bank) != ERROR_OK) {
+				gdb_send_error(connection, EIO);
+				return ERROR_OK;
+			}
+
+			struct gdb_vflash_range *erase = realloc(gdb_connection->vflash_erase,
+					(gdb_connection->vflash_erase_count + 1) * sizeof(*erase));
+			if (!erase) {
+				LOG_ERROR("Out of memory");
+				gdb_send_error(connection, EIO);
+				return ERROR_OK;
+			}
+			gdb_connection->vflash_erase = erase;
+			erase[gdb_connection->vflash_erase_count].addr = addr;
+			erase[gdb_connection->vflash_erase_count].length = length;
+			gdb_connection->vflash_erase_count++;
+
+			gdb_put_packet(connection, "OK", 2);
+			return ERROR_OK;
+		}
+
 		/* perform any target specific operations before the erase */
 		target_call_event_callbacks(target,
 			TARGET_EVENT_GDB_FLASH_ERASE_START);
@@ -3384,6 +4231,13 @@ static int gdb_v_packet(struct connection *connection,
 			image_open(gdb_connection->vflash_image, "", "build");
 		}
 
+		if (gdb_flash_stream && addr < gdb_connection->vflash_flushed &&
+				gdb_connection->vflash_error == ERROR_OK) {
+			LOG_ERROR("vFlashWrite at " TARGET_ADDR_FMT " is below already programmed "
+					TARGET_ADDR_FMT, addr, gdb_connection->vflash_flushed);
+			gdb_connection->vflash_error = ERROR_FAIL;
+		}
+
 		/* create new section with content from packet buffer */
 		retval = image_add_section(gdb_connection->vflash_image,
 				addr, length, 0x0, (uint8_t const *)parse);
@@ -3392,12 +4246,41 @@ static int gdb_v_packet(struct connection *connection,
 
 		gdb_put_packet(connection, "OK", 2);
 
+		if (gdb_flash_stream)
+			gdb_vflash_stream(connection, addr);
+
 		return ERROR_OK;
 	}
 
 	if (strncmp(packet, "vFlashDone", 10) == 0) {
 		uint32_t written;
 
+		if (gdb_flash_stream) {
+			/* program whatever is left, and erase the rest of the
+			 * requested ranges */
+			result = gdb_vflash_flush(connection, (target_addr_t)-1);
+			if (gdb_connection->vflash_erase_started)
+				target_call_event_callbacks(target,
+						TARGET_EVENT_GDB_FLASH_ERASE_END);
+			if (gdb_connection->vflash_write_started)
+				target_call_event_callbacks(target,
+						TARGET_EVENT_GDB_FLASH_WRITE_END);
+
+			if (result != ERROR_OK) {
+				if (result == ERROR_FLASH_DST_OUT_OF_BANK)
+					gdb_put_packet(connection, "E.memtype", 9);
+				else
+					gdb_send_error(connection, EIO);
+			} else {
+				LOG_DEBUG("wrote %u bytes from vFlash image to flash",
+						(unsigned)gdb_connection->vflash_written);
+				gdb_put_packet(connection, "OK", 2);
+			}
+
+			gdb_vflash_reset(gdb_connection);
+			return ERROR_OK;
+		}
+
 		/* process the flashing buffer. No need to erase as GDB
 		 * always issues a vFlashErase first. */
 		target_call_event_callbacks(target,
@@ -3549,6 +4432,11 @@ static int gdb_input_inner(struct connection *connection)
 
 			gdb_log_incoming_packet(connection, gdb_packet_buffer);
 
+			/* Only binary memory writes may be coalesced, everything else
+			 * has to see the memory as GDB wrote it. */
+			if (packet[0] != 'X')
+				gdb_flush_memory_writes(connection);
+
 			retval = ERROR_OK;
 			switch (packet[0]) {
 				case 'T':	/* Is thread alive? */
@@ -3579,6 +4467,9 @@ static int gdb_input_inner(struct connection *connection)
 				case 'm':
 					retval = gdb_read_memory_packet(connection, packet, packet_size);
 					break;
+				case 'x':
+					retval = gdb_read_memory_binary_packet(connection, packet, packet_size);
+					break;
 				case 'M':
 					retval = gdb_write_memory_packet(connection, packet, packet_size);
 					break;
@@ -3944,6 +4835,28 @@ COMMAND_HANDLER(handle_gdb_flash_program_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_flash_stream_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_flash_stream);
+	if (!gdb_flash_stream && gdb_flash_delta)
+		LOG_WARNING("gdb_flash_delta has no effect without gdb_flash_stream");
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_gdb_flash_delta_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_flash_delta);
+	if (gdb_flash_delta && !gdb_flash_stream)
+		LOG_WARNING("gdb_flash_delta has no effect without gdb_flash_stream");
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_report_data_abort_command)
 {
 	if (CMD_ARGC != 1)
@@ -3953,6 +4866,19 @@ COMMAND_HANDLER(handle_gdb_report_data_abort_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_compress_replies_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_compress_replies);
+
+	command_print(CMD, "gdb reply compression is %s",
+			gdb_compress_replies ? "enabled" : "disabled");
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_gdb_report_register_access_error)
 {
 	if (CMD_ARGC != 1)
@@ -4076,6 +5002,20 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable flash program",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_flash_stream",
+		.handler = handle_gdb_flash_stream_command,
+		.mode = COMMAND_CONFIG,
+		.help = "enable or disable programming flash while gdb sends the data",
+		.usage = "('enable'|'disable')"
+	},
+	{
+		.name = "gdb_flash_delta",
+		.handler = handle_gdb_flash_delta_command,
+		.mode = COMMAND_CONFIG,
+		.help = "enable or disable skipping unchanged flash sectors on gdb load",
+		.usage = "('enable'|'disable')"
+	},
 	{
 		.name = "gdb_report_data_abort",
 		.handler = handle_gdb_report_data_abort_command,
@@ -4083,6 +5023,13 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable reporting data aborts",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_compress_replies",
+		.handler = handle_gdb_compress_replies_command,
+		.mode = COMMAND_ANY,
+		.help = "enable or disable run-length encoding of replies to gdb",
+		.usage = "['enable'|'disable']"
+	},
 	{
 		.name = "gdb_report_register_access_error",
 		.handler = handle_gdb_report_register_access_error,
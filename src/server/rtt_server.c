@@ -31,34 +31,142 @@
  * RTT server.
  *
  * This server allows access to Real Time Transfer (RTT) channels via TCP
- * connections.
+ * connections. Data from a channel goes into a buffer shared by all clients
+ * of the server, and each client is sent data from its own position in it
+ * without blocking, so a slow client neither stalls the others nor OpenOCD.
  */
 
+/* Size of the buffer shared by all clients of an RTT server in bytes. */
+#define RTT_SERVER_BUFFER_SIZE		(64 * 1024)
+
+/* Time between attempts to send pending data to a slow client in ms. */
+#define RTT_SERVER_RETRY_INTERVAL	10
+
 struct rtt_service {
 	unsigned int channel;
+	/** Number of connected clients. */
+	unsigned int num_connections;
+	/** Total number of bytes received from the channel. */
+	uint64_t head;
+	/** The last RTT_SERVER_BUFFER_SIZE bytes received from the channel. */
+	uint8_t buffer[RTT_SERVER_BUFFER_SIZE];
 };
 
-static int read_callback(unsigned int channel, const uint8_t *buffer,
-		size_t length, void *user_data)
+struct rtt_connection {
+	/** Total number of bytes sent to, or lost by, this client. */
+	uint64_t offset;
+	/** Bytes dropped since the client started to lag behind. */
+	uint64_t dropped;
+	/** Whether another attempt to send pending data is scheduled. */
+	bool retry_scheduled;
+};
+
+static int retry_callback(void *user_data);
+
+static bool write_would_block(void)
 {
-	int ret;
-	struct connection *connection;
-	size_t offset;
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/*
+ * Send as much of the shared buffer to the client as the socket accepts
+ * without blocking. Whatever is left is sent later, unless it gets
+ * overwritten by new data first.
+ */
+static int flush_connection(struct connection *connection)
+{
+	struct rtt_service *service = connection->service->priv;
+	struct rtt_connection *client = connection->priv;
+
+	if (service->head - client->offset > RTT_SERVER_BUFFER_SIZE) {
+		uint64_t lost = service->head - RTT_SERVER_BUFFER_SIZE - client->offset;
 
-	connection = (struct connection *)user_data;
-	offset = 0;
+		if (!client->dropped)
+			LOG_WARNING("rtt: Client on port %s lags behind channel %u, "
+				"dropping data", connection->service->port, service->channel);
+
+		client->offset += lost;
+		client->dropped += lost;
+	}
 
-	while (offset < length) {
-		ret = connection_write(connection, buffer + offset, length - offset);
+	while (client->offset < service->head) {
+		size_t start = client->offset % RTT_SERVER_BUFFER_SIZE;
+		size_t length = MIN(service->head - client->offset,
+			RTT_SERVER_BUFFER_SIZE - start);
+		int ret = connection_write(connection, service->buffer + start,
+			length);
 
 		if (ret < 0) {
+			if (write_would_block())
+				break;
+
 			LOG_ERROR("Failed to write data to socket.");
 			return ERROR_FAIL;
 		}
 
-		offset += ret;
+		client->offset += ret;
+
+		if ((size_t)ret < length)
+			break;
+	}
+
+	if (client->offset == service->head && client->dropped) {
+		LOG_WARNING("rtt: Client on port %s caught up with channel %u, "
+			"%" PRIu64 " bytes were dropped", connection->service->port,
+			service->channel, client->dropped);
+		client->dropped = 0;
+	}
+
+	if (client->offset < service->head && !client->retry_scheduled) {
+		client->retry_scheduled = true;
+		target_register_timer_callback(&retry_callback,
+			RTT_SERVER_RETRY_INTERVAL, TARGET_TIMER_TYPE_ONESHOT, connection);
+	}
+
+	return ERROR_OK;
+}
+
+static int retry_callback(void *user_data)
+{
+	struct connection *connection = user_data;
+	struct rtt_connection *client = connection->priv;
+
+	client->retry_scheduled = false;
+
+	return flush_connection(connection);
+}
+
+static int read_callback(unsigned int channel, const uint8_t *buffer,
+		size_t length, void *user_data)
+{
+	struct service *s = user_data;
+	struct rtt_service *service = s->priv;
+
+	/* Only the end of the data fits if there is more than the buffer size. */
+	if (length > RTT_SERVER_BUFFER_SIZE) {
+		service->head += length - RTT_SERVER_BUFFER_SIZE;
+		buffer += length - RTT_SERVER_BUFFER_SIZE;
+		length = RTT_SERVER_BUFFER_SIZE;
+	}
+
+	while (length) {
+		size_t start = service->head % RTT_SERVER_BUFFER_SIZE;
+		size_t chunk = MIN(length, RTT_SERVER_BUFFER_SIZE - start);
+
+		memcpy(service->buffer + start, buffer, chunk);
+		service->head += chunk;
+		buffer += chunk;
+		length -= chunk;
 	}
 
+	/* A failing client is closed by the server loop once it notices. */
+	for (struct connection *c = s->connections; c; c = c->next)
+		flush_connection(c);
+
 	return ERROR_OK;
 }
 
@@ -66,15 +174,37 @@ static int rtt_new_connection(struct connection *connection)
 {
 	int ret;
 	struct rtt_service *service;
+	struct rtt_connection *client;
 
 	service = connection->service->priv;
 
 	LOG_DEBUG("rtt: New connection for channel %u", service->channel);
 
-	ret = rtt_register_sink(service->channel, &read_callback, connection);
+	client = calloc(1, sizeof(struct rtt_connection));
+
+	if (!client)
+		return ERROR_FAIL;
+
+	/* Do not let a slow client stall the server loop. */
+	if (connection->service->type == CONNECTION_TCP)
+		socket_nonblock(connection->fd_out);
 
-	if (ret != ERROR_OK)
-		return ret;
+	client->offset = service->head;
+	connection->priv = client;
+
+	/* All clients share a single sink that fills the buffer. */
+	if (!service->num_connections) {
+		ret = rtt_register_sink(service->channel, &read_callback,
+			connection->service);
+
+		if (ret != ERROR_OK) {
+			free(client);
+			connection->priv = NULL;
+			return ret;
+		}
+	}
+
+	service->num_connections++;
 
 	return ERROR_OK;
 }
@@ -82,9 +212,23 @@ static int rtt_new_connection(struct connection *connection)
 static int rtt_connection_closed(struct connection *connection)
 {
 	struct rtt_service *service;
+	struct rtt_connection *client;
 
 	service = (struct rtt_service *)connection->service->priv;
-	rtt_unregister_sink(service->channel, &read_callback, connection);
+	client = connection->priv;
+
+	if (!client)
+		return ERROR_OK;
+
+	if (client->retry_scheduled)
+		target_unregister_timer_callback(&retry_callback, connection);
+
+	free(client);
+	connection->priv = NULL;
+
+	if (!--service->num_connections)
+		rtt_unregister_sink(service->channel, &read_callback,
+			connection->service);
 
 	LOG_DEBUG("rtt: Connection for channel %u closed", service->channel);
 
@@ -131,7 +275,7 @@ COMMAND_HANDLER(handle_rtt_start_command)
 	if (CMD_ARGC != 2)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	service = malloc(sizeof(struct rtt_service));
+	service = calloc(1, sizeof(struct rtt_service));
 
 	if (!service)
 		return ERROR_FAIL;
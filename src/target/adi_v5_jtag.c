@@ -291,7 +291,7 @@ static int adi_jtag_dp_scan_cmd_sync(struct adiv5_dap *dap, struct dap_cmd *cmd,
 	if (retval != ERROR_OK)
 		return retval;
 
-	return jtag_execute_queue();
+	return jtag_execute_queue_tagged("adi_v5");
 }
 
 /**
@@ -398,7 +398,7 @@ static int adi_jtag_scan_inout_check_u32(struct adiv5_dap *dap,
 			return retval;
 	}
 
-	return jtag_execute_queue();
+	return jtag_execute_queue_tagged("adi_v5");
 }
 
 static int jtagdp_overrun_check(struct adiv5_dap *dap)
@@ -410,7 +410,7 @@ static int jtagdp_overrun_check(struct adiv5_dap *dap)
 	LIST_HEAD(replay_list);
 
 	/* make sure all queued transactions are complete */
-	retval = jtag_execute_queue();
+	retval = jtag_execute_queue_tagged("adi_v5");
 	if (retval != ERROR_OK)
 		goto done;
 
@@ -689,7 +689,7 @@ static int jtag_send_sequence(struct adiv5_dap *dap, enum swd_special_seq seq)
 		return ERROR_FAIL;
 	}
 	if (retval == ERROR_OK)
-		retval = jtag_execute_queue();
+		retval = jtag_execute_queue_tagged("adi_v5");
 	return retval;
 }
 
@@ -784,7 +784,7 @@ static int jtag_ap_q_abort(struct adiv5_dap *dap, uint8_t *ack)
 	if (retval != ERROR_OK)
 		return retval;
 
-	return jtag_execute_queue();
+	return jtag_execute_queue_tagged("adi_v5");
 }
 
 static int jtag_dp_run(struct adiv5_dap *dap)
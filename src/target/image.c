@@ -34,6 +34,7 @@
 
 #include "image.h"
 #include "target.h"
+#include <helper/crc32.h>
 #include <helper/log.h>
 
 /* convert ELF header field to host endianness */
@@ -1267,31 +1268,13 @@ int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes, uint32_t *c
 	uint32_t crc = 0xffffffff;
 	LOG_DEBUG("Calculating checksum");
 
-	static uint32_t crc32_table[256];
-
-	static bool first_init;
-	if (!first_init) {
-		/* Initialize the CRC table and the decoding table.  */
-		unsigned int i, j, c;
-		for (i = 0; i < 256; i++) {
-			/* as per gdb */
-			for (c = i << 24, j = 8; j > 0; --j)
-				c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
-			crc32_table[i] = c;
-		}
-
-		first_init = true;
-	}
-
 	while (nbytes > 0) {
-		int run = nbytes;
+		uint32_t run = nbytes;
 		if (run > 32768)
 			run = 32768;
 		nbytes -= run;
-		while (run--) {
-			/* as per gdb */
-			crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ *buffer++) & 255];
-		}
+		crc = crc32_update(crc, buffer, run);
+		buffer += run;
 		keep_alive();
 	}
 
@@ -17,14 +17,47 @@
 
 static void dump_field(int idle, const struct scan_field *field);
 
+/* The largest batch freed so far, kept so that the next riscv_batch_alloc()
+ * doesn't have to go to the heap again. Long memory accesses allocate and
+ * free one batch per chunk. */
+static struct riscv_batch *spare_batch;
+
+static void riscv_batch_destroy(struct riscv_batch *batch)
+{
+	if (!batch)
+		return;
+	free(batch->data_in);
+	free(batch->data_out);
+	free(batch->fields);
+	free(batch->bscan_ctxt);
+	free(batch->read_keys);
+	free(batch);
+}
+
 struct riscv_batch *riscv_batch_alloc(struct target *target, size_t scans, size_t idle)
 {
 	scans += 4;
+
+	if (spare_batch && spare_batch->buffer_scans >= scans
+			&& (bscan_tunnel_ir_width == 0 || spare_batch->bscan_ctxt)) {
+		struct riscv_batch *out = spare_batch;
+		spare_batch = NULL;
+		out->target = target;
+		out->allocated_scans = scans;
+		out->used_scans = 0;
+		out->idle_count = idle;
+		out->last_scan = RISCV_SCAN_TYPE_INVALID;
+		out->read_keys_used = 0;
+		out->was_run = false;
+		return out;
+	}
+
 	struct riscv_batch *out = calloc(1, sizeof(*out));
 	if (!out)
 		goto error0;
 	out->target = target;
 	out->allocated_scans = scans;
+	out->buffer_scans = scans;
 	out->idle_count = idle;
 	out->data_out = malloc(sizeof(*out->data_out) * (scans) * DMI_SCAN_BUF_SIZE);
 	if (!out->data_out) {
@@ -72,12 +105,18 @@ error0:
 
 void riscv_batch_free(struct riscv_batch *batch)
 {
-	free(batch->data_in);
-	free(batch->data_out);
-	free(batch->fields);
-	free(batch->bscan_ctxt);
-	free(batch->read_keys);
-	free(batch);
+	if (!spare_batch || spare_batch->buffer_scans < batch->buffer_scans) {
+		riscv_batch_destroy(spare_batch);
+		spare_batch = batch;
+	} else {
+		riscv_batch_destroy(batch);
+	}
+}
+
+void riscv_batch_free_spare(void)
+{
+	riscv_batch_destroy(spare_batch);
+	spare_batch = NULL;
 }
 
 bool riscv_batch_full(struct riscv_batch *batch)
@@ -94,7 +133,14 @@ int riscv_batch_run(struct riscv_batch *batch)
 
 	riscv_batch_add_nop(batch);
 
-	for (size_t i = 0; i < batch->used_scans; ++i) {
+	return riscv_batch_run_from(batch, 0);
+}
+
+int riscv_batch_run_from(struct riscv_batch *batch, size_t start_idx)
+{
+	assert(start_idx < batch->used_scans);
+
+	for (size_t i = start_idx; i < batch->used_scans; ++i) {
 		if (bscan_tunnel_ir_width != 0)
 			riscv_add_bscan_tunneled_scan(batch->target, batch->fields+i, batch->bscan_ctxt+i);
 		else
@@ -106,7 +152,7 @@ int riscv_batch_run(struct riscv_batch *batch)
 
 	keep_alive();
 
-	if (jtag_execute_queue() != ERROR_OK) {
+	if (jtag_execute_queue_tagged("riscv dmi") != ERROR_OK) {
 		LOG_ERROR("Unable to execute JTAG queue");
 		return ERROR_FAIL;
 	}
@@ -115,16 +161,44 @@ int riscv_batch_run(struct riscv_batch *batch)
 
 	if (bscan_tunnel_ir_width != 0) {
 		/* need to right-shift "in" by one bit, because of clock skew between BSCAN TAP and DM TAP */
-		for (size_t i = 0; i < batch->used_scans; ++i)
+		for (size_t i = start_idx; i < batch->used_scans; ++i)
 			buffer_shr((batch->fields + i)->in_value, DMI_SCAN_BUF_SIZE, 1);
 	}
 
-	for (size_t i = 0; i < batch->used_scans; ++i)
+	for (size_t i = start_idx; i < batch->used_scans; ++i)
 		dump_field(batch->idle_count, batch->fields + i);
 
+	batch->was_run = true;
 	return ERROR_OK;
 }
 
+static bool riscv_batch_was_scan_busy(const struct riscv_batch *batch, size_t scan_idx)
+{
+	assert(batch->was_run);
+	assert(scan_idx < batch->used_scans);
+	const uint8_t *base = batch->data_in + DMI_SCAN_BUF_SIZE * scan_idx;
+	return buf_get_u32(base, DTM_DMI_OP_OFFSET, DTM_DMI_OP_LENGTH) == DTM_DMI_OP_BUSY;
+}
+
+bool riscv_batch_was_batch_busy(const struct riscv_batch *batch)
+{
+	assert(batch->used_scans);
+	/* Busy is sticky until dmireset, so the last scan tells for the whole
+	 * batch. */
+	return riscv_batch_was_scan_busy(batch, batch->used_scans - 1);
+}
+
+size_t riscv_batch_finished_scans(const struct riscv_batch *batch)
+{
+	if (!riscv_batch_was_batch_busy(batch))
+		return batch->used_scans;
+
+	size_t first_busy = 0;
+	while (!riscv_batch_was_scan_busy(batch, first_busy))
+		++first_busy;
+	return first_busy;
+}
+
 void riscv_batch_add_dmi_write(struct riscv_batch *batch, unsigned address, uint64_t data)
 {
 	assert(batch->used_scans < batch->allocated_scans);
@@ -23,6 +23,9 @@ struct riscv_batch {
 
 	size_t allocated_scans;
 	size_t used_scans;
+	/* Number of scans the buffers below have room for, which can be more
+	 * than allocated_scans when the batch is recycled. */
+	size_t buffer_scans;
 
 	size_t idle_count;
 
@@ -44,6 +47,10 @@ struct riscv_batch {
 	/* The read keys. */
 	size_t *read_keys;
 	size_t read_keys_used;
+
+	/* Set once the batch has been scanned out at least once, so the data_in
+	 * buffers hold valid results. */
+	bool was_run;
 };
 
 /* Allocates (or frees) a new scan set.  "scans" is the maximum number of JTAG
@@ -51,6 +58,8 @@ struct riscv_batch {
  * cycles between every real scan. */
 struct riscv_batch *riscv_batch_alloc(struct target *target, size_t scans, size_t idle);
 void riscv_batch_free(struct riscv_batch *batch);
+/* Releases the batch riscv_batch_free() keeps around for reuse. */
+void riscv_batch_free_spare(void);
 
 /* Checks to see if this batch is full. */
 bool riscv_batch_full(struct riscv_batch *batch);
@@ -58,6 +67,18 @@ bool riscv_batch_full(struct riscv_batch *batch);
 /* Executes this scan batch. */
 int riscv_batch_run(struct riscv_batch *batch);
 
+/* Re-executes the scans of an already run batch, starting at start_idx.  This
+ * is used to resume a batch at the first scan that came back busy, after the
+ * busy state has been cleared with dmireset. */
+int riscv_batch_run_from(struct riscv_batch *batch, size_t start_idx);
+
+/* Returns true if any scan of the last run came back busy. */
+bool riscv_batch_was_batch_busy(const struct riscv_batch *batch);
+
+/* Returns the index of the first scan that came back busy, or used_scans if
+ * the whole batch completed. */
+size_t riscv_batch_finished_scans(const struct riscv_batch *batch);
+
 /* Adds a DMI write to this batch. */
 void riscv_batch_add_dmi_write(struct riscv_batch *batch, unsigned address, uint64_t data);
 
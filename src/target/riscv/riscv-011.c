@@ -297,7 +297,7 @@ static uint32_t dtmcontrol_scan(struct target *target, uint32_t out)
 	/* Always return to dbus. */
 	jtag_add_ir_scan(target->tap, &select_dbus, TAP_IDLE);
 
-	int retval = jtag_execute_queue();
+	int retval = jtag_execute_queue_tagged("riscv dbus");
 	if (retval != ERROR_OK) {
 		LOG_ERROR("failed jtag scan: %d", retval);
 		return retval;
@@ -321,7 +321,7 @@ static uint32_t idcode_scan(struct target *target)
 	field.in_value = in_value;
 	jtag_add_dr_scan(target->tap, 1, &field, TAP_IDLE);
 
-	int retval = jtag_execute_queue();
+	int retval = jtag_execute_queue_tagged("riscv dbus");
 	if (retval != ERROR_OK) {
 		LOG_ERROR("failed jtag scan: %d", retval);
 		return retval;
@@ -446,7 +446,7 @@ static dbus_status_t dbus_scan(struct target *target, uint16_t *address_in,
 	if (idle_count)
 		jtag_add_runtest(idle_count, TAP_IDLE);
 
-	int retval = jtag_execute_queue();
+	int retval = jtag_execute_queue_tagged("riscv dbus");
 	if (retval != ERROR_OK) {
 		LOG_ERROR("dbus_scan failed jtag scan");
 		return DBUS_STATUS_FAILED;
@@ -576,7 +576,7 @@ static void scans_dump(scans_t *scans)
 
 static int scans_execute(scans_t *scans)
 {
-	int retval = jtag_execute_queue();
+	int retval = jtag_execute_queue_tagged("riscv dbus");
 	if (retval != ERROR_OK) {
 		LOG_ERROR("failed jtag scan: %d", retval);
 		return retval;
@@ -38,6 +38,10 @@ static void riscv013_clear_abstract_error(struct target *target);
 static int riscv013_get_register(struct target *target,
 		riscv_reg_t *value, int rid);
 static int riscv013_set_register(struct target *target, int regid, uint64_t value);
+static int riscv013_get_registers(struct target *target, unsigned int count,
+		const enum gdb_regno *regnos, riscv_reg_t *values, bool *read);
+static int riscv013_set_registers(struct target *target, unsigned int count,
+		const enum gdb_regno *regnos, const riscv_reg_t *values);
 static int riscv013_select_current_hart(struct target *target);
 static int riscv013_halt_prep(struct target *target);
 static int riscv013_halt_go(struct target *target);
@@ -47,6 +51,8 @@ static int riscv013_on_halt(struct target *target);
 static int riscv013_on_step(struct target *target);
 static int riscv013_resume_prep(struct target *target);
 static bool riscv013_is_halted(struct target *target);
+static int riscv013_hart_summary(struct target *target, unsigned int poll_id,
+		enum riscv_hart_summary *summary);
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target);
 static int riscv013_write_debug_buffer(struct target *target, unsigned index,
 		riscv_insn_t d);
@@ -143,6 +149,11 @@ typedef struct {
 	int current_hartid;
 	bool hasel_supported;
 
+	/* Cached result of riscv013_hart_summary(), valid for summary_poll_id. */
+	bool summary_valid;
+	unsigned int summary_poll_id;
+	enum riscv_hart_summary summary;
+
 	/* The program buffer stores executable code. 0 is an illegal instruction,
 	 * so we use 0 to mean the cached value is invalid. */
 	uint32_t progbuf_cache[16];
@@ -197,6 +208,13 @@ typedef struct {
 
 	yes_no_maybe_t has_aampostincrement;
 
+	/* Number of scans in the batches used for block memory reads and system
+	 * bus writes. They grow while batches complete without a busy response
+	 * and shrink when they don't, so a busy scan wastes less of the batch. */
+	unsigned int read_batch_scans, write_batch_scans;
+	/* Number of consecutive batches that completed without a busy response. */
+	unsigned int read_clean_runs, write_clean_runs;
+
 	/* When a function returns some error due to a failure indicated by the
 	 * target in cmderr, the caller can look here to see what that error was.
 	 * (Compare with errno.) */
@@ -434,7 +452,7 @@ static uint32_t dtmcontrol_scan(struct target *target, uint32_t out)
 	/* Always return to dmi. */
 	select_dmi(target);
 
-	int retval = jtag_execute_queue();
+	int retval = jtag_execute_queue_tagged("riscv dmi");
 	if (retval != ERROR_OK) {
 		LOG_ERROR("failed jtag scan: %d", retval);
 		return retval;
@@ -515,7 +533,7 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 	if (idle_count)
 		jtag_add_runtest(idle_count, TAP_IDLE);
 
-	int retval = jtag_execute_queue();
+	int retval = jtag_execute_queue_tagged("riscv dmi");
 	if (retval != ERROR_OK) {
 		LOG_ERROR("dmi_scan failed jtag scan");
 		if (data_in)
@@ -1494,6 +1512,7 @@ static void deinit_target(struct target *target)
 	free(info->version_specific);
 	/* TODO: free register arch_info */
 	info->version_specific = NULL;
+	riscv_batch_free_spare();
 }
 
 typedef enum {
@@ -1515,6 +1534,24 @@ static int set_group(struct target *target, bool *supported, unsigned group, gro
 	return ERROR_OK;
 }
 
+static int riscv013_set_halt_group(struct target *target, bool join)
+{
+	if (!target->smp)
+		return ERROR_OK;
+
+	if (riscv_select_current_hart(target) != ERROR_OK)
+		return ERROR_FAIL;
+
+	bool haltgroup_supported;
+	if (set_group(target, &haltgroup_supported, join ? target->smp : 0,
+				HALTGROUP) != ERROR_OK)
+		return ERROR_FAIL;
+	LOG_DEBUG("[%s] %s halt group %d (%ssupported)", target_name(target),
+			join ? "joined" : "left", target->smp,
+			haltgroup_supported ? "" : "not ");
+	return ERROR_OK;
+}
+
 static int discover_vlenb(struct target *target)
 {
 	RISCV_INFO(r);
@@ -2089,6 +2126,32 @@ static int sb_write_address(struct target *target, target_addr_t address,
 				  false, ensure_success);
 }
 
+/**
+ * Adapt the size of a kind of batch, and the idle count that goes with it, to
+ * how often the target answers busy. A busy scan only costs a resume now, so
+ * after a run of clean batches it is cheap to try going a little faster
+ * again.
+ */
+static void tune_batch(unsigned int *batch_scans, unsigned int *clean_runs,
+		unsigned int *delay, bool busy)
+{
+	if (busy) {
+		*clean_runs = 0;
+		*batch_scans = MAX(*batch_scans / 2, RISCV_BATCH_MIN_SIZE);
+		LOG_DEBUG("busy: batch_scans=%d, delay=%d", *batch_scans, *delay);
+		return;
+	}
+
+	if (++*clean_runs < RISCV_BATCH_TUNE_RUNS)
+		return;
+
+	*clean_runs = 0;
+	*batch_scans = MIN(*batch_scans * 2, RISCV_BATCH_MAX_SIZE);
+	if (*delay > 0)
+		*delay -= *delay / 16 + 1;
+	LOG_DEBUG("clean: batch_scans=%d, delay=%d", *batch_scans, *delay);
+}
+
 static int batch_run(const struct target *target, struct riscv_batch *batch)
 {
 	RISCV013_INFO(info);
@@ -2279,10 +2342,14 @@ static int init_target(struct command_context *cmd_ctx,
 
 	generic_info->get_register = &riscv013_get_register;
 	generic_info->set_register = &riscv013_set_register;
+	generic_info->get_registers = &riscv013_get_registers;
+	generic_info->set_registers = &riscv013_set_registers;
 	generic_info->get_register_buf = &riscv013_get_register_buf;
 	generic_info->set_register_buf = &riscv013_set_register_buf;
 	generic_info->select_current_hart = &riscv013_select_current_hart;
 	generic_info->is_halted = &riscv013_is_halted;
+	generic_info->hart_summary = &riscv013_hart_summary;
+	generic_info->set_halt_group = &riscv013_set_halt_group;
 	generic_info->resume_go = &riscv013_resume_go;
 	generic_info->step_current_hart = &riscv013_step_current_hart;
 	generic_info->on_halt = &riscv013_on_halt;
@@ -2335,6 +2402,9 @@ static int init_target(struct command_context *cmd_ctx,
 
 	info->has_aampostincrement = YNM_MAYBE;
 
+	info->read_batch_scans = RISCV_BATCH_ALLOC_SIZE;
+	info->write_batch_scans = RISCV_BATCH_ALLOC_SIZE;
+
 	return ERROR_OK;
 }
 
@@ -2707,7 +2777,7 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 
 		if (info->bus_master_read_delay) {
 			jtag_add_runtest(info->bus_master_read_delay, TAP_IDLE);
-			if (jtag_execute_queue() != ERROR_OK) {
+			if (jtag_execute_queue_tagged("riscv dmi") != ERROR_OK) {
 				LOG_ERROR("Failed to scan idle sequence");
 				return ERROR_FAIL;
 			}
@@ -2945,6 +3015,244 @@ static bool mem_should_skip_abstract(struct target *target, target_addr_t addres
 	return false;
 }
 
+/*
+ * Find out how far an abstract memory access burst got. arg1 was incremented
+ * once for every command that ran, so this returns the number of elements
+ * that were accessed since arg1 was set to start_address.
+ */
+static int abstract_burst_progress(struct target *target, target_addr_t start_address,
+		uint32_t size, bool *busy, uint32_t *executed)
+{
+	RISCV013_INFO(info);
+
+	/* Reading abstractcs also clears a sticky DMI busy left by the batch. */
+	uint32_t abstractcs;
+	if (wait_for_idle(target, &abstractcs) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (dmi_write(target, DM_ABSTRACTAUTO, 0) != ERROR_OK)
+		return ERROR_FAIL;
+
+	info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+	*busy = false;
+	switch (info->cmderr) {
+		case CMDERR_NONE:
+			break;
+		case CMDERR_BUSY:
+			LOG_DEBUG("abstract memory burst resulted in busy response");
+			increase_ac_busy_delay(target);
+			riscv013_clear_abstract_error(target);
+			*busy = true;
+			break;
+		default:
+			LOG_DEBUG("error during abstract memory burst, abstractcs=0x%08lx", (long)abstractcs);
+			riscv013_clear_abstract_error(target);
+			return ERROR_FAIL;
+	}
+
+	riscv_reg_t next_address = read_abstract_arg(target, 1, riscv_xlen(target));
+	if (next_address < start_address + size) {
+		LOG_ERROR("Unexpected arg1=0x%" PRIx64 " after abstract memory burst from 0x%"
+				TARGET_PRIxADDR ".", next_address, start_address);
+		return ERROR_FAIL;
+	}
+	*executed = (next_address - start_address) / size;
+	return ERROR_OK;
+}
+
+/*
+ * Read memory with abstract commands, letting abstractauto.autoexecdata
+ * trigger the next (postincrementing) access every time data0 is read. A whole
+ * batch of elements then streams out with a single error check at the end.
+ * Only used once aampostincrement is known to work.
+ */
+static int read_memory_abstract_burst(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	RISCV013_INFO(info);
+
+	uint32_t command = access_memory_command(target, false, size << 3, true, false);
+	unsigned int width32 = (size < 4) ? 32 : size << 3;
+	time_t start = time(NULL);
+
+	uint32_t done = 0;
+	while (done < count) {
+		if (time(NULL) - start > riscv_command_timeout_sec) {
+			LOG_ERROR("Timed out after %ds reading memory with abstract commands. "
+					"Increase the timeout with riscv set_command_timeout_sec.",
+					riscv_command_timeout_sec);
+			return ERROR_FAIL;
+		}
+
+		target_addr_t start_address = address + done * size;
+		if (write_abstract_arg(target, 1, start_address, riscv_xlen(target)) != ERROR_OK)
+			return ERROR_FAIL;
+		/* Now arg0 contains element done. */
+		if (execute_abstract_command(target, command) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (count - done == 1) {
+			riscv_reg_t value = read_abstract_arg(target, 0, width32);
+			buf_set_u64(buffer + done * size, 0, 8 * size, value);
+			log_memory_access(start_address, value, size, true);
+			return ERROR_OK;
+		}
+
+		if (dmi_write(target, DM_ABSTRACTAUTO,
+				1 << DM_ABSTRACTAUTO_AUTOEXECDATA_OFFSET) != ERROR_OK)
+			return ERROR_FAIL;
+
+		struct riscv_batch *batch = riscv_batch_alloc(target, info->read_batch_scans,
+				info->dmi_busy_delay + info->ac_busy_delay);
+		if (!batch) {
+			dmi_write(target, DM_ABSTRACTAUTO, 0);
+			return ERROR_FAIL;
+		}
+
+		/* Every read of data0 returns one element and starts reading the next
+		 * one. Never start a read past the end of the block. */
+		uint32_t reads = 0;
+		for (uint32_t j = done; j < count - 1; j++) {
+			if (size > 4)
+				riscv_batch_add_dmi_read(batch, DM_DATA1);
+			riscv_batch_add_dmi_read(batch, DM_DATA0);
+			reads++;
+			if (riscv_batch_full(batch))
+				break;
+		}
+
+		if (batch_run(target, batch) != ERROR_OK) {
+			riscv_batch_free(batch);
+			dmi_write(target, DM_ABSTRACTAUTO, 0);
+			return ERROR_FAIL;
+		}
+		bool dmi_busy = riscv_batch_was_batch_busy(batch);
+
+		bool ac_busy;
+		uint32_t executed;
+		if (abstract_burst_progress(target, start_address, size, &ac_busy,
+					&executed) != ERROR_OK) {
+			riscv_batch_free(batch);
+			return ERROR_FAIL;
+		}
+
+		/* The first executed - 1 elements came out of the batch, unless their
+		 * result was lost to a busy scan. */
+		uint32_t good = 0;
+		unsigned int key = 0;
+		while (good < reads && good + 1 < executed) {
+			if (riscv_batch_get_dmi_read_op(batch, key) != DMI_STATUS_SUCCESS)
+				break;
+			uint64_t value = riscv_batch_get_dmi_read_data(batch, key++);
+			if (size > 4) {
+				if (riscv_batch_get_dmi_read_op(batch, key) != DMI_STATUS_SUCCESS)
+					break;
+				value <<= 32;
+				value |= riscv_batch_get_dmi_read_data(batch, key++);
+			}
+			buf_set_u64(buffer + (done + good) * size, 0, 8 * size, value);
+			log_memory_access(address + (done + good) * size, value, size, true);
+			good++;
+		}
+		riscv_batch_free(batch);
+
+		if (good + 1 == executed) {
+			/* Nothing was lost, and the last element read is still in arg0. */
+			riscv_reg_t value = read_abstract_arg(target, 0, width32);
+			buf_set_u64(buffer + (done + good) * size, 0, 8 * size, value);
+			log_memory_access(address + (done + good) * size, value, size, true);
+			good++;
+		}
+
+		tune_batch(&info->read_batch_scans, &info->read_clean_runs,
+				&info->ac_busy_delay, dmi_busy || ac_busy);
+		done += good;
+	}
+
+	return ERROR_OK;
+}
+
+/*
+ * Write memory with abstract commands, letting abstractauto.autoexecdata
+ * trigger the next (postincrementing) access every time data0 is written.
+ * Only used once aampostincrement is known to work.
+ */
+static int write_memory_abstract_burst(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, const uint8_t *buffer)
+{
+	RISCV013_INFO(info);
+
+	uint32_t command = access_memory_command(target, false, size << 3, true, true);
+	time_t start = time(NULL);
+
+	uint32_t done = 0;
+	while (done < count) {
+		if (time(NULL) - start > riscv_command_timeout_sec) {
+			LOG_ERROR("Timed out after %ds writing memory with abstract commands. "
+					"Increase the timeout with riscv set_command_timeout_sec.",
+					riscv_command_timeout_sec);
+			return ERROR_FAIL;
+		}
+
+		target_addr_t start_address = address + done * size;
+		riscv_reg_t value = buf_get_u64(buffer + done * size, 0, 8 * size);
+		if (write_abstract_arg(target, 0, value, riscv_xlen(target)) != ERROR_OK)
+			return ERROR_FAIL;
+		if (write_abstract_arg(target, 1, start_address, riscv_xlen(target)) != ERROR_OK)
+			return ERROR_FAIL;
+		if (execute_abstract_command(target, command) != ERROR_OK)
+			return ERROR_FAIL;
+		log_memory_access(start_address, value, size, false);
+
+		if (count - done == 1)
+			return ERROR_OK;
+
+		if (dmi_write(target, DM_ABSTRACTAUTO,
+				1 << DM_ABSTRACTAUTO_AUTOEXECDATA_OFFSET) != ERROR_OK)
+			return ERROR_FAIL;
+
+		struct riscv_batch *batch = riscv_batch_alloc(target, info->write_batch_scans,
+				info->dmi_busy_delay + info->ac_busy_delay);
+		if (!batch) {
+			dmi_write(target, DM_ABSTRACTAUTO, 0);
+			return ERROR_FAIL;
+		}
+
+		/* Every write of data0 starts writing that element. */
+		for (uint32_t j = done + 1; j < count; j++) {
+			value = buf_get_u64(buffer + j * size, 0, 8 * size);
+			if (size > 4)
+				riscv_batch_add_dmi_write(batch, DM_DATA1, value >> 32);
+			riscv_batch_add_dmi_write(batch, DM_DATA0, value);
+			log_memory_access(address + j * size, value, size, false);
+			if (riscv_batch_full(batch))
+				break;
+		}
+
+		int result = batch_run(target, batch);
+		bool dmi_busy = result == ERROR_OK && riscv_batch_was_batch_busy(batch);
+		riscv_batch_free(batch);
+		if (result != ERROR_OK) {
+			dmi_write(target, DM_ABSTRACTAUTO, 0);
+			return ERROR_FAIL;
+		}
+
+		/* Every element up to arg1 has been written exactly once; carry on
+		 * from there. */
+		bool ac_busy;
+		uint32_t executed;
+		if (abstract_burst_progress(target, start_address, size, &ac_busy,
+					&executed) != ERROR_OK)
+			return ERROR_FAIL;
+
+		tune_batch(&info->write_batch_scans, &info->write_clean_runs,
+				&info->ac_busy_delay, dmi_busy || ac_busy);
+		done += executed;
+	}
+
+	return ERROR_OK;
+}
+
 /*
  * Performs a memory read using memory access abstract commands. The read sizes
  * supported are 1, 2, and 4 bytes despite the spec's support of 8 and 16 byte
@@ -3019,6 +3327,11 @@ static int read_memory_abstract(struct target *target, target_addr_t address,
 		if (info->has_aampostincrement == YNM_YES)
 			updateaddr = false;
 		p += size;
+
+		/* Once postincrement is known to work, stream the rest. */
+		if (info->has_aampostincrement == YNM_YES && c + 1 < count)
+			return read_memory_abstract_burst(target, address + (c + 1) * size,
+					size, count - c - 1, p);
 	}
 
 	return result;
@@ -3098,39 +3411,152 @@ static int write_memory_abstract(struct target *target, target_addr_t address,
 		if (info->has_aampostincrement == YNM_YES)
 			updateaddr = false;
 		p += size;
+
+		/* Once postincrement is known to work, stream the rest. */
+		if (info->has_aampostincrement == YNM_YES && c + 1 < count)
+			return write_memory_abstract_burst(target, address + (c + 1) * size,
+					size, count - c - 1, p);
 	}
 
 	return result;
 }
 
 /**
- * Read the requested memory, taking care to execute every read exactly once,
- * even if cmderr=busy is encountered.
+ * Point s0 (and the s2 counter if increment is 0) at element index, and
+ * execute the program once. Afterwards s1 holds element index.
  */
-static int read_memory_progbuf_inner(struct target *target, target_addr_t address,
-		uint32_t size, uint32_t count, uint8_t *buffer, uint32_t increment)
+static int read_memory_progbuf_inner_startup(struct target *target,
+		target_addr_t address, uint32_t increment, uint32_t index)
 {
-	RISCV013_INFO(info);
-
-	int result = ERROR_OK;
-
 	/* Write address to S0. */
-	result = register_write_direct(target, GDB_REGNO_S0, address);
-	if (result != ERROR_OK)
-		return result;
+	if (register_write_direct(target, GDB_REGNO_S0,
+				address + index * increment) != ERROR_OK)
+		return ERROR_FAIL;
 
 	if (increment == 0 &&
-			register_write_direct(target, GDB_REGNO_S2, 0) != ERROR_OK)
+			register_write_direct(target, GDB_REGNO_S2, index) != ERROR_OK)
 		return ERROR_FAIL;
 
 	uint32_t command = access_register_command(target, GDB_REGNO_S1,
 			riscv_xlen(target),
 			AC_ACCESS_REGISTER_TRANSFER | AC_ACCESS_REGISTER_POSTEXEC);
-	if (execute_abstract_command(target, command) != ERROR_OK)
+	return execute_abstract_command(target, command);
+}
+
+/**
+ * Fill the read pipeline starting at element index. Afterwards dm_data0
+ * contains element index and s1 element index + 1, so index + 1 must still be
+ * inside the block.
+ */
+static int read_memory_progbuf_inner_fill(struct target *target,
+		target_addr_t address, uint32_t increment, uint32_t index)
+{
+	if (read_memory_progbuf_inner_startup(target, address, increment, index) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (dmi_write(target, DM_ABSTRACTAUTO,
+			1 << DM_ABSTRACTAUTO_AUTOEXECDATA_OFFSET) != ERROR_OK)
 		return ERROR_FAIL;
+	/* Read garbage from dmi_data0, which triggers another execution of the
+	 * program. Now dmi_data0 contains the first good result, and s1 the next
+	 * memory value. */
+	return dmi_read_exec(target, NULL, DM_DATA0);
+}
+
+/**
+ * Handle a read batch in which some scans came back busy. Store every element
+ * that was read successfully before the first busy scan, and report the first
+ * element that still has to be read in restart_index.
+ */
+static int read_memory_progbuf_inner_on_dmi_busy(struct target *target,
+		struct riscv_batch *batch, target_addr_t address, uint32_t size,
+		uint32_t increment, unsigned index, unsigned reads, uint8_t *buffer,
+		unsigned *restart_index)
+{
+	RISCV013_INFO(info);
+
+	/* The DMI is still busy, so this also clears the sticky busy state and
+	 * increases dmi_busy_delay. */
+	uint32_t abstractcs;
+	if (wait_for_idle(target, &abstractcs) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (dmi_write(target, DM_ABSTRACTAUTO, 0) != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* The batch covers elements index - 2 up to index + reads - 3. */
+	unsigned limit = index + reads - 2;
+
+	info->cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+	switch (info->cmderr) {
+		case CMDERR_NONE:
+			break;
+		case CMDERR_BUSY:
+			increase_ac_busy_delay(target);
+			riscv013_clear_abstract_error(target);
+			/* Values read from dm_data0 after the hart fell behind are stale.
+			 * See how far the hart got. */
+			uint64_t progress;
+			if (increment == 0) {
+				if (register_read_direct(target, &progress, GDB_REGNO_S2) != ERROR_OK)
+					return ERROR_FAIL;
+			} else {
+				if (register_read_direct(target, &progress, GDB_REGNO_S0) != ERROR_OK)
+					return ERROR_FAIL;
+				progress = (progress - address) / increment;
+			}
+			if (progress - 2 < limit)
+				limit = progress - 2;
+			break;
+		default:
+			LOG_DEBUG("error when reading memory, abstractcs=0x%08lx", (long)abstractcs);
+			riscv013_clear_abstract_error(target);
+			return ERROR_FAIL;
+	}
+
+	unsigned read = 0;
+	unsigned j;
+	for (j = index - 2; j < limit; j++) {
+		if (riscv_batch_get_dmi_read_op(batch, read) != DMI_STATUS_SUCCESS)
+			break;
+		uint64_t value = riscv_batch_get_dmi_read_data(batch, read);
+		read++;
+		if (size > 4) {
+			if (riscv_batch_get_dmi_read_op(batch, read) != DMI_STATUS_SUCCESS)
+				break;
+			value <<= 32;
+			value |= riscv_batch_get_dmi_read_data(batch, read);
+			read++;
+		}
+		buf_set_u64(buffer + j * size, 0, 8 * size, value);
+		log_memory_access(address + j * increment, value, size, true);
+	}
+
+	LOG_DEBUG("batch was busy; got %d elements, restarting at %d", j - (index - 2), j);
+	*restart_index = j;
+	return ERROR_OK;
+}
+
+/**
+ * Read the requested memory. Every element is read once, except when the DMI
+ * or the abstract command reports busy: the elements that were already read
+ * by the hart but not yet transferred to the debugger are then read again.
+ *
+ * When the DMI answers busy part way through a batch, everything read before
+ * the first busy scan is kept and the pipeline is refilled at the first
+ * missing element, instead of giving up on the whole block.
+ */
+static int read_memory_progbuf_inner(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer, uint32_t increment)
+{
+	RISCV013_INFO(info);
+
+	int result = ERROR_OK;
 
 	/* First read has just triggered. Result is in s1. */
 	if (count == 1) {
+		if (read_memory_progbuf_inner_startup(target, address, increment, 0) != ERROR_OK)
+			return ERROR_FAIL;
 		uint64_t value;
 		if (register_read_direct(target, &value, GDB_REGNO_S1) != ERROR_OK)
 			return ERROR_FAIL;
@@ -3139,13 +3565,11 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		return ERROR_OK;
 	}
 
-	if (dmi_write(target, DM_ABSTRACTAUTO,
-			1 << DM_ABSTRACTAUTO_AUTOEXECDATA_OFFSET) != ERROR_OK)
-		goto error;
-	/* Read garbage from dmi_data0, which triggers another execution of the
-	 * program. Now dmi_data0 contains the first good result, and s1 the next
-	 * memory value. */
-	if (dmi_read_exec(target, NULL, DM_DATA0) != ERROR_OK)
+	uint32_t command = access_register_command(target, GDB_REGNO_S1,
+			riscv_xlen(target),
+			AC_ACCESS_REGISTER_TRANSFER | AC_ACCESS_REGISTER_POSTEXEC);
+
+	if (read_memory_progbuf_inner_fill(target, address, increment, 0) != ERROR_OK)
 		goto error;
 
 	/* read_addr is the next address that the hart will read from, which is the
@@ -3162,7 +3586,7 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		 * dm_data0 contains[read_addr-size*2]
 		 */
 
-		struct riscv_batch *batch = riscv_batch_alloc(target, RISCV_BATCH_ALLOC_SIZE,
+		struct riscv_batch *batch = riscv_batch_alloc(target, info->read_batch_scans,
 				info->dmi_busy_delay + info->ac_busy_delay);
 		if (!batch)
 			return ERROR_FAIL;
@@ -3180,9 +3604,26 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 
 		batch_run(target, batch);
 
+		if (riscv_batch_was_batch_busy(batch)) {
+			unsigned restart_index;
+			result = read_memory_progbuf_inner_on_dmi_busy(target, batch, address,
+					size, increment, index, reads, buffer, &restart_index);
+			riscv_batch_free(batch);
+			if (result != ERROR_OK)
+				goto error;
+			tune_batch(&info->read_batch_scans, &info->read_clean_runs,
+					&info->dmi_busy_delay, true);
+			if (read_memory_progbuf_inner_fill(target, address, increment,
+						restart_index) != ERROR_OK) {
+				result = ERROR_FAIL;
+				goto error;
+			}
+			index = restart_index + 2;
+			continue;
+		}
+
 		/* Wait for the target to finish performing the last abstract command,
-		 * and update our copy of cmderr. If we see that DMI is busy here,
-		 * dmi_busy_delay will be incremented. */
+		 * and update our copy of cmderr. */
 		uint32_t abstractcs;
 		if (dmi_read(target, &abstractcs, DM_ABSTRACTCS) != ERROR_OK)
 			return ERROR_FAIL;
@@ -3197,6 +3638,8 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 			case CMDERR_NONE:
 				LOG_DEBUG("successful (partial?) memory read");
 				next_index = index + reads;
+				tune_batch(&info->read_batch_scans, &info->read_clean_runs,
+						&info->dmi_busy_delay, false);
 				break;
 			case CMDERR_BUSY:
 				LOG_DEBUG("memory read resulted in busy response");
@@ -3274,14 +3717,9 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 			uint64_t value = riscv_batch_get_dmi_read_data(batch, read);
 			read++;
 			if (status != DMI_STATUS_SUCCESS) {
-				/* If we're here because of busy count, dmi_busy_delay will
-				 * already have been increased and busy state will have been
-				 * cleared in dmi_read(). */
-				/* In at least some implementations, we issue a read, and then
-				 * can get busy back when we try to scan out the read result,
-				 * and the actual read value is lost forever. Since this is
-				 * rare in any case, we return error here and rely on our
-				 * caller to reread the entire block. */
+				/* Busy responses were handled above, so the DM reported a
+				 * failed access. Return error here and rely on our caller to
+				 * reread the block one word at a time. */
 				LOG_WARNING("Batch memory read encountered DMI error %d. "
 						"Falling back on slower reads.", status);
 				riscv_batch_free(batch);
@@ -3489,8 +3927,19 @@ static int read_memory_progbuf(struct target *target, target_addr_t address,
 	if (riscv_program_write(&program) != ERROR_OK)
 		return ERROR_FAIL;
 
+	struct duration bench;
+	duration_start(&bench);
+
 	result = read_memory_progbuf_inner(target, address, size, count, buffer, increment);
 
+	if (result == ERROR_OK && duration_measure(&bench) == ERROR_OK) {
+		RISCV013_INFO(info);
+		LOG_DEBUG("read %" PRIu32 " bytes in %fs (%0.3f KiB/s); read_batch_scans=%d, "
+				"dmi_busy_delay=%d, ac_busy_delay=%d", count * size,
+				duration_elapsed(&bench), duration_kbps(&bench, count * size),
+				info->read_batch_scans, info->dmi_busy_delay, info->ac_busy_delay);
+	}
+
 	if (result != ERROR_OK) {
 		/* The full read did not succeed, so we will try to read each word individually. */
 		/* This will not be fast, but reading outside actual memory is a special case anyway. */
@@ -3653,6 +4102,9 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 
 	int result;
 
+	struct duration bench;
+	duration_start(&bench);
+
 	sb_write_address(target, next_address, true);
 	while (next_address < end_address) {
 		LOG_DEBUG("transferring burst starting at address 0x%" TARGET_PRIxADDR,
@@ -3660,7 +4112,7 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
-				RISCV_BATCH_ALLOC_SIZE,
+				info->write_batch_scans,
 				info->dmi_busy_delay + info->bus_master_write_delay);
 		if (!batch)
 			return ERROR_FAIL;
@@ -3705,21 +4157,44 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 
 		/* Execute the batch of writes */
 		result = batch_run(target, batch);
-		riscv_batch_free(batch);
-		if (result != ERROR_OK)
+		if (result != ERROR_OK) {
+			riscv_batch_free(batch);
 			return result;
+		}
 
-		/* Read sbcs value.
-		 * At the same time, detect if DMI busy has occurred during the batch write. */
-		bool dmi_busy_encountered;
-		if (dmi_op(target, &sbcs, &dmi_busy_encountered, DMI_OP_READ,
-				DM_SBCS, 0, false, true) != ERROR_OK)
+		/* The DTM ignores every scan from the first busy one on, so resume the
+		 * batch right there. Nothing is skipped or written twice, and sbaddress
+		 * doesn't need to be read back. */
+		time_t start = time(NULL);
+		size_t finished_scans = riscv_batch_finished_scans(batch);
+		bool dmi_busy_encountered = finished_scans < batch->used_scans;
+		while (finished_scans < batch->used_scans) {
+			LOG_DEBUG("DMI busy encountered during system bus write, resuming at "
+					"scan %zu of %zu.", finished_scans, batch->used_scans);
+			/* This also clears the sticky busy with dmireset. */
+			increase_dmi_busy_delay(target);
+			batch->idle_count = info->dmi_busy_delay + info->bus_master_write_delay;
+			if (time(NULL) - start > riscv_command_timeout_sec) {
+				LOG_ERROR("Timed out after %ds resuming a busy system bus write. "
+						"Increase the timeout with riscv set_command_timeout_sec.",
+						riscv_command_timeout_sec);
+				riscv_batch_free(batch);
+				return ERROR_FAIL;
+			}
+			result = riscv_batch_run_from(batch, finished_scans);
+			if (result != ERROR_OK) {
+				riscv_batch_free(batch);
+				return result;
+			}
+			finished_scans = riscv_batch_finished_scans(batch);
+		}
+		riscv_batch_free(batch);
+
+		if (dmi_read(target, &sbcs, DM_SBCS) != ERROR_OK)
 			return ERROR_FAIL;
-		if (dmi_busy_encountered)
-			LOG_DEBUG("DMI busy encountered during system bus write.");
 
 		/* Wait until sbbusy goes low */
-		time_t start = time(NULL);
+		start = time(NULL);
 		while (get_field(sbcs, DM_SBCS_SBBUSY)) {
 			if (time(NULL) - start > riscv_command_timeout_sec) {
 				LOG_ERROR("Timed out after %ds waiting for sbbusy to go low (sbcs=0x%x). "
@@ -3738,11 +4213,12 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			dmi_write(target, DM_SBCS, sbcs | DM_SBCS_SBBUSYERROR);
 			/* Slow down before trying again. */
 			info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
-		}
+			tune_batch(&info->write_batch_scans, &info->write_clean_runs,
+					&info->bus_master_write_delay, true);
 
-		if (get_field(sbcs, DM_SBCS_SBBUSYERROR) || dmi_busy_encountered) {
 			/* Recover from the case when the write commands were issued too fast.
-			 * Determine the address from which to resume writing. */
+			 * The writes after the failing one were dropped, so one readback
+			 * of sbaddress tells where to resume writing. */
 			next_address = sb_read_address(target);
 			if (next_address < address) {
 				/* This should never happen, probably buggy hardware. */
@@ -3775,8 +4251,20 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 			/* Fail the whole operation */
 			return ERROR_FAIL;
 		}
+
+		/* Only learn a lower bus delay from batches that went through
+		 * without any busy response. */
+		tune_batch(&info->write_batch_scans, &info->write_clean_runs,
+				&info->bus_master_write_delay, dmi_busy_encountered);
 	}
 
+	if (duration_measure(&bench) == ERROR_OK)
+		LOG_DEBUG("wrote %" PRIu32 " bytes in %fs (%0.3f KiB/s); write_batch_scans=%d, "
+				"dmi_busy_delay=%d, bus_master_write_delay=%d", count * size,
+				duration_elapsed(&bench), duration_kbps(&bench, count * size),
+				info->write_batch_scans, info->dmi_busy_delay,
+				info->bus_master_write_delay);
+
 	return ERROR_OK;
 }
 
@@ -4111,6 +4599,185 @@ static int riscv013_set_register(struct target *target, int rid, uint64_t value)
 	return ERROR_OK;
 }
 
+/* Can number be accessed by an abstract command queued in a batch? */
+static bool register_batchable(struct target *target, enum gdb_regno number,
+		bool write)
+{
+	RISCV013_INFO(info);
+
+	unsigned int size = register_size(target, number);
+	if (size != 32 && size != 64)
+		return false;
+	if (number <= GDB_REGNO_XPR31)
+		return true;
+	if (number >= GDB_REGNO_CSR0 && number <= GDB_REGNO_CSR4095)
+		return write ? info->abstract_write_csr_supported :
+			info->abstract_read_csr_supported;
+	return false;
+}
+
+/* Check the result of a batch of abstract register commands. Each command was
+ * followed by a read of abstractcs whose key is in status_keys. Returns how
+ * many commands at the start of the batch completed successfully. */
+static unsigned int register_batch_progress(struct target *target,
+		struct riscv_batch *batch, unsigned int count,
+		const enum gdb_regno *regnos, const size_t *status_keys)
+{
+	unsigned int good = 0;
+	uint32_t cmderr = CMDERR_NONE;
+	while (good < count) {
+		if (riscv_batch_get_dmi_read_op(batch, status_keys[good]) != DMI_STATUS_SUCCESS)
+			break;
+		uint32_t abstractcs = riscv_batch_get_dmi_read_data(batch, status_keys[good]);
+		cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+		if (cmderr != CMDERR_NONE || get_field(abstractcs, DM_ABSTRACTCS_BUSY))
+			break;
+		good++;
+	}
+
+	if (riscv_batch_was_batch_busy(batch))
+		increase_dmi_busy_delay(target);
+
+	if (good < count) {
+		uint32_t abstractcs;
+		if (wait_for_idle(target, &abstractcs) != ERROR_OK)
+			return 0;
+		cmderr = get_field(abstractcs, DM_ABSTRACTCS_CMDERR);
+		if (cmderr == CMDERR_BUSY)
+			increase_ac_busy_delay(target);
+		/* Anything else is left to the regular code path, which knows how
+		 * to fall back to the program buffer. */
+		if (cmderr != CMDERR_NONE) {
+			LOG_DEBUG("[%s] batched access to %s failed with cmderr %d",
+					target_name(target), gdb_regno_name(regnos[good]), cmderr);
+			riscv013_clear_abstract_error(target);
+		}
+	}
+
+	return good;
+}
+
+/**
+ * Read count registers using back-to-back abstract commands in a single
+ * batch. Registers that can't be read this way, or whose command didn't
+ * complete, are left with read[i] false.
+ */
+static int riscv013_get_registers(struct target *target, unsigned int count,
+		const enum gdb_regno *regnos, riscv_reg_t *values, bool *read)
+{
+	RISCV013_INFO(info);
+
+	if (riscv_select_current_hart(target) != ERROR_OK)
+		return ERROR_FAIL;
+
+	enum gdb_regno *batched = calloc(count, sizeof(*batched));
+	size_t *status_keys = calloc(count, sizeof(*status_keys));
+	size_t *data_keys = calloc(count, sizeof(*data_keys));
+	struct riscv_batch *batch = riscv_batch_alloc(target, 4 * count,
+			info->dmi_busy_delay + info->ac_busy_delay);
+	int result = ERROR_FAIL;
+	if (!batched || !status_keys || !data_keys || !batch)
+		goto done;
+
+	unsigned int n = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		read[i] = false;
+		if (!register_batchable(target, regnos[i], false))
+			continue;
+		unsigned int size = register_size(target, regnos[i]);
+		riscv_batch_add_dmi_write(batch, DM_COMMAND,
+				access_register_command(target, regnos[i], size,
+					AC_ACCESS_REGISTER_TRANSFER));
+		status_keys[n] = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+		if (size > 32)
+			riscv_batch_add_dmi_read(batch, DM_DATA1);
+		data_keys[n] = riscv_batch_add_dmi_read(batch, DM_DATA0);
+		batched[n++] = regnos[i];
+	}
+
+	if (n == 0 || batch_run(target, batch) != ERROR_OK)
+		goto done;
+
+	unsigned int good = register_batch_progress(target, batch, n, batched,
+			status_keys);
+	for (unsigned int i = 0, j = 0; i < count && j < good; i++) {
+		if (regnos[i] != batched[j])
+			continue;
+		if (riscv_batch_get_dmi_read_op(batch, data_keys[j]) != DMI_STATUS_SUCCESS)
+			break;
+		values[i] = riscv_batch_get_dmi_read_data(batch, data_keys[j]);
+		if (register_size(target, regnos[i]) > 32) {
+			/* data1 was read right before data0. */
+			if (riscv_batch_get_dmi_read_op(batch, data_keys[j] - 1) != DMI_STATUS_SUCCESS)
+				break;
+			values[i] |= (riscv_reg_t)riscv_batch_get_dmi_read_data(batch,
+					data_keys[j] - 1) << 32;
+		}
+		read[i] = true;
+		j++;
+	}
+	LOG_DEBUG("[%s] read %u of %u registers in one batch", target_name(target),
+			good, count);
+	result = ERROR_OK;
+
+done:
+	if (batch)
+		riscv_batch_free(batch);
+	free(batched);
+	free(status_keys);
+	free(data_keys);
+	return result;
+}
+
+/**
+ * Write count GPRs and CSRs using back-to-back abstract commands in a single
+ * batch. Fails unless every register was written this way.
+ */
+static int riscv013_set_registers(struct target *target, unsigned int count,
+		const enum gdb_regno *regnos, const riscv_reg_t *values)
+{
+	RISCV013_INFO(info);
+
+	for (unsigned int i = 0; i < count; i++)
+		if (!register_batchable(target, regnos[i], true))
+			return ERROR_FAIL;
+
+	if (riscv_select_current_hart(target) != ERROR_OK)
+		return ERROR_FAIL;
+
+	size_t *status_keys = calloc(count, sizeof(*status_keys));
+	struct riscv_batch *batch = riscv_batch_alloc(target, 4 * count,
+			info->dmi_busy_delay + info->ac_busy_delay);
+	int result = ERROR_FAIL;
+	if (!status_keys || !batch)
+		goto done;
+
+	for (unsigned int i = 0; i < count; i++) {
+		LOG_DEBUG("{%d} %s <- 0x%" PRIx64, riscv_current_hartid(target),
+				gdb_regno_name(regnos[i]), values[i]);
+		unsigned int size = register_size(target, regnos[i]);
+		riscv_batch_add_dmi_write(batch, DM_DATA0, (uint32_t)values[i]);
+		if (size > 32)
+			riscv_batch_add_dmi_write(batch, DM_DATA1, values[i] >> 32);
+		riscv_batch_add_dmi_write(batch, DM_COMMAND,
+				access_register_command(target, regnos[i], size,
+					AC_ACCESS_REGISTER_TRANSFER | AC_ACCESS_REGISTER_WRITE));
+		status_keys[i] = riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+	}
+
+	if (batch_run(target, batch) != ERROR_OK)
+		goto done;
+
+	if (register_batch_progress(target, batch, count, regnos, status_keys) == count)
+		result = ERROR_OK;
+
+done:
+	if (batch)
+		riscv_batch_free(batch);
+	free(status_keys);
+	return result;
+}
+
 static int riscv013_select_current_hart(struct target *target)
 {
 	RISCV_INFO(r);
@@ -4298,6 +4965,104 @@ static bool riscv013_is_halted(struct target *target)
 	return get_field(dmstatus, DM_DMSTATUS_ALLHALTED);
 }
 
+/**
+ * Select every examined hart on the DM through the hart array window, and
+ * read dmstatus once to find out whether they are all halted or all running.
+ * This replaces one dmcontrol write and dmstatus read per hart when polling
+ * large SMP clusters.
+ */
+static int riscv013_hart_summary(struct target *target, unsigned int poll_id,
+		enum riscv_hart_summary *summary)
+{
+	RISCV013_INFO(info);
+	dm013_info_t *dm = get_dm(target);
+	if (!dm)
+		return ERROR_FAIL;
+
+	if (dm->summary_valid && dm->summary_poll_id == poll_id) {
+		*summary = dm->summary;
+		return ERROR_OK;
+	}
+
+	*summary = RISCV_HARTS_MIXED;
+	dm->summary_valid = true;
+	dm->summary_poll_id = poll_id;
+	dm->summary = RISCV_HARTS_MIXED;
+
+	if (!dm->hasel_supported || dm->hart_count <= 1)
+		return ERROR_OK;
+
+	unsigned int hawindow_count = (dm->hart_count + 31) / 32;
+	uint32_t hawindow[hawindow_count];
+	memset(hawindow, 0, sizeof(uint32_t) * hawindow_count);
+
+	target_list_t *entry;
+	unsigned int total_selected = 0;
+	int hartsel = -1;
+	list_for_each_entry(entry, &dm->target_list, list) {
+		struct target *t = entry->target;
+		if (!target_was_examined(t))
+			continue;
+		unsigned int index = get_info(t)->index;
+		hawindow[index / 32] |= 1u << (index % 32);
+		if (hartsel < 0)
+			hartsel = riscv_info(t)->current_hartid;
+		total_selected++;
+	}
+
+	/* A single hart is just as cheap to poll directly. */
+	if (total_selected <= 1)
+		return ERROR_OK;
+
+	struct riscv_batch *batch = riscv_batch_alloc(target, 2 * hawindow_count + 3,
+			info->dmi_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < hawindow_count; i++) {
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOWSEL, i);
+		riscv_batch_add_dmi_write(batch, DM_HAWINDOW, hawindow[i]);
+	}
+	uint32_t dmcontrol = set_hartsel(DM_DMCONTROL_DMACTIVE, hartsel);
+	riscv_batch_add_dmi_write(batch, DM_DMCONTROL, dmcontrol | DM_DMCONTROL_HASEL);
+	size_t dmstatus_key = riscv_batch_add_dmi_read(batch, DM_DMSTATUS);
+	/* Don't leave hasel set, or the next halt or resume request would go to
+	 * every hart in the window. */
+	riscv_batch_add_dmi_write(batch, DM_DMCONTROL, dmcontrol);
+
+	if (batch_run(target, batch) != ERROR_OK) {
+		riscv_batch_free(batch);
+		dm->current_hartid = -1;
+		return ERROR_FAIL;
+	}
+	dm->current_hartid = hartsel;
+	if (riscv_batch_was_batch_busy(batch)) {
+		increase_dmi_busy_delay(target);
+		riscv_batch_free(batch);
+		return dmi_write(target, DM_DMCONTROL, dmcontrol);
+	}
+
+	uint32_t dmstatus = riscv_batch_get_dmi_read_data(batch, dmstatus_key);
+	riscv_batch_free(batch);
+
+	LOG_DEBUG("[%s] %u harts, dmstatus=0x%08x", target_name(target),
+			total_selected, dmstatus);
+
+	/* Leave anything unusual to the per-hart poll, which reports it. */
+	if (get_field(dmstatus, DM_DMSTATUS_ANYUNAVAIL) ||
+			get_field(dmstatus, DM_DMSTATUS_ANYNONEXISTENT) ||
+			get_field(dmstatus, DM_DMSTATUS_ANYHAVERESET))
+		return ERROR_OK;
+
+	if (get_field(dmstatus, DM_DMSTATUS_ALLHALTED))
+		dm->summary = RISCV_HARTS_ALL_HALTED;
+	else if (!get_field(dmstatus, DM_DMSTATUS_ANYHALTED))
+		dm->summary = RISCV_HARTS_ALL_RUNNING;
+	*summary = dm->summary;
+
+	return ERROR_OK;
+}
+
 static enum riscv_halt_reason riscv013_halt_reason(struct target *target)
 {
 	riscv_reg_t dcsr;
@@ -22,6 +22,7 @@
 #include "riscv.h"
 #include "gdb_regs.h"
 #include "rtos/rtos.h"
+#include "server/server.h"
 #include "debug_defines.h"
 #include <helper/bits.h>
 #include "etrace.h"
@@ -200,6 +201,15 @@ void riscv_sample_buf_maybe_add_timestamp(struct target *target, bool before)
 	}
 }
 
+#define RISCV_SAMPLE_SERVICE_NAME	"riscv_memory_sample"
+
+/* A client of the memory sample service. */
+struct riscv_sample_connection {
+	struct list_head lh;
+	struct connection *connection;
+};
+
+static int riscv_sample_timer_callback(void *priv);
 static int riscv_resume_go_all_harts(struct target *target);
 
 void select_dmi_via_bscan(struct target *target)
@@ -444,6 +454,14 @@ static void riscv_deinit_target(struct target *target)
 		free(entry);
 	}
 
+	if (info->sample_interval_ms)
+		target_unregister_timer_callback(riscv_sample_timer_callback, target);
+	if (info->sample_port) {
+		remove_service(RISCV_SAMPLE_SERVICE_NAME, info->sample_port);
+		free(info->sample_port);
+	}
+	free(info->sample_buf.buf);
+
 	free(info->reg_names);
 	free(target->arch_info);
 
@@ -1161,6 +1179,64 @@ int riscv_select_current_hart(struct target *target)
 	return riscv_set_current_hartid(target, target->coreid);
 }
 
+static bool gdb_regno_cacheable(enum gdb_regno regno, bool write);
+
+/**
+ * Fill the register cache of a hart that just halted. All GPRs, dpc and every
+ * CSR that missed the cache before are read in a single batch, so that a
+ * debugger stop doesn't cost one round trip per register. Anything that can't
+ * be fetched this way is simply left to be read on demand.
+ */
+static void riscv_prefetch_registers(struct target *target)
+{
+	RISCV_INFO(r);
+
+	if (!r->get_registers || !target->reg_cache)
+		return;
+
+	enum gdb_regno *regnos = calloc(GDB_REGNO_COUNT, sizeof(*regnos));
+	riscv_reg_t *values = calloc(GDB_REGNO_COUNT, sizeof(*values));
+	bool *read = calloc(GDB_REGNO_COUNT, sizeof(*read));
+	if (!regnos || !values || !read)
+		goto done;
+
+	unsigned int count = 0;
+	for (unsigned int number = GDB_REGNO_RA; number < GDB_REGNO_COUNT; number++) {
+		if (number > GDB_REGNO_XPR31 && number != GDB_REGNO_DPC &&
+				!(number >= GDB_REGNO_CSR0 && number <= GDB_REGNO_CSR4095 &&
+					test_bit(number, r->reg_requested)))
+			continue;
+		if (number > GDB_REGNO_XPR15 && number <= GDB_REGNO_XPR31 &&
+				riscv_supports_extension(target, 'E'))
+			continue;
+		struct reg *reg = &target->reg_cache->reg_list[number];
+		if (!reg->exist || reg->valid || !gdb_regno_cacheable(number, false))
+			continue;
+		regnos[count++] = number;
+	}
+
+	if (count == 0 || r->get_registers(target, count, regnos, values, read) != ERROR_OK)
+		goto done;
+
+	unsigned int prefetched = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		if (!read[i])
+			continue;
+		struct reg *reg = &target->reg_cache->reg_list[regnos[i]];
+		buf_set_u64(reg->value, 0, reg->size, values[i]);
+		reg->valid = true;
+		prefetched++;
+	}
+	r->reg_prefetched += prefetched;
+	LOG_DEBUG("[%s] prefetched %u of %u registers", target_name(target),
+			prefetched, count);
+
+done:
+	free(regnos);
+	free(values);
+	free(read);
+}
+
 int riscv_flush_registers(struct target *target)
 {
 	RISCV_INFO(r);
@@ -1170,6 +1246,26 @@ int riscv_flush_registers(struct target *target)
 
 	LOG_DEBUG("[%s]", target_name(target));
 
+	/* Write all dirty GPRs back in one go if the target can do that. Whatever
+	 * is left dirty is written one register at a time below. */
+	if (r->set_registers) {
+		enum gdb_regno regnos[GDB_REGNO_XPR31 + 1];
+		riscv_reg_t values[GDB_REGNO_XPR31 + 1];
+		unsigned int count = 0;
+		for (unsigned int number = GDB_REGNO_RA; number <= GDB_REGNO_XPR31; number++) {
+			struct reg *reg = &target->reg_cache->reg_list[number];
+			if (reg->valid && reg->dirty) {
+				regnos[count] = number;
+				values[count++] = buf_get_u64(reg->value, 0, reg->size);
+			}
+		}
+		if (count > 1 && r->set_registers(target, count, regnos, values) == ERROR_OK) {
+			LOG_DEBUG("[%s] wrote back %u dirty GPRs", target_name(target), count);
+			for (unsigned int i = 0; i < count; i++)
+				target->reg_cache->reg_list[regnos[i]].dirty = false;
+		}
+	}
+
 	for (uint32_t number = 0; number < target->reg_cache->num_regs; number++) {
 		struct reg *reg = &target->reg_cache->reg_list[number];
 		if (reg->valid && reg->dirty) {
@@ -1223,6 +1319,24 @@ int set_debug_reason(struct target *target, enum riscv_halt_reason halt_reason)
 	return ERROR_OK;
 }
 
+/* Identifies one pass over the harts, so that summaries can be shared by all
+ * harts on the same DM. */
+static unsigned int riscv_poll_id;
+/* Use the DM's hart summary to skip harts whose state didn't change. Only
+ * turned off by "riscv smp_poll_benchmark", to compare against. */
+static bool riscv_use_hart_summary = true;
+
+static enum riscv_hart_summary riscv_hart_summary(struct target *target)
+{
+	RISCV_INFO(r);
+	enum riscv_hart_summary summary;
+
+	if (!riscv_use_hart_summary || !r->hart_summary ||
+			r->hart_summary(target, riscv_poll_id, &summary) != ERROR_OK)
+		return RISCV_HARTS_MIXED;
+	return summary;
+}
+
 int halt_prep(struct target *target)
 {
 	RISCV_INFO(r);
@@ -1262,6 +1376,7 @@ int riscv_halt_go_all_harts(struct target *target)
 			return ERROR_FAIL;
 
 		riscv_invalidate_register_cache(target);
+		riscv_prefetch_registers(target);
 	}
 
 	return ERROR_OK;
@@ -1301,12 +1416,22 @@ int riscv_halt(struct target *target)
 	LOG_DEBUG("[%d] halting all harts", target->coreid);
 
 	int result = ERROR_OK;
-	if (target->smp) {
+	if (target->smp && !r->non_stop) {
 		struct target_list *tlist;
+		riscv_poll_id++;
 		foreach_smp_target(tlist, target->smp_targets) {
 			struct target *t = tlist->target;
-			if (halt_prep(t) != ERROR_OK)
+			riscv_info_t *i = riscv_info(t);
+			if (target_was_examined(t) &&
+					riscv_hart_summary(t) == RISCV_HARTS_ALL_RUNNING) {
+				/* No need to ask every hart whether it's halted. */
+				if (i->halt_prep(t) != ERROR_OK)
+					result = ERROR_FAIL;
+				else
+					i->prepped = true;
+			} else if (halt_prep(t) != ERROR_OK) {
 				result = ERROR_FAIL;
+			}
 		}
 
 		foreach_smp_target(tlist, target->smp_targets) {
@@ -1521,7 +1646,7 @@ int riscv_resume(
 {
 	LOG_DEBUG("handle_breakpoints=%d", handle_breakpoints);
 	int result = ERROR_OK;
-	if (target->smp && !single_hart) {
+	if (target->smp && !single_hart && !riscv_info(target)->non_stop) {
 		struct target_list *tlist;
 		foreach_smp_target_direction(resume_order == RO_NORMAL,
 									 tlist, target->smp_targets) {
@@ -1570,6 +1695,29 @@ static int riscv_target_resume(struct target *target, int current, target_addr_t
 			debug_execution, false);
 }
 
+static int riscv_set_non_stop(struct target *target, bool non_stop)
+{
+	RISCV_INFO(r);
+
+	if (!r->is_halted) {
+		LOG_ERROR("Non-stop mode is not supported for this RISC-V target.");
+		return ERROR_NOT_IMPLEMENTED;
+	}
+
+	LOG_DEBUG("[%s] non_stop=%d", target_name(target), non_stop);
+	if (r->non_stop == non_stop)
+		return ERROR_OK;
+
+	/* A hart in a halt group would stop the whole group as soon as it hits a
+	 * breakpoint. */
+	if (r->set_halt_group && target_was_examined(target) &&
+			r->set_halt_group(target, !non_stop) != ERROR_OK)
+		return ERROR_FAIL;
+
+	r->non_stop = non_stop;
+	return ERROR_OK;
+}
+
 static int riscv_mmu(struct target *target, int *enabled)
 {
 	if (!riscv_enable_virt2phys) {
@@ -2136,6 +2284,7 @@ static enum riscv_poll_hart riscv_poll_hart(struct target *target, int hartid)
 	if (target->state != TARGET_HALTED && halted) {
 		LOG_DEBUG("  triggered a halt");
 		r->on_halt(target);
+		riscv_prefetch_registers(target);
 		return RPH_DISCOVERED_HALTED;
 	} else if (target->state != TARGET_RUNNING && target->state != TARGET_DEBUG_RUNNING && !halted) {
 		LOG_DEBUG("  triggered running");
@@ -2147,11 +2296,77 @@ static enum riscv_poll_hart riscv_poll_hart(struct target *target, int hartid)
 	return RPH_NO_CHANGE;
 }
 
+/* Return true when one more round of samples, with its timestamps, doesn't
+ * fit in the sample buffer. */
+static bool riscv_sample_buf_full(struct target *target)
+{
+	RISCV_INFO(r);
+
+	unsigned int needed = 2 * 5;
+	for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++) {
+		if (r->sample_config.bucket[i].enabled)
+			needed += 1 + r->sample_config.bucket[i].size_bytes;
+	}
+	if (r->sample_buf.used + needed < r->sample_buf.size)
+		return false;
+
+	if (!r->sample_buf.overflows)
+		LOG_WARNING("[%s] Memory sample buffer is full. Samples are dropped until "
+				"it is emptied.", target_name(target));
+	r->sample_buf.overflows++;
+	return true;
+}
+
+/* Send everything in the sample buffer to the clients of the memory sample
+ * service, if there are any, and empty it. */
+static void riscv_sample_buf_stream(struct target *target)
+{
+	RISCV_INFO(r);
+
+	if (list_empty(&r->sample_connections) || !r->sample_buf.used)
+		return;
+
+	struct riscv_sample_connection *c;
+	list_for_each_entry(c, &r->sample_connections, lh) {
+		if (connection_write(c->connection, r->sample_buf.buf,
+					r->sample_buf.used) != (int)r->sample_buf.used)
+			LOG_ERROR("[%s] Error writing memory samples to connection",
+					target_name(target));
+	}
+	r->sample_buf.used = 0;
+}
+
+/* Read every enabled bucket once, and append the values to the sample buffer. */
+static int sample_memory_buckets(struct target *target)
+{
+	RISCV_INFO(r);
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++) {
+		if (r->sample_config.bucket[i].enabled &&
+				r->sample_buf.used + 1 + r->sample_config.bucket[i].size_bytes < r->sample_buf.size) {
+			assert(i < RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE);
+			r->sample_buf.buf[r->sample_buf.used] = i;
+			int result = riscv_read_phys_memory(
+				target, r->sample_config.bucket[i].address,
+				r->sample_config.bucket[i].size_bytes, 1,
+				r->sample_buf.buf + r->sample_buf.used + 1);
+			if (result != ERROR_OK)
+				return result;
+			r->sample_buf.used += 1 + r->sample_config.bucket[i].size_bytes;
+		}
+	}
+	return ERROR_OK;
+}
+
 int sample_memory(struct target *target)
 {
 	RISCV_INFO(r);
 
-	if (!r->sample_buf.buf || !r->sample_config.enabled)
+	/* With a sample interval, riscv_sample_timer_callback() does the work. */
+	if (!r->sample_buf.buf || !r->sample_config.enabled || r->sample_interval_ms)
+		return ERROR_OK;
+
+	if (riscv_sample_buf_full(target))
 		return ERROR_OK;
 
 	LOG_DEBUG("buf used/size: %d/%d", r->sample_buf.used, r->sample_buf.size);
@@ -2168,21 +2383,9 @@ int sample_memory(struct target *target)
 
 	/* Default slow path. */
 	while (timeval_ms() - start < TARGET_DEFAULT_POLLING_INTERVAL) {
-		for (unsigned int i = 0; i < ARRAY_SIZE(r->sample_config.bucket); i++) {
-			if (r->sample_config.bucket[i].enabled &&
-					r->sample_buf.used + 1 + r->sample_config.bucket[i].size_bytes < r->sample_buf.size) {
-				assert(i < RISCV_SAMPLE_BUF_TIMESTAMP_BEFORE);
-				r->sample_buf.buf[r->sample_buf.used] = i;
-				result = riscv_read_phys_memory(
-					target, r->sample_config.bucket[i].address,
-					r->sample_config.bucket[i].size_bytes, 1,
-					r->sample_buf.buf + r->sample_buf.used + 1);
-				if (result == ERROR_OK)
-					r->sample_buf.used += 1 + r->sample_config.bucket[i].size_bytes;
-				else
-					goto exit;
-			}
-		}
+		result = sample_memory_buckets(target);
+		if (result != ERROR_OK)
+			goto exit;
 	}
 
 exit:
@@ -2191,10 +2394,203 @@ exit:
 		LOG_INFO("Turning off memory sampling because it failed.");
 		r->sample_config.enabled = false;
 	}
+	riscv_sample_buf_stream(target);
 	return result;
 }
 
+/* Take one round of memory samples every sample_interval_ms. */
+static int riscv_sample_timer_callback(void *priv)
+{
+	struct target *target = priv;
+	RISCV_INFO(r);
+
+	if (!target_was_examined(target) || target->state != TARGET_RUNNING ||
+			!r->sample_buf.buf || !r->sample_config.enabled)
+		return ERROR_OK;
+
+	if (riscv_sample_buf_full(target))
+		return ERROR_OK;
+
+	riscv_sample_buf_maybe_add_timestamp(target, true);
+	if (sample_memory_buckets(target) != ERROR_OK) {
+		LOG_INFO("Turning off memory sampling because it failed.");
+		r->sample_config.enabled = false;
+	}
+	riscv_sample_buf_stream(target);
+	return ERROR_OK;
+}
+
+/* Fill buf with samples of the configured PC sample register, in the same
+ * format sample_memory() uses, until it is full or until_ms has passed. Uses
+ * the version specific memory sampling code when it is available, since that
+ * batches many system bus reads into each queue flush. */
+static int riscv_read_pc_samples(struct target *target, struct riscv_sample_buf *buf,
+		int64_t until_ms)
+{
+	RISCV_INFO(r);
+	unsigned int entry_size = 1 + r->pc_sample.size_bytes;
+
+	buf->used = 0;
+
+	if (r->sample_memory) {
+		riscv_sample_config_t config = { .enabled = true };
+		config.bucket[0].enabled = true;
+		config.bucket[0].address = r->pc_sample.address;
+		config.bucket[0].size_bytes = r->pc_sample.size_bytes;
+
+		int result = r->sample_memory(target, buf, &config, until_ms);
+		if (result != ERROR_NOT_IMPLEMENTED)
+			return result;
+	}
+
+	/* Default slow path. */
+	while (timeval_ms() < until_ms && buf->used + entry_size < buf->size) {
+		buf->buf[buf->used] = 0;
+		int result = riscv_read_phys_memory(target, r->pc_sample.address,
+				r->pc_sample.size_bytes, 1, buf->buf + buf->used + 1);
+		if (result != ERROR_OK)
+			return result;
+		buf->used += entry_size;
+	}
+	return ERROR_OK;
+}
+
+static int riscv_profiling(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+{
+	RISCV_INFO(r);
+
+	if (!r->pc_sample.enabled)
+		return target_profiling_default(target, samples, max_num_samples,
+				num_samples, seconds);
+
+	LOG_INFO("[%s] Starting profiling. Sampling the PC at 0x%" TARGET_PRIxADDR
+			" as fast as we can...", target_name(target), r->pc_sample.address);
+
+	/* Make sure the target is running */
+	int retval = target_poll(target);
+	if (retval == ERROR_OK && target->state == TARGET_HALTED)
+		retval = target_resume(target, 1, 0, 0, 0);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("[%s] Error while resuming target", target_name(target));
+		return retval;
+	}
+
+	unsigned int entry_size = 1 + r->pc_sample.size_bytes;
+	struct riscv_sample_buf buf = {
+		.size = 1024 * entry_size
+	};
+	buf.buf = malloc(buf.size);
+	if (!buf.buf) {
+		LOG_ERROR("Failed to allocate sample buffer.");
+		return ERROR_FAIL;
+	}
+
+	int64_t start = timeval_ms();
+	int64_t deadline = start + (int64_t)seconds * 1000;
+	uint32_t sample_count = 0;
+	uint32_t dropped = 0;
+
+	while (sample_count < max_num_samples) {
+		int64_t now = timeval_ms();
+		if (now >= deadline)
+			break;
+
+		/* Come back to the main loop regularly, like sample_memory() does. */
+		int64_t until_ms = MIN(deadline, now + TARGET_DEFAULT_POLLING_INTERVAL);
+		retval = riscv_read_pc_samples(target, &buf, until_ms);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("[%s] Error while reading PC samples", target_name(target));
+			break;
+		}
+
+		for (unsigned int i = 0; i + entry_size <= buf.used; i += entry_size) {
+			uint64_t pc = buf_get_u64(buf.buf + i + 1, 0, r->pc_sample.size_bytes * 8);
+			/* PCs are always 2-byte aligned. Registers like this one read
+			 * all ones (or some other odd value) while no PC is available,
+			 * e.g. when the hart is halted or in reset. Samples that don't
+			 * fit in the caller's array are dropped as well. */
+			if (pc & 1)
+				dropped++;
+			else if (sample_count < max_num_samples)
+				samples[sample_count++] = pc;
+			else
+				dropped++;
+		}
+	}
+
+	free(buf.buf);
+
+	uint64_t duration_ms = timeval_ms() - start;
+	LOG_INFO("[%s] Profiling completed. %" PRIu32 " samples in %" PRIu64 " ms "
+			"(%" PRIu64 " samples/s), %" PRIu32 " dropped.", target_name(target),
+			sample_count, duration_ms,
+			duration_ms ? (uint64_t)sample_count * 1000 / duration_ms : 0, dropped);
+
+	*num_samples = sample_count;
+	return retval;
+}
+
 /*** OpenOCD Interface ***/
+/* Use the hart summary to find out whether target is still in the state
+ * OpenOCD thinks it is in, without talking to the hart itself. */
+static bool riscv_hart_state_unchanged(struct target *target)
+{
+	RISCV_INFO(r);
+	bool unchanged;
+
+	switch (riscv_hart_summary(target)) {
+		case RISCV_HARTS_ALL_HALTED:
+			unchanged = target->state == TARGET_HALTED;
+			break;
+		case RISCV_HARTS_ALL_RUNNING:
+			unchanged = target->state == TARGET_RUNNING ||
+				target->state == TARGET_DEBUG_RUNNING;
+			break;
+		default:
+			return false;
+	}
+
+	/* riscv_poll_hart() would have flushed the register cache of an idle
+	 * hart, so do the same. This only talks to the hart if a register is
+	 * dirty. */
+	if (unchanged && target->state == TARGET_HALTED &&
+			timeval_ms() - r->last_activity > 100) {
+		if (riscv_flush_registers(target) != ERROR_OK)
+			return false;
+	}
+
+	return unchanged;
+}
+
+/* Tell everybody that target halted, unless it stopped for a semihosting call
+ * that could be handled right away. */
+static int riscv_halted_event(struct target *target, enum target_state old_state)
+{
+	if (target->debug_reason == DBG_REASON_BREAKPOINT) {
+		int retval;
+		switch (riscv_semihosting(target, &retval)) {
+			case SEMI_NONE:
+			case SEMI_WAITING:
+				target_call_event_callbacks(target, TARGET_EVENT_HALTED);
+				break;
+			case SEMI_HANDLED:
+				if (riscv_resume(target, true, 0, 0, 0, false) != ERROR_OK)
+					return ERROR_FAIL;
+				break;
+			case SEMI_ERROR:
+				return retval;
+		}
+	} else {
+		if (old_state == TARGET_DEBUG_RUNNING)
+			target_call_event_callbacks(target, TARGET_EVENT_DEBUG_HALTED);
+		else
+			target_call_event_callbacks(target, TARGET_EVENT_HALTED);
+	}
+
+	return ERROR_OK;
+}
+
 int riscv_openocd_poll(struct target *target)
 {
 	LOG_DEBUG("polling all harts");
@@ -2205,12 +2601,18 @@ int riscv_openocd_poll(struct target *target)
 		unsigned should_remain_halted = 0;
 		unsigned should_resume = 0;
 		struct target_list *list;
+		riscv_poll_id++;
 		foreach_smp_target(list, target->smp_targets) {
 			struct target *t = list->target;
 			if (!target_was_examined(t))
 				continue;
 			riscv_info_t *r = riscv_info(t);
-			enum riscv_poll_hart out = riscv_poll_hart(t, r->current_hartid);
+			enum target_state t_old_state = t->state;
+			enum riscv_poll_hart out;
+			if (riscv_hart_state_unchanged(t))
+				out = RPH_NO_CHANGE;
+			else
+				out = riscv_poll_hart(t, r->current_hartid);
 			switch (out) {
 			case RPH_NO_CHANGE:
 				break;
@@ -2225,6 +2627,15 @@ int riscv_openocd_poll(struct target *target)
 				if (set_debug_reason(t, halt_reason) != ERROR_OK)
 					return ERROR_FAIL;
 
+				if (r->non_stop) {
+					/* Report this hart on its own, and leave the rest of
+					 * the group alone. */
+					int retval = riscv_halted_event(t, t_old_state);
+					if (retval != ERROR_OK)
+						return retval;
+					break;
+				}
+
 				if (halt_reason == RISCV_HALT_BREAKPOINT) {
 					int retval;
 					switch (riscv_semihosting(t, &retval)) {
@@ -2296,28 +2707,7 @@ int riscv_openocd_poll(struct target *target)
 		target->state = TARGET_HALTED;
 	}
 
-	if (target->debug_reason == DBG_REASON_BREAKPOINT) {
-		int retval;
-		switch (riscv_semihosting(target, &retval)) {
-			case SEMI_NONE:
-			case SEMI_WAITING:
-				target_call_event_callbacks(target, TARGET_EVENT_HALTED);
-				break;
-			case SEMI_HANDLED:
-				if (riscv_resume(target, true, 0, 0, 0, false) != ERROR_OK)
-					return ERROR_FAIL;
-				break;
-			case SEMI_ERROR:
-				return retval;
-		}
-	} else {
-		if (old_state == TARGET_DEBUG_RUNNING)
-			target_call_event_callbacks(target, TARGET_EVENT_DEBUG_HALTED);
-		else
-			target_call_event_callbacks(target, TARGET_EVENT_HALTED);
-	}
-
-	return ERROR_OK;
+	return riscv_halted_event(target, old_state);
 }
 
 int riscv_openocd_step(struct target *target, int current,
@@ -2353,6 +2743,7 @@ int riscv_openocd_step(struct target *target, int current,
 	}
 
 	register_cache_invalidate(target->reg_cache);
+	riscv_prefetch_registers(target);
 
 	if (info->isrmask_mode == RISCV_ISRMASK_STEPONLY)
 		if (riscv_interrupts_restore(target, current_mstatus) != ERROR_OK) {
@@ -3054,6 +3445,11 @@ COMMAND_HANDLER(handle_memory_sample_command)
 				command_print(CMD, "bucket %d; disabled", i);
 			}
 		}
+		if (r->sample_interval_ms)
+			command_print(CMD, "interval: %u ms", r->sample_interval_ms);
+		if (r->sample_port)
+			command_print(CMD, "streaming to port %s", r->sample_port);
+		command_print(CMD, "overflows: %u", r->sample_buf.overflows);
 		return ERROR_OK;
 	}
 
@@ -3095,12 +3491,186 @@ COMMAND_HANDLER(handle_memory_sample_command)
 
 	/* Clear the buffer when the configuration is changed. */
 	r->sample_buf.used = 0;
+	r->sample_buf.overflows = 0;
 
 	r->sample_config.enabled = true;
 
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_memory_sample_interval_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "%u", r->sample_interval_ms);
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	unsigned int interval_ms;
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], interval_ms);
+
+	if (r->sample_interval_ms)
+		target_unregister_timer_callback(riscv_sample_timer_callback, target);
+	r->sample_interval_ms = interval_ms;
+	if (interval_ms)
+		return target_register_timer_callback(riscv_sample_timer_callback,
+				interval_ms, TARGET_TIMER_TYPE_PERIODIC, target);
+
+	return ERROR_OK;
+}
+
+static int riscv_sample_service_new_connection(struct connection *connection)
+{
+	struct target *target = *(struct target **)connection->service->priv;
+	RISCV_INFO(r);
+
+	struct riscv_sample_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	c->connection = connection;
+	list_add(&c->lh, &r->sample_connections);
+	return ERROR_OK;
+}
+
+static int riscv_sample_service_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int riscv_sample_service_connection_closed(struct connection *connection)
+{
+	struct target *target = *(struct target **)connection->service->priv;
+	RISCV_INFO(r);
+
+	struct riscv_sample_connection *c, *tmp;
+	list_for_each_entry_safe(c, tmp, &r->sample_connections, lh) {
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver riscv_sample_service_driver = {
+	.name = RISCV_SAMPLE_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = riscv_sample_service_new_connection,
+	.input_handler = riscv_sample_service_input,
+	.connection_closed_handler = riscv_sample_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+COMMAND_HANDLER(handle_memory_sample_port_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "%s", r->sample_port ? r->sample_port : "disabled");
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (r->sample_port) {
+		remove_service(RISCV_SAMPLE_SERVICE_NAME, r->sample_port);
+		free(r->sample_port);
+		r->sample_port = NULL;
+	}
+
+	if (!strcmp(CMD_ARGV[0], "disabled"))
+		return ERROR_OK;
+
+	/* The service frees this when it is removed. */
+	struct target **priv = malloc(sizeof(*priv));
+	char *port = strdup(CMD_ARGV[0]);
+	if (!priv || !port) {
+		LOG_ERROR("Out of memory");
+		free(priv);
+		free(port);
+		return ERROR_FAIL;
+	}
+	*priv = target;
+
+	int retval = add_service(&riscv_sample_service_driver, port,
+			CONNECTION_LIMIT_UNLIMITED, priv);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Can't start memory sample server on port %s", port);
+		free(priv);
+		free(port);
+		return retval;
+	}
+	r->sample_port = port;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_pc_sample_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC == 0) {
+		if (r->pc_sample.enabled)
+			command_print(CMD, "PC sample register for %s: address=0x%" TARGET_PRIxADDR
+					"; size=%d", target_name(target), r->pc_sample.address,
+					r->pc_sample.size_bytes);
+		else
+			command_print(CMD, "PC sample register for %s: disabled", target_name(target));
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!strcmp(CMD_ARGV[0], "clear")) {
+		if (CMD_ARGC > 1)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		r->pc_sample.enabled = false;
+		return ERROR_OK;
+	}
+
+	target_addr_t address;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[0], address);
+
+	uint32_t size_bytes = 4;
+	if (CMD_ARGC > 1) {
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], size_bytes);
+		if (size_bytes != 4 && size_bytes != 8) {
+			LOG_ERROR("Only 4-byte and 8-byte sizes are supported.");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	r->pc_sample.address = address;
+	r->pc_sample.size_bytes = size_bytes;
+	r->pc_sample.enabled = true;
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_dump_sample_buf_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -3201,6 +3771,73 @@ COMMAND_HANDLER(handle_info)
 
 	return 0;
 }
+
+COMMAND_HANDLER(handle_reg_cache_stats)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "clear"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		r->reg_cache_hits = 0;
+		r->reg_cache_misses = 0;
+		r->reg_prefetched = 0;
+		bitmap_zero(r->reg_requested, GDB_REGNO_COUNT);
+		return ERROR_OK;
+	}
+
+	/* This output format can be fed directly into TCL's "array set". */
+	command_print(CMD, "hits        %" PRIu64, r->reg_cache_hits);
+	command_print(CMD, "misses      %" PRIu64, r->reg_cache_misses);
+	command_print(CMD, "prefetched  %" PRIu64, r->reg_prefetched);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_smp_poll_benchmark)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	unsigned int count = 100;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], count);
+	if (count == 0)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	unsigned int harts = 1;
+	if (target->smp) {
+		struct target_list *list;
+		harts = 0;
+		foreach_smp_target(list, target->smp_targets)
+			if (target_was_examined(list->target))
+				harts++;
+	}
+
+	bool use_hart_summary = riscv_use_hart_summary;
+	int result = ERROR_OK;
+	for (unsigned int summary = 0; summary < 2 && result == ERROR_OK; summary++) {
+		riscv_use_hart_summary = summary;
+
+		struct duration bench;
+		duration_start(&bench);
+		for (unsigned int i = 0; i < count && result == ERROR_OK; i++)
+			result = riscv_openocd_poll(target);
+		duration_measure(&bench);
+
+		command_print(CMD, "%-8s %u harts, %u polls: %.1f us per poll",
+				summary ? "summary" : "per-hart", harts, count,
+				duration_elapsed(&bench) * 1e6 / count);
+	}
+	riscv_use_hart_summary = use_hart_summary;
+
+	return result;
+}
 #define KB                        (1024)
 #define MB                        (KB * 1024)
 #define GB                        (MB * 1024)
@@ -3665,6 +4302,22 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.usage = "",
 		.help = "Displays some information OpenOCD detected about the target."
 	},
+	{
+		.name = "reg_cache_stats",
+		.handler = handle_reg_cache_stats,
+		.mode = COMMAND_EXEC,
+		.usage = "[clear]",
+		.help = "Display register cache hits, misses and prefetched registers, "
+			"or clear the counters and the set of registers to prefetch."
+	},
+	{
+		.name = "smp_poll_benchmark",
+		.handler = handle_smp_poll_benchmark,
+		.mode = COMMAND_EXEC,
+		.usage = "[count=100]",
+		.help = "Measure the time it takes to poll all harts of the current "
+			"target, with and without using the DM's hart summary."
+	},
 	{
 		.name = "memory_sample",
 		.handler = handle_memory_sample_command,
@@ -3672,6 +4325,31 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.usage = "bucket address|clear [size=4]",
 		.help = "Causes OpenOCD to frequently read size bytes at the given address."
 	},
+	{
+		.name = "memory_sample_interval",
+		.handler = handle_memory_sample_interval_command,
+		.mode = COMMAND_ANY,
+		.usage = "[ms]",
+		.help = "Take one round of memory samples every ms milliseconds, instead "
+			"of sampling continuously while the target is polled. 0 restores "
+			"continuous sampling."
+	},
+	{
+		.name = "memory_sample_port",
+		.handler = handle_memory_sample_port_command,
+		.mode = COMMAND_ANY,
+		.usage = "[port|disabled]",
+		.help = "Stream the memory sample buffer to clients connecting to the "
+			"given TCP port."
+	},
+	{
+		.name = "pc_sample",
+		.handler = handle_pc_sample_command,
+		.mode = COMMAND_ANY,
+		.usage = "[address|clear [size=4]]",
+		.help = "Configure a memory-mapped register that holds the PC of the "
+			"running hart, so the profile command doesn't need to halt it."
+	},
 	{
 		.name = "repeat_read",
 		.handler = handle_repeat_read,
@@ -3963,10 +4641,14 @@ struct target_type riscv_target = {
 
 	.run_algorithm = riscv_run_algorithm,
 
+	.profiling = riscv_profiling,
+
 	.commands = riscv_command_handlers,
 
 	.address_bits = riscv_xlen_nonconst,
-	.data_bits = riscv_data_bits
+	.data_bits = riscv_data_bits,
+
+	.set_non_stop = riscv_set_non_stop
 };
 
 /*** RISC-V Interface ***/
@@ -3994,6 +4676,7 @@ void riscv_info_init(struct target *target, riscv_info_t *r)
 
 	INIT_LIST_HEAD(&r->expose_csr);
 	INIT_LIST_HEAD(&r->expose_custom);
+	INIT_LIST_HEAD(&r->sample_connections);
 }
 
 static int riscv_resume_go_all_harts(struct target *target)
@@ -4217,6 +4900,13 @@ int riscv_set_register(struct target *target, enum gdb_regno regid, riscv_reg_t
 	struct reg *reg = &target->reg_cache->reg_list[regid];
 	buf_set_u64(reg->value, 0, reg->size, value);
 
+	/* pc is read through the dpc cache entry, so drop that entry when pc is
+	 * written behind its back. */
+	if (regid == GDB_REGNO_PC) {
+		target->reg_cache->reg_list[GDB_REGNO_DPC].valid = false;
+		target->reg_cache->reg_list[GDB_REGNO_DPC].dirty = false;
+	}
+
 	if (gdb_regno_cacheable(regid, true)) {
 		reg->valid = true;
 		reg->dirty = true;
@@ -4244,10 +4934,15 @@ int riscv_get_register(struct target *target, riscv_reg_t *value,
 		return ERROR_FAIL;
 	}
 
+	/* While halted pc is just dpc, which is usually cached. */
+	if (regid == GDB_REGNO_PC && target->reg_cache->reg_list[GDB_REGNO_DPC].valid)
+		reg = &target->reg_cache->reg_list[GDB_REGNO_DPC];
+
 	if (reg && reg->valid) {
 		*value = buf_get_u64(reg->value, 0, reg->size);
 		LOG_DEBUG("[%s] %s: %" PRIx64 " (cached)", target_name(target),
 				  gdb_regno_name(regid), *value);
+		r->reg_cache_hits++;
 		return ERROR_OK;
 	}
 
@@ -4258,6 +4953,8 @@ int riscv_get_register(struct target *target, riscv_reg_t *value,
 		return ERROR_OK;
 	}
 
+	r->reg_cache_misses++;
+
 	int result = r->get_register(target, value, regid);
 
 	if (result == ERROR_OK) {
@@ -4265,6 +4962,9 @@ int riscv_get_register(struct target *target, riscv_reg_t *value,
 		 * riscv_save_register(). */
 		buf_set_u64(reg->value, 0, reg->size, *value);
 		reg->valid = gdb_regno_cacheable(regid, false);
+		/* Fetch it together with the GPRs on the next halt. */
+		if (regid >= GDB_REGNO_CSR0 && regid <= GDB_REGNO_CSR4095)
+			set_bit(regid, r->reg_requested);
 	}
 
 	LOG_DEBUG("[%s] %s: %" PRIx64, target_name(target),
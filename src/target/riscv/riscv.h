@@ -10,6 +10,7 @@ struct riscv_program;
 #include "gdb_regs.h"
 #include "jtag/jtag.h"
 #include "target/register.h"
+#include <helper/bits.h>
 #include <helper/command.h>
 
 /* The register cache is statically allocated. */
@@ -30,6 +31,12 @@ struct riscv_program;
 #define RISCV_NUM_MEM_ACCESS_METHODS  3
 
 #define RISCV_BATCH_ALLOC_SIZE 128
+/* Bounds for the adaptive size of the batches used by block memory accesses. */
+#define RISCV_BATCH_MIN_SIZE 16
+#define RISCV_BATCH_MAX_SIZE 2048
+/* Number of consecutive batches without a busy response after which the batch
+ * size is grown and the DMI busy delay is lowered again. */
+#define RISCV_BATCH_TUNE_RUNS 8
 
 extern struct target_type riscv011_target;
 extern struct target_type riscv013_target;
@@ -58,6 +65,13 @@ enum riscv_halt_reason {
 	RISCV_HALT_ERROR
 };
 
+/* State of all the harts a DM can report on in a single access. */
+enum riscv_hart_summary {
+	RISCV_HARTS_MIXED,	/* Some halted, some running, or unknown. */
+	RISCV_HARTS_ALL_HALTED,
+	RISCV_HARTS_ALL_RUNNING
+};
+
 enum riscv_isrmasking_mode {
 	/* RISCV_ISRMASK_AUTO,	*/ /* not supported yet */
 	RISCV_ISRMASK_OFF,
@@ -76,6 +90,8 @@ struct riscv_sample_buf {
 	uint8_t *buf;
 	unsigned int used;
 	unsigned int size;
+	/* Number of sampling rounds skipped because the buffer was full. */
+	unsigned int overflows;
 };
 
 typedef struct {
@@ -144,6 +160,9 @@ typedef struct {
 	bool prepped;
 	/* This target was selected using hasel. */
 	bool selected;
+	/* GDB is in non-stop mode: halt, resume and poll treat this hart on its
+	 * own, even if it's part of an SMP group. */
+	bool non_stop;
 
 	enum riscv_isrmasking_mode isrmask_mode;
 
@@ -151,6 +170,12 @@ typedef struct {
 	 * implementations. */
 	int (*get_register)(struct target *target, riscv_reg_t *value, int regid);
 	int (*set_register)(struct target *target, int regid, uint64_t value);
+	/* Optional. Read/write several registers in as few DMI round trips as
+	 * possible. get_registers sets read[i] for every value it fetched. */
+	int (*get_registers)(struct target *target, unsigned int count,
+			const enum gdb_regno *regnos, riscv_reg_t *values, bool *read);
+	int (*set_registers)(struct target *target, unsigned int count,
+			const enum gdb_regno *regnos, const riscv_reg_t *values);
 	int (*get_register_buf)(struct target *target, uint8_t *buf, int regno);
 	int (*set_register_buf)(struct target *target, int regno,
 			const uint8_t *buf);
@@ -165,6 +190,13 @@ typedef struct {
 	/* Get this target as ready as possible to resume, without actually
 	 * resuming. */
 	int (*resume_prep)(struct target *target);
+	/* Optional. Summarize the state of all examined harts that share a DM
+	 * with target. The answer may be cached for the same poll_id. */
+	int (*hart_summary)(struct target *target, unsigned int poll_id,
+			enum riscv_hart_summary *summary);
+	/* Optional. Make the hart join or leave the halt group of its SMP
+	 * group. */
+	int (*set_halt_group)(struct target *target, bool join);
 	int (*halt_prep)(struct target *target);
 	int (*halt_go)(struct target *target);
 	int (*on_step)(struct target *target);
@@ -241,9 +273,32 @@ typedef struct {
 
 	riscv_sample_config_t sample_config;
 	struct riscv_sample_buf sample_buf;
+	/* When non-zero, memory is sampled once every this many ms from a timer
+	 * callback, instead of continuously whenever the target is polled. */
+	unsigned int sample_interval_ms;
+	/* Port of the service that streams the sample buffer, and its clients. */
+	char *sample_port;
+	struct list_head sample_connections;
+
+	/* Memory-mapped register that holds a recent PC of the running hart. When
+	 * configured, profiling reads it over the system bus instead of halting
+	 * the hart for every sample. */
+	struct {
+		bool enabled;
+		target_addr_t address;
+		uint32_t size_bytes;
+	} pc_sample;
 
 	/* Track when we were last asked to do something substantial. */
 	int64_t last_activity;
+
+	/* Registers that missed the cache since the target was examined. They
+	 * are fetched together with the GPRs every time the hart halts. */
+	DECLARE_BITMAP(reg_requested, GDB_REGNO_COUNT);
+	/* Register cache statistics, see "riscv reg_cache_stats". */
+	uint64_t reg_cache_hits;
+	uint64_t reg_cache_misses;
+	uint64_t reg_prefetched;
 } riscv_info_t;
 
 COMMAND_HELPER(riscv_print_info_line, const char *section, const char *key,
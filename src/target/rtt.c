@@ -28,6 +28,21 @@
 
 #include "target.h"
 
+/* Upper limit for the data read from one up-channel per poll. */
+#define RTT_MAX_READ_LENGTH	(64 * 1024)
+
+static void parse_rtt_channel(const uint8_t *buf, target_addr_t address,
+		struct rtt_channel *channel)
+{
+	channel->address = address;
+	channel->name_addr = buf_get_u32(buf + 0, 0, 32);
+	channel->buffer_addr = buf_get_u32(buf + 4, 0, 32);
+	channel->size = buf_get_u32(buf + 8, 0, 32);
+	channel->write_pos = buf_get_u32(buf + 12, 0, 32);
+	channel->read_pos = buf_get_u32(buf + 16, 0, 32);
+	channel->flags = buf_get_u32(buf + 20, 0, 32);
+}
+
 static int read_rtt_channel(struct target *target,
 		const struct rtt_control *ctrl, unsigned int channel_index,
 		enum rtt_channel_type type, struct rtt_channel *channel)
@@ -46,13 +61,7 @@ static int read_rtt_channel(struct target *target,
 	if (ret != ERROR_OK)
 		return ret;
 
-	channel->address = address;
-	channel->name_addr = buf_get_u32(buf + 0, 0, 32);
-	channel->buffer_addr = buf_get_u32(buf + 4, 0, 32);
-	channel->size = buf_get_u32(buf + 8, 0, 32);
-	channel->write_pos = buf_get_u32(buf + 12, 0, 32);
-	channel->read_pos = buf_get_u32(buf + 16, 0, 32);
-	channel->flags = buf_get_u32(buf + 20, 0, 32);
+	parse_rtt_channel(buf, address, channel);
 
 	return ERROR_OK;
 }
@@ -381,26 +390,48 @@ static int read_from_channel(struct target *target,
 
 int target_rtt_read_callback(struct target *target,
 		const struct rtt_control *ctrl, struct rtt_sink_list **sinks,
-		size_t num_channels, void *user_data)
+		size_t num_channels, size_t *length, void *user_data)
 {
+	int ret;
+	uint8_t *descriptors;
+	target_addr_t address;
+
+	*length = 0;
 	num_channels = MIN(num_channels, ctrl->num_up_channels);
 
+	/* Only the descriptors up to the last channel with a sink are needed. */
+	while (num_channels && !sinks[num_channels - 1])
+		num_channels--;
+
+	if (!num_channels)
+		return ERROR_OK;
+
+	/* Read the descriptors of all these up-channels at once. */
+	descriptors = malloc(num_channels * RTT_CHANNEL_SIZE);
+
+	if (!descriptors)
+		return ERROR_FAIL;
+
+	address = ctrl->address + RTT_CB_SIZE;
+	ret = target_read_buffer(target, address,
+		num_channels * RTT_CHANNEL_SIZE, descriptors);
+
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to read up-channel descriptions");
+		free(descriptors);
+		return ret;
+	}
+
 	for (size_t i = 0; i < num_channels; i++) {
-		int ret;
 		struct rtt_channel channel;
-		uint8_t buffer[1024];
-		size_t length;
+		uint8_t *buffer;
+		size_t channel_length;
 
 		if (!sinks[i])
 			continue;
 
-		ret = read_rtt_channel(target, ctrl, i, RTT_CHANNEL_TYPE_UP,
-			&channel);
-
-		if (ret != ERROR_OK) {
-			LOG_ERROR("rtt: Failed to read up-channel %zu description", i);
-			return ret;
-		}
+		parse_rtt_channel(descriptors + i * RTT_CHANNEL_SIZE,
+			address + i * RTT_CHANNEL_SIZE, &channel);
 
 		if (!channel_is_active(&channel)) {
 			LOG_WARNING("rtt: Up-channel %zu is not active", i);
@@ -412,17 +443,38 @@ int target_rtt_read_callback(struct target *target,
 			continue;
 		}
 
-		length = sizeof(buffer);
-		ret = read_from_channel(target, &channel, buffer, &length);
+		if (channel.read_pos == channel.write_pos)
+			continue;
+
+		/*
+		 * Fetch everything that is available, which takes at most two reads
+		 * when the data wraps around the end of the buffer.
+		 */
+		channel_length = MIN(channel.size, RTT_MAX_READ_LENGTH);
+		buffer = malloc(channel_length);
+
+		if (!buffer) {
+			free(descriptors);
+			return ERROR_FAIL;
+		}
+
+		ret = read_from_channel(target, &channel, buffer, &channel_length);
 
 		if (ret != ERROR_OK) {
 			LOG_ERROR("rtt: Failed to read from up-channel %zu", i);
+			free(buffer);
+			free(descriptors);
 			return ret;
 		}
 
 		for (struct rtt_sink_list *sink = sinks[i]; sink; sink = sink->next)
-			sink->read(i, buffer, length, sink->user_data);
+			sink->read(i, buffer, channel_length, sink->user_data);
+
+		*length += channel_length;
+		free(buffer);
 	}
 
+	free(descriptors);
+
 	return ERROR_OK;
 }
@@ -42,6 +42,7 @@
 #endif
 
 #include <helper/align.h>
+#include <helper/crc32.h>
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
 #include <flash/nor/core.h>
@@ -1523,6 +1524,15 @@ int target_gdb_fileio_end(struct target *target, int retcode, int fileio_errno,
 	return target->type->gdb_fileio_end(target, retcode, fileio_errno, ctrl_c);
 }
 
+int target_set_non_stop(struct target *target, bool non_stop)
+{
+	if (!target->type->set_non_stop) {
+		LOG_ERROR("Target %s doesn't support non-stop mode.", target_name(target));
+		return ERROR_NOT_IMPLEMENTED;
+	}
+	return target->type->set_non_stop(target, non_stop);
+}
+
 target_addr_t target_address_max(struct target *target)
 {
 	unsigned bits = target_address_bits(target);
@@ -1840,9 +1850,11 @@ int target_unregister_timer_callback(int (*callback)(void *priv), void *priv)
 	if (!callback)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
+	/* Skip callbacks that are already removed but not freed yet, so that a
+	 * callback registered again by itself can be found. */
 	for (struct target_timer_callback *c = target_timer_callbacks;
 	     c; c = c->next) {
-		if ((c->callback == callback) && (c->priv == priv)) {
+		if ((c->callback == callback) && (c->priv == priv) && !c->removed) {
 			c->removed = true;
 			return ERROR_OK;
 		}
@@ -3972,6 +3984,56 @@ COMMAND_HANDLER(handle_test_image_command)
 	return CALL_COMMAND_HANDLER(handle_verify_image_command_internal, IMAGE_TEST);
 }
 
+COMMAND_HANDLER(handle_checksum_benchmark_command)
+{
+	uint32_t size = 16 * 1024 * 1024;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], size);
+
+	uint8_t *buffer = malloc(size);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	uint32_t seed = 0x12345678;
+	for (uint32_t i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		buffer[i] = seed >> 16;
+	}
+
+	int retval = ERROR_OK;
+	uint32_t reference = 0;
+	for (enum crc32_engine engine = CRC32_ENGINE_BYTEWISE; engine < CRC32_ENGINE_COUNT; engine++) {
+		struct duration bench;
+		uint32_t crc = 0xffffffff;
+
+		duration_start(&bench);
+		if (!crc32_update_engine(engine, &crc, buffer, size)) {
+			command_print(CMD, "%-12s not supported by this host", crc32_engine_name(engine));
+			continue;
+		}
+		duration_measure(&bench);
+
+		if (engine == CRC32_ENGINE_BYTEWISE)
+			reference = crc;
+		bool match = crc == reference;
+		if (!match)
+			retval = ERROR_FAIL;
+
+		command_print(CMD, "%-12s 0x%08" PRIx32 " in %fs (%0.3f KiB/s)%s%s",
+			crc32_engine_name(engine), crc, duration_elapsed(&bench),
+			duration_kbps(&bench, size), match ? "" : " MISMATCH",
+			engine == crc32_best_engine() ? " (used)" : "");
+	}
+
+	free(buffer);
+	return retval;
+}
+
 static int handle_bp_command_list(struct command_invocation *cmd)
 {
 	struct target *target = get_current_target(cmd->ctx);
@@ -4330,6 +4392,30 @@ static void write_gmon(uint32_t *samples, uint32_t sample_num, const char *filen
 	fclose(f);
 }
 
+/* Put the target back in the run state it had before profiling started. */
+static int profile_restore_state(struct target *target, bool halted_before_profiling)
+{
+	int retval = target_poll(target);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (target->state == TARGET_RUNNING && halted_before_profiling) {
+		/* The target was halted before we started and is running now. Halt it,
+		 * for consistency. */
+		retval = target_halt(target);
+		if (retval != ERROR_OK)
+			return retval;
+	} else if (target->state == TARGET_HALTED && !halted_before_profiling) {
+		/* The target was running before we started and is halted now. Resume
+		 * it, for consistency. */
+		retval = target_resume(target, 1, 0, 0, 0);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return target_poll(target);
+}
+
 /* profiling samples the CPU PC as quickly as OpenOCD is able,
  * which will be used as a random sampling of PC */
 COMMAND_HANDLER(handle_profile_command)
@@ -4369,31 +4455,7 @@ COMMAND_HANDLER(handle_profile_command)
 
 	assert(num_of_samples <= MAX_PROFILE_SAMPLE_NUM);
 
-	retval = target_poll(target);
-	if (retval != ERROR_OK) {
-		free(samples);
-		return retval;
-	}
-
-	if (target->state == TARGET_RUNNING && halted_before_profiling) {
-		/* The target was halted before we started and is running now. Halt it,
-		 * for consistency. */
-		retval = target_halt(target);
-		if (retval != ERROR_OK) {
-			free(samples);
-			return retval;
-		}
-	} else if (target->state == TARGET_HALTED && !halted_before_profiling) {
-		/* The target was running before we started and is halted now. Resume
-		 * it, for consistency. */
-		retval = target_resume(target, 1, 0, 0, 0);
-		if (retval != ERROR_OK) {
-			free(samples);
-			return retval;
-		}
-	}
-
-	retval = target_poll(target);
+	retval = profile_restore_state(target, halted_before_profiling);
 	if (retval != ERROR_OK) {
 		free(samples);
 		return retval;
@@ -4416,6 +4478,233 @@ COMMAND_HANDLER(handle_profile_command)
 	return retval;
 }
 
+/* profile_stream samples as many PCs per chunk, and writes each chunk to the
+ * file before sampling the next one. */
+#define PROFILE_STREAM_CHUNK		4096
+#define PROFILE_STREAM_MAX_DEPTH	32
+/* Bytes of stack read per requested frame when capturing call stacks. */
+#define PROFILE_STREAM_FRAME_BYTES	64
+
+static int profile_compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int profile_stream_puts(struct fileio *fileio, const char *line)
+{
+	size_t size_written;
+	size_t len = strlen(line);
+	int retval = fileio_write(fileio, len, line, &size_written);
+	if (retval == ERROR_OK && size_written != len)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+	return retval;
+}
+
+/* Write a chunk of PC samples in folded stack format, one line per distinct PC. */
+static int profile_stream_write_pcs(struct fileio *fileio, uint32_t *samples,
+		uint32_t num_samples)
+{
+	qsort(samples, num_samples, sizeof(*samples), profile_compare_u32);
+
+	uint32_t i = 0;
+	while (i < num_samples) {
+		uint32_t j = i + 1;
+		while (j < num_samples && samples[j] == samples[i])
+			j++;
+
+		char line[32];
+		snprintf(line, sizeof(line), "0x%08" PRIx32 " %" PRIu32 "\n", samples[i], j - i);
+		int retval = profile_stream_puts(fileio, line);
+		if (retval != ERROR_OK)
+			return retval;
+		i = j;
+	}
+	return ERROR_OK;
+}
+
+/* Write one call stack in folded stack format. frames[0] is the PC, the
+ * outermost caller comes first in the output. */
+static int profile_stream_write_stack(struct fileio *fileio, const uint64_t *frames,
+		unsigned int num_frames)
+{
+	char line[PROFILE_STREAM_MAX_DEPTH * 20 + 40];
+	size_t len = 0;
+
+	for (unsigned int i = num_frames; i > 0; i--)
+		len += snprintf(line + len, sizeof(line) - len, "%s0x%08" PRIx64,
+				i == num_frames ? "" : ";", frames[i - 1]);
+	snprintf(line + len, sizeof(line) - len, " 1\n");
+
+	return profile_stream_puts(fileio, line);
+}
+
+static int profile_get_reg(struct reg *reg, uint64_t *value)
+{
+	if (!reg->valid) {
+		int retval = reg->type->get(reg);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	*value = buf_get_u64(reg->value, 0, reg->size);
+	return ERROR_OK;
+}
+
+/* Halt the target, and capture its PC followed by up to depth return
+ * addresses found by following the frame pointer chain. All frame records
+ * come from a single memory read starting just below the frame pointer; the
+ * walk stops at the first record outside of it. */
+static int profile_sample_stack(struct target *target, struct reg *pc, struct reg *fp,
+		unsigned int depth, uint64_t *frames, unsigned int *num_frames)
+{
+	int retval = target_poll(target);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (target->state == TARGET_RUNNING) {
+		retval = target_halt(target);
+		if (retval == ERROR_OK)
+			retval = target_wait_state(target, TARGET_HALTED, 100);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	if (target->state != TARGET_HALTED) {
+		LOG_ERROR("Target not halted or running");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	uint64_t fp_value;
+	retval = profile_get_reg(pc, &frames[0]);
+	if (retval == ERROR_OK)
+		retval = profile_get_reg(fp, &fp_value);
+	if (retval != ERROR_OK)
+		return retval;
+	*num_frames = 1;
+
+	/* Each frame record holds the previous frame pointer followed by the
+	 * return address, and sits just below the frame pointer. Callers' records
+	 * are at higher addresses. A frame pointer that doesn't look like one
+	 * just leaves us with the PC. */
+	unsigned int ptr_size = fp->size / 8;
+	unsigned int window = depth * PROFILE_STREAM_FRAME_BYTES;
+	uint8_t stack[PROFILE_STREAM_MAX_DEPTH * PROFILE_STREAM_FRAME_BYTES];
+	if ((ptr_size == 4 || ptr_size == 8) && fp_value >= 2 * ptr_size &&
+			!(fp_value % ptr_size)) {
+		target_addr_t base = fp_value - 2 * ptr_size;
+		if (target_read_memory(target, base, ptr_size, window / ptr_size, stack) == ERROR_OK) {
+			uint64_t cur = fp_value;
+			while (*num_frames <= depth && cur >= base + 2 * ptr_size &&
+					cur - base <= window) {
+				const uint8_t *record = stack + (cur - base) - 2 * ptr_size;
+				uint64_t prev, ra;
+				if (ptr_size == 8) {
+					prev = target_buffer_get_u64(target, record);
+					ra = target_buffer_get_u64(target, record + 8);
+				} else {
+					prev = target_buffer_get_u32(target, record);
+					ra = target_buffer_get_u32(target, record + 4);
+				}
+				frames[(*num_frames)++] = ra;
+				if (prev <= cur)
+					break;
+				cur = prev;
+			}
+		}
+	}
+
+	return target_resume(target, 1, 0, 0, 0);
+}
+
+COMMAND_HANDLER(handle_profile_stream_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC != 2 && CMD_ARGC != 3)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	uint32_t seconds;
+	COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], seconds);
+
+	unsigned int depth = 0;
+	if (CMD_ARGC == 3) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], depth);
+		if (depth > PROFILE_STREAM_MAX_DEPTH) {
+			command_print(CMD, "Stack depth is limited to %d frames.",
+					PROFILE_STREAM_MAX_DEPTH);
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+	}
+
+	struct reg *pc = NULL;
+	struct reg *fp = NULL;
+	if (depth) {
+		pc = register_get_by_name(target->reg_cache, "pc", true);
+		fp = register_get_by_name(target->reg_cache, "fp", true);
+		if (!pc || !fp) {
+			command_print(CMD, "Target %s has no pc and fp registers to capture "
+					"call stacks with.", target_name(target));
+			return ERROR_FAIL;
+		}
+	}
+
+	uint32_t *samples = malloc(sizeof(uint32_t) * PROFILE_STREAM_CHUNK);
+	if (!samples) {
+		LOG_ERROR("No memory to store samples.");
+		return ERROR_FAIL;
+	}
+
+	struct fileio *fileio;
+	int retval = fileio_open(&fileio, CMD_ARGV[1], FILEIO_WRITE, FILEIO_TEXT);
+	if (retval != ERROR_OK) {
+		free(samples);
+		return retval;
+	}
+
+	bool halted_before_profiling = target->state == TARGET_HALTED;
+	int64_t timestart_ms = timeval_ms();
+	int64_t deadline_ms = timestart_ms + (int64_t)seconds * 1000;
+	uint64_t sample_count = 0;
+
+	while (timeval_ms() < deadline_ms) {
+		if (depth) {
+			uint64_t frames[PROFILE_STREAM_MAX_DEPTH + 1];
+			unsigned int num_frames;
+			retval = profile_sample_stack(target, pc, fp, depth, frames, &num_frames);
+			if (retval == ERROR_OK)
+				retval = profile_stream_write_stack(fileio, frames, num_frames);
+			sample_count++;
+		} else {
+			/* Let the target's profiling method sample for up to a second
+			 * at a time, so each chunk is written out promptly. */
+			uint32_t num_samples;
+			retval = target_profiling(target, samples, PROFILE_STREAM_CHUNK,
+					&num_samples, 1);
+			if (retval == ERROR_OK)
+				retval = profile_stream_write_pcs(fileio, samples, num_samples);
+			sample_count += num_samples;
+		}
+		if (retval != ERROR_OK)
+			break;
+		keep_alive();
+	}
+	uint64_t duration_ms = timeval_ms() - timestart_ms;
+
+	free(samples);
+	fileio_close(fileio);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = profile_restore_state(target, halted_before_profiling);
+	if (retval != ERROR_OK)
+		return retval;
+
+	command_print(CMD, "Wrote %" PRIu64 " samples in %" PRIu64 " ms to %s",
+			sample_count, duration_ms, CMD_ARGV[1]);
+	return ERROR_OK;
+}
+
 static int new_u64_array_element(Jim_Interp *interp, const char *varname, int idx, uint64_t val)
 {
 	char *namebuf;
@@ -6973,6 +7262,14 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.usage = "seconds filename [start end]",
 		.help = "profiling samples the CPU PC",
 	},
+	{
+		.name = "profile_stream",
+		.handler = handle_profile_stream_command,
+		.mode = COMMAND_EXEC,
+		.usage = "seconds filename [stack_depth]",
+		.help = "sample the CPU PC, and optionally the call stack, "
+			"streaming folded stacks to a file",
+	},
 	/** @todo don't register virt2phys() unless target supports it */
 	{
 		.name = "virt2phys",
@@ -7156,6 +7453,13 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.mode = COMMAND_EXEC,
 		.usage = "filename [offset [type]]",
 	},
+	{
+		.name = "checksum_benchmark",
+		.handler = handle_checksum_benchmark_command,
+		.mode = COMMAND_ANY,
+		.help = "compare the speed of the host side CRC implementations",
+		.usage = "[size]",
+	},
 	{
 		.name = "get_reg",
 		.mode = COMMAND_EXEC,
@@ -690,6 +690,13 @@ int target_get_gdb_fileio_info(struct target *target, struct gdb_fileio_info *fi
  */
 int target_gdb_fileio_end(struct target *target, int retcode, int fileio_errno, bool ctrl_c);
 
+/**
+ * Switch target in or out of GDB non-stop mode.
+ *
+ * This routine is a wrapper for target->type->set_non_stop.
+ */
+int target_set_non_stop(struct target *target, bool non_stop);
+
 /**
  * Return the highest accessible address for this target.
  */
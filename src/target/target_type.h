@@ -300,6 +300,11 @@ struct target_type {
 	 * will typically be 32 for 32-bit targets, and 64 for 64-bit targets. If
 	 * not implemented, it's assumed to be 32. */
 	unsigned int (*data_bits)(struct target *target);
+
+	/* Optional. Switch the target in or out of GDB non-stop mode. In non-stop
+	 * mode halt, resume and step only act on this target, even if it is part
+	 * of an SMP group, and a core halting doesn't stop the rest of the group. */
+	int (*set_non_stop)(struct target *target, bool non_stop);
 };
 
 #endif /* OPENOCD_TARGET_TARGET_TYPE_H */
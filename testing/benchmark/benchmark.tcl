@@ -0,0 +1,68 @@
+#
+# Throughput benchmark of the target and JTAG layers, run against the
+# loopback adapter so that the numbers only depend on the host:
+#
+#   openocd -f testing/benchmark/riscv-loopback.cfg \
+#           -f testing/benchmark/benchmark.tcl
+#
+# Every workload prints one line
+#
+#   benchmark name <workload> iterations <n> ms <elapsed> flushes <n> ...
+#
+# where everything after "benchmark" is a Tcl dictionary holding the wall
+# clock time and the counters of "loopback stats" for the run. Set
+# benchmark_iterations, benchmark_size or benchmark_file with -c before this
+# file is loaded to change the workloads, and use "jtag queue_optimizer off"
+# or "loopback flush_delay" to compare configurations.
+#
+
+if {![info exists benchmark_iterations]} {
+	set benchmark_iterations 100
+}
+if {![info exists benchmark_size]} {
+	set benchmark_size 0x10000
+}
+if {![info exists benchmark_file]} {
+	set benchmark_file benchmark.bin
+}
+set benchmark_base 0x80000000
+
+proc benchmark_run {name iterations script} {
+	loopback stats reset
+	set start [ms]
+	for {set i 0} {$i < $iterations} {incr i} {
+		uplevel 1 $script
+	}
+	set elapsed [expr {[ms] - $start}]
+	echo "benchmark [concat [list name $name iterations $iterations ms $elapsed] [loopback stats]]"
+}
+
+init
+halt
+
+set target [target current]
+
+benchmark_run poll $benchmark_iterations {
+	$target arp_poll
+}
+
+benchmark_run step $benchmark_iterations {
+	step
+}
+
+# what mdw does, without the cost of printing the words
+benchmark_run mdw 1 {
+	read_memory $benchmark_base 32 [expr {$benchmark_size / 4}]
+}
+
+benchmark_run dump_image 1 {
+	dump_image $benchmark_file $benchmark_base $benchmark_size
+}
+
+benchmark_run load_image 1 {
+	load_image $benchmark_file $benchmark_base bin
+}
+
+file delete $benchmark_file
+
+shutdown